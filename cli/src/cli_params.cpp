@@ -30,6 +30,22 @@ static void addParams(CLI::App &app, Params &params) {
                  "The maximum number of CPU threads to use (0 means unlimited)",
                  true)
       ->check(CLI::NonNegativeNumber);
+  app.add_option("--steady-state-tolerance", params.steadyStateTolerance,
+                 "Stop the simulation when the largest max|dc/dt| / max|c| of "
+                 "any species is below this value (0 means never stop early)",
+                 true)
+      ->check(CLI::NonNegativeNumber);
+  app.add_flag("--newton-krylov", params.newtonKrylov,
+               "Pixel simulator: at each image, try to solve for the steady "
+               "state directly with Newton-Krylov iterations");
+  app.add_option("--steady-state-output-file", params.steadyStateOutputFile,
+                 "If --newton-krylov finds a steady state, also write the "
+                 "model with this steady state as its initial concentrations "
+                 "to this file");
+  app.add_flag("--tiered-compilation", params.tieredCompilation,
+               "Pixel simulator: start straight away with interpreted "
+               "reaction terms, and switch to the compiled reaction terms "
+               "once they are ready");
 }
 
 static void addCallbacks(CLI::App &app) {
@@ -84,6 +100,13 @@ void printParams(const Params &params) {
   fmt::print("#   - Image Interval(s): {}\n", params.imageIntervals);
   fmt::print("#   - Output file: {}\n", params.outputFile);
   fmt::print("#   - Max CPU threads: {}\n", params.maxThreads);
+  fmt::print("#   - Steady state tolerance: {}\n",
+             params.steadyStateTolerance);
+  fmt::print("#   - Newton-Krylov steady state solve: {}\n",
+             params.newtonKrylov);
+  fmt::print("#   - Steady state output file: {}\n",
+             params.steadyStateOutputFile);
+  fmt::print("#   - Tiered compilation: {}\n", params.tieredCompilation);
 }
 
 } // namespace sme::cli
@@ -12,6 +12,10 @@ struct Params {
   simulate::SimulatorType simType{simulate::SimulatorType::DUNE};
   std::string outputFile{};
   std::size_t maxThreads{0};
+  double steadyStateTolerance{0};
+  bool newtonKrylov{false};
+  std::string steadyStateOutputFile{};
+  bool tieredCompilation{false};
 };
 
 Params setupCLI(CLI::App &app);
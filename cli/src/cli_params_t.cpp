@@ -13,8 +13,11 @@ SCENARIO("CLI Params", "[cli][params]") {
   cli::setupCLI(a);
   REQUIRE(a.get_description().substr(0, 24) == "Spatial Model Editor CLI");
   REQUIRE(a.get_groups().size() == 1);
-  REQUIRE(a.get_options().size() == 10);
+  REQUIRE(a.get_options().size() == 13);
   REQUIRE(a.get_option("file")->get_required() == true);
   REQUIRE(a.get_option("times")->get_required() == true);
   REQUIRE(a.get_option("image-intervals")->get_required() == true);
+  REQUIRE(a.get_option("--steady-state-tolerance")->get_required() == false);
+  REQUIRE(a.get_option("--newton-krylov")->get_required() == false);
+  REQUIRE(a.get_option("--tiered-compilation")->get_required() == false);
 }
@@ -52,6 +52,9 @@ bool doSimulation(const Params &params) {
   if (params.maxThreads == 1) {
     options.pixel.enableMultiThreading = false;
   }
+  options.steadyState.tolerance = params.steadyStateTolerance;
+  options.steadyState.newtonKrylov = params.newtonKrylov;
+  options.pixel.tieredCompilation = params.tieredCompilation;
   simulate::Simulation sim(s);
   if (const auto &e = sim.errorMessage(); !e.empty()) {
     fmt::print("\n\nError in simulation setup: {}\n\n", e);
@@ -65,7 +68,23 @@ bool doSimulation(const Params &params) {
     fmt::print("\n\nError during simulation: {}\n\n", e);
     return false;
   }
+  if (sim.getIsSteadyState()) {
+    fmt::print("\n# Steady state reached at t={}\n",
+               sim.getTimePoints().back());
+  }
   s.exportSMEFile(params.outputFile);
+  if (sim.getHasSteadyStateConcs()) {
+    fmt::print("# Steady state found by Newton-Krylov iterations\n");
+    if (!params.steadyStateOutputFile.empty()) {
+      // the steady state is not part of the simulation results: write it as
+      // the initial concentrations of a model with no simulation results
+      sim.applySteadyStateConcsToModel(s);
+      s.getSimulationData().clear();
+      s.exportSMEFile(params.steadyStateOutputFile);
+      fmt::print("# Steady state written to '{}'\n",
+                 params.steadyStateOutputFile);
+    }
+  }
   return true;
 }
 
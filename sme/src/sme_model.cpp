@@ -9,6 +9,7 @@
 #include <QElapsedTimer>
 #include <QFile>
 #include <QImage>
+#include <limits>
 
 namespace sme {
 
@@ -153,6 +154,8 @@ void pybindModel(pybind11::module &m) {
            pybind11::arg("throw_on_timeout") = true,
            pybind11::arg("simulator_type") = simulate::SimulatorType::Pixel,
            pybind11::arg("continue_existing_simulation") = false,
+           pybind11::arg("steady_state_tolerance") = 0.0,
+           pybind11::arg("newton_krylov") = false,
            R"(
            returns the results of the simulation.
 
@@ -163,6 +166,8 @@ void pybindModel(pybind11::module &m) {
                throw_on_timeout (bool): Whether to throw an exception on simulation timeout. Default value: `true`.
                simulator_type (sme.SimulatorType): The simulator to use: `sme.SimulatorType.DUNE` or `sme.SimulatorType.Pixel`. Default value: Pixel.
                continue_existing_simulation (bool): Whether to continue the existing simulation, or start a new simulation. Default value: `false`, i.e. any existing simulation results are discarded before doing the simulation.
+               steady_state_tolerance (float): Stop the simulation once the largest max|dc/dt| / max|c| of any species is below this value. Default value: `0`, i.e. the simulation is never stopped early.
+               newton_krylov (bool): Pixel simulator only: at each image, try to solve for the steady state directly with Newton-Krylov iterations. Requires `steady_state_tolerance`. Default value: `false`.
 
            Returns:
                SimulationResultList: the results of the simulation
@@ -176,6 +181,8 @@ void pybindModel(pybind11::module &m) {
            pybind11::arg("throw_on_timeout") = true,
            pybind11::arg("simulator_type") = simulate::SimulatorType::Pixel,
            pybind11::arg("continue_existing_simulation") = false,
+           pybind11::arg("steady_state_tolerance") = 0.0,
+           pybind11::arg("newton_krylov") = false,
            R"(
            returns the results of the simulation.
 
@@ -186,13 +193,40 @@ void pybindModel(pybind11::module &m) {
                throw_on_timeout (bool): Whether to throw an exception on simulation timeout. Default value: `true`.
                simulator_type (sme.SimulatorType): The simulator to use: `sme.SimulatorType.DUNE` or `sme.SimulatorType.Pixel`. Default value: Pixel.
                continue_existing_simulation (bool): Whether to continue the existing simulation, or start a new simulation. Default value: `false`, i.e. any existing simulation results are discarded before doing the simulation.
+               steady_state_tolerance (float): Stop the simulation once the largest max|dc/dt| / max|c| of any species is below this value. Default value: `0`, i.e. the simulation is never stopped early.
+               newton_krylov (bool): Pixel simulator only: at each image, try to solve for the steady state directly with Newton-Krylov iterations. Requires `steady_state_tolerance`. Default value: `false`.
 
            Returns:
                SimulationResultList: the results of the simulation
 
            Raises:
                RuntimeError: if the simulation times out or fails
-           )")      .def("__repr__",
+           )")
+      .def_property_readonly("is_steady_state", &sme::Model::getIsSteadyState,
+                             R"(
+                             bool: whether the last simulation stopped because a steady state was reached
+
+                             Requires `steady_state_tolerance` to be set in :meth:`simulate`.
+                             )")
+      .def_property_readonly("dcdt_norm", &sme::Model::getDcdtNorm,
+                             R"(
+                             float: the largest max|dc/dt| / max|c| of any species at the end of the last simulation
+
+                             If `newton_krylov` found a steady state, this is for that steady state.
+                             Only evaluated if `steady_state_tolerance` is set in :meth:`simulate`.
+                             )")
+      .def_property_readonly("steady_state_concentration",
+                             &sme::Model::getSteadyStateConcentration,
+                             R"(
+                             dict: the steady state found by `newton_krylov` in the last simulation
+
+                             This is not one of the simulation results: the last result holds the
+                             concentrations at the time the Newton-Krylov iterations started.
+                             The concentrations are in the same format as
+                             :attr:`SimulationResult.species_concentration`, and the dict is
+                             empty if no steady state was found this way.
+                             )")
+      .def("__repr__",
            [](const sme::Model &a) {
              return fmt::format("<sme.Model named '{}'>", a.getName());
            })
@@ -296,7 +330,8 @@ void Model::exportSmeFile(const std::string &filename) {
 std::vector<SimulationResult> Model::simulateString(const std::string &lengths, const std::string &intervals,
                      int timeoutSeconds, bool throwOnTimeout,
                      simulate::SimulatorType simulatorType,
-                     bool continueExistingSimulation) {
+                     bool continueExistingSimulation,
+                     double steadyStateTolerance, bool newtonKrylov) {
   QElapsedTimer simulationRuntimeTimer;
   simulationRuntimeTimer.start();
   double timeoutMillisecs{static_cast<double>(timeoutSeconds) * 1000.0};
@@ -304,6 +339,9 @@ std::vector<SimulationResult> Model::simulateString(const std::string &lengths,
     s->getSimulationData().clear();
   }
   s->getSimulationSettings().simulatorType = simulatorType;
+  auto &steadyStateOptions{s->getSimulationSettings().options.steadyState};
+  steadyStateOptions.tolerance = steadyStateTolerance;
+  steadyStateOptions.newtonKrylov = newtonKrylov;
   auto times{
       simulate::parseSimulationTimes(lengths.c_str(), intervals.c_str())};
   if (!times.has_value()) {
@@ -325,11 +363,31 @@ std::vector<SimulationResult> Model::simulateString(const std::string &lengths,
 std::vector<SimulationResult> Model::simulateFloat(double simulationTime, double imageInterval,
                      int timeoutSeconds, bool throwOnTimeout,
                      simulate::SimulatorType simulatorType,
-                     bool continueExistingSimulation) {
+                     bool continueExistingSimulation,
+                     double steadyStateTolerance, bool newtonKrylov) {
   return simulateString(QString::number(simulationTime, 'g', 17).toStdString(),
                   QString::number(imageInterval, 'g', 17).toStdString(),
                   timeoutSeconds, throwOnTimeout, simulatorType,
-                  continueExistingSimulation);
+                  continueExistingSimulation, steadyStateTolerance,
+                  newtonKrylov);
+}
+
+bool Model::getIsSteadyState() const {
+  return sim != nullptr && sim->getIsSteadyState();
+}
+
+double Model::getDcdtNorm() const {
+  if (sim == nullptr) {
+    return std::numeric_limits<double>::max();
+  }
+  return sim->getDcdtNorm();
+}
+
+std::map<std::string, PyConc> Model::getSteadyStateConcentration() const {
+  if (sim == nullptr) {
+    return {};
+  }
+  return sim->getPySteadyStateConcs();
 }
 
 std::string Model::getStr() const {
@@ -7,6 +7,7 @@
 #include "sme_membrane.hpp"
 #include "sme_parameter.hpp"
 #include "sme_simulationresult.hpp"
+#include <map>
 #include <memory>
 #include <pybind11/pybind11.h>
 #include <string>
@@ -39,12 +40,17 @@ public:
       const std::string& lengths, const std::string& intervals, int timeoutSeconds,
       bool throwOnTimeout,
       simulate::SimulatorType simulatorType,
-      bool continueExistingSimulation);
+      bool continueExistingSimulation, double steadyStateTolerance,
+      bool newtonKrylov);
   std::vector<SimulationResult> simulateFloat(
       double simulationTime, double imageInterval, int timeoutSeconds,
       bool throwOnTimeout,
       simulate::SimulatorType simulatorType,
-      bool continueExistingSimulation);
+      bool continueExistingSimulation, double steadyStateTolerance,
+      bool newtonKrylov);
+  bool getIsSteadyState() const;
+  double getDcdtNorm() const;
+  std::map<std::string, PyConc> getSteadyStateConcentration() const;
   std::string getStr() const;
 };
 
@@ -144,6 +144,26 @@ class TestModel(unittest.TestCase):
         res2 = m.simulate(10000, 10000, 1, False)
         self.assertEqual(len(res2), 1)
 
+    def test_simulate_steady_state(self):
+        m = sme.open_example_model()
+        # by default the simulation is never stopped early
+        sim_results = m.simulate(0.004, 0.001)
+        self.assertEqual(len(sim_results), 5)
+        self.assertEqual(m.is_steady_state, False)
+        self.assertEqual(m.steady_state_concentration, {})
+        # any tolerance above the dcdt norm stops after the first image
+        sim_results = m.simulate(0.004, 0.001, steady_state_tolerance=1e10)
+        self.assertEqual(len(sim_results), 2)
+        self.assertEqual(m.is_steady_state, True)
+        self.assertLess(m.dcdt_norm, 1e10)
+        # which is already a steady state: no Newton-Krylov solve
+        sim_results = m.simulate(
+            0.004, 0.001, steady_state_tolerance=1e10, newton_krylov=True
+        )
+        self.assertEqual(len(sim_results), 2)
+        self.assertEqual(m.is_steady_state, True)
+        self.assertEqual(m.steady_state_concentration, {})
+
     def test_import_geometry_from_image(self):
         imgfile_original = _get_abs_path("concave-cell-nucleus-100x100.png")
         imgfile_modified = _get_abs_path("modified-concave-cell-nucleus-100x100.png")
@@ -6,6 +6,12 @@
 //  - returns simplified expressions with constants inlined as string
 //  - returns differential of any expression wrt any variable as string
 //  - evaluates expressions (with LLVM compilation)
+//  - evaluates expressions at many points with a vectorised batch kernel
+//  - optionally caches the compiled expressions on disk
+//  - optionally evaluates expressions with a bytecode interpreter while they
+//    are compiled in a background thread (tiered compilation)
+//  - constructs linear combinations & Jacobians of parsed expressions
+//    directly, without converting them to strings and parsing them again
 
 #pragma once
 
@@ -28,6 +34,19 @@ bool symbolicContains(const std::string &expr, const std::string &var);
 
 const char *getLLVMVersion();
 
+// true if expressions can be parsed & compiled concurrently from several
+// threads: requires SymEngine to be built with thread-safe reference counting
+bool isSymbolicThreadSafe();
+
+// directory of the on-disk cache of compiled expressions: the object code of
+// each compiled expression is stored in this directory, keyed by the inlined
+// expressions, variables & compilation options, and is loaded instead of
+// recompiling the same expressions. An empty string disables the cache.
+// Default: the SME_KERNEL_CACHE_DIR environment variable if set, otherwise
+// disabled
+void setKernelCacheDirectory(const std::string &directory);
+std::string getKernelCacheDirectory();
+
 struct Function {
   std::string id;
   std::string name;
@@ -63,7 +82,35 @@ public:
   Symbolic &operator=(const Symbolic &) = delete;
   ~Symbolic();
 
-  void compile(bool doCSE = true, unsigned optLevel = 3);
+  // `batch` also compiles a batch kernel used by the batch eval functions:
+  // only worth the extra compilation time for expressions that are
+  // evaluated at many points
+  void compile(bool doCSE = true, unsigned optLevel = 3, bool batch = false);
+  // compile a single precision version, used by the float eval functions
+  void compileSinglePrecision(bool doCSE = true, unsigned optLevel = 3,
+                              bool batch = false);
+  // tiered compilation: returns immediately, and the expressions are
+  // evaluated by a bytecode interpreter while the LLVM compilation runs in a
+  // background thread. If the interpreter doesn't support the expressions
+  // this is the same as compile() or compileSinglePrecision()
+  void compileTiered(bool doCSE = true, unsigned optLevel = 3,
+                     bool singlePrecision = false, bool batch = false);
+  // switch from the interpreter to the compiled code if the background
+  // compilation has finished, or wait for it to finish if `wait` is true.
+  // Must not be called concurrently with eval. Returns true if the compiled
+  // code is in use
+  bool updateTieredCompilation(bool wait = false);
+  // expression i of the result is the sum over j of coefficients[i][j] times
+  // expression j of the concatenated expressions of all terms, which must use
+  // a subset of the given variables. Missing coefficients are zero
+  static Symbolic
+  linearCombination(const std::vector<Symbolic> &terms,
+                    const std::vector<std::vector<double>> &coefficients,
+                    const std::vector<std::string> &variables);
+  // expression i*variables.size()+j of the result is the derivative of
+  // expression i wrt variables[j]
+  Symbolic jacobian(const std::vector<std::string> &variables) const;
+  std::size_t size() const;
   std::string expr(std::size_t i = 0) const;
   std::string inlinedExpr(std::size_t i = 0) const;
   std::string diff(const std::string &var, std::size_t i = 0) const;
@@ -72,6 +119,17 @@ public:
   void eval(std::vector<double> &results,
             const std::vector<double> &vars = {}) const;
   void eval(double *results, const double *vars) const;
+  // evaluate for n sets of vars: the i-th set starts at vars[i*varStride],
+  // and its results are written starting at results[i*resultStride]. If the
+  // sets are contiguous, i.e. the strides are the number of results & vars,
+  // and the batch kernel was compiled, it evaluates several sets per call,
+  // vectorised across the sets (requires optLevel >= 2)
+  void eval(double *results, const double *vars, std::size_t n,
+            std::size_t resultStride, std::size_t varStride) const;
+  // single precision versions: require compileSinglePrecision()
+  void eval(float *results, const float *vars) const;
+  void eval(float *results, const float *vars, std::size_t n,
+            std::size_t resultStride, std::size_t varStride) const;
   bool isValid() const;
   bool isCompiled() const;
   const std::string &getErrorMessage() const;
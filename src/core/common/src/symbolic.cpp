@@ -1,15 +1,41 @@
 #include "symbolic.hpp"
 #include "logger.hpp"
 #include "utils.hpp"
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QString>
 #include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <limits>
 #include <llvm/Config/llvm-config.h>
-#include <locale>
+#if LLVM_VERSION_MAJOR >= 17
+#include <llvm/TargetParser/Host.h>
+#else
+#include <llvm/Support/Host.h>
+#endif
+#include <llvm/Support/TargetSelect.h>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
+#include <symengine/add.h>
 #include <symengine/basic.h>
 #include <symengine/constants.h>
 #include <symengine/dict.h>
+#include <symengine/eval_double.h>
 #include <symengine/functions.h>
+#include <symengine/integer.h>
 #include <symengine/llvm_double.h>
+#include <symengine/logic.h>
 #include <symengine/mul.h>
 #include <symengine/number.h>
 #include <symengine/parser.h>
@@ -18,9 +44,16 @@
 #include <symengine/rational.h>
 #include <symengine/real_double.h>
 #include <symengine/symbol.h>
+#include <symengine/symengine_config.h>
 #include <symengine/symengine_exception.h>
 #include <symengine/symengine_rcp.h>
 #include <symengine/visitor.h>
+#include <unordered_map>
+#ifdef __APPLE__
+#include <xlocale.h>
+#else
+#include <locale.h>
+#endif
 
 namespace sme::utils {
 
@@ -28,6 +61,592 @@ static std::string toString(const SymEngine::RCP<const SymEngine::Basic> &e) {
   return SymEngine::sbml(*e);
 }
 
+namespace {
+
+// sets the C locale for the current thread only, and restores the previous
+// locale on destruction: the SymEngine parser relies on strtod and assumes
+// the C locale, see https://github.com/symengine/symengine/issues/1566
+class ScopedThreadCLocale {
+#if defined(_WIN32)
+  int previousMode;
+  std::string previousLocale;
+
+public:
+  ScopedThreadCLocale()
+      : previousMode{_configthreadlocale(_ENABLE_PER_THREAD_LOCALE)},
+        previousLocale{std::setlocale(LC_ALL, nullptr)} {
+    std::setlocale(LC_ALL, "C");
+  }
+  ~ScopedThreadCLocale() {
+    std::setlocale(LC_ALL, previousLocale.c_str());
+    _configthreadlocale(previousMode);
+  }
+#else
+  locale_t cLocale;
+  locale_t previousLocale;
+
+public:
+  ScopedThreadCLocale()
+      : cLocale{newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(nullptr))},
+        previousLocale{uselocale(cLocale)} {}
+  ~ScopedThreadCLocale() {
+    uselocale(previousLocale);
+    freelocale(cLocale);
+  }
+#endif
+  ScopedThreadCLocale(const ScopedThreadCLocale &) = delete;
+  ScopedThreadCLocale &operator=(const ScopedThreadCLocale &) = delete;
+  ScopedThreadCLocale(ScopedThreadCLocale &&) = delete;
+  ScopedThreadCLocale &operator=(ScopedThreadCLocale &&) = delete;
+};
+
+struct KernelCacheSettings {
+  std::mutex mutex;
+  std::string directory;
+};
+
+std::string getDefaultKernelCacheDirectory() {
+  if (const char *dir{std::getenv("SME_KERNEL_CACHE_DIR")}; dir != nullptr) {
+    return dir;
+  }
+  return {};
+}
+
+KernelCacheSettings &kernelCacheSettings() {
+  static KernelCacheSettings settings{{}, getDefaultKernelCacheDirectory()};
+  return settings;
+}
+
+} // namespace
+
+void setKernelCacheDirectory(const std::string &directory) {
+  auto &settings{kernelCacheSettings()};
+  std::scoped_lock lock(settings.mutex);
+  settings.directory = directory;
+}
+
+std::string getKernelCacheDirectory() {
+  auto &settings{kernelCacheSettings()};
+  std::scoped_lock lock(settings.mutex);
+  return settings.directory;
+}
+
+// the enabled features of the host CPU, sorted since the order of the map
+// is not specified
+static std::string getHostCPUFeatures() {
+#if LLVM_VERSION_MAJOR >= 19
+  auto features{llvm::sys::getHostCPUFeatures()};
+#else
+  llvm::StringMap<bool> features;
+  llvm::sys::getHostCPUFeatures(features);
+#endif
+  std::vector<std::string> enabled;
+  for (const auto &feature : features) {
+    if (feature.getValue()) {
+      enabled.push_back(feature.getKey().str());
+    }
+  }
+  std::sort(enabled.begin(), enabled.end());
+  std::string str;
+  for (const auto &feature : enabled) {
+    str.append("+").append(feature);
+  }
+  return str;
+}
+
+// the cache key contains everything that affects the compiled object code:
+// the host, LLVM & SymEngine versions, compilation options, variables &
+// expressions
+static std::string getKernelCacheKey(const SymEngine::vec_basic &variables,
+                                     const SymEngine::vec_basic &expressions,
+                                     bool doCSE, unsigned optLevel,
+                                     const char *precision) {
+  static const std::string hostCPUFeatures{getHostCPUFeatures()};
+  std::string key{fmt::format(
+      "sme-kernel-v2\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}\n",
+      LLVM_VERSION_STRING, SYMENGINE_VERSION, LLVM_HOST_TRIPLE,
+      llvm::sys::getHostCPUName().str(), hostCPUFeatures, precision, doCSE,
+      optLevel)};
+  for (const auto &v : variables) {
+    key.append(toString(v)).append(",");
+  }
+  key.append("\n");
+  // the printed expression may round floating point constants, so the
+  // expression hash (which uses their exact values) is also included
+  for (const auto &e : expressions) {
+    key.append(toString(e)).append(fmt::format(" #{}\n", e->hash()));
+  }
+  return key;
+}
+
+static QString getKernelCachePath(const std::string &directory,
+                                  const std::string &key) {
+  auto hash{QCryptographicHash::hash(QByteArray::fromStdString(key),
+                                     QCryptographicHash::Sha256)
+                .toHex()};
+  return QDir(directory.c_str())
+      .filePath(QString("%1.o").arg(QString::fromLatin1(hash)));
+}
+
+// load cached object code into the visitor, returns false on a cache miss
+template <typename LLVMVisitor>
+static bool loadCachedKernel(LLVMVisitor &visitor, const std::string &directory,
+                             const std::string &key) {
+  const auto path{getKernelCachePath(directory, key)};
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  const auto contents{file.readAll().toStdString()};
+  // contents: key, null character, object code
+  if (contents.size() <= key.size() ||
+      contents.compare(0, key.size(), key) != 0 ||
+      contents[key.size()] != '\0') {
+    SPDLOG_DEBUG("ignoring invalid kernel cache file {}", path.toStdString());
+    return false;
+  }
+  try {
+    visitor.loads(contents.substr(key.size() + 1));
+  } catch (const std::exception &e) {
+    SPDLOG_WARN("failed to load kernel cache file {}: {}", path.toStdString(),
+                e.what());
+    return false;
+  }
+  SPDLOG_DEBUG("loaded compiled expressions from {}", path.toStdString());
+  return true;
+}
+
+template <typename LLVMVisitor>
+static void storeCachedKernel(const LLVMVisitor &visitor,
+                              const std::string &directory,
+                              const std::string &key) {
+  const auto path{getKernelCachePath(directory, key)};
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  // QSaveFile writes to a temporary file which is renamed on commit, so
+  // concurrent processes never see a partially written file
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    SPDLOG_WARN("failed to write kernel cache file {}", path.toStdString());
+    return;
+  }
+  const auto &objectCode{visitor.dumps()};
+  file.write(key.data(), static_cast<qint64>(key.size()));
+  file.write("\0", 1);
+  file.write(objectCode.data(), static_cast<qint64>(objectCode.size()));
+  if (!file.commit()) {
+    SPDLOG_WARN("failed to write kernel cache file {}", path.toStdString());
+    return;
+  }
+  SPDLOG_DEBUG("stored compiled expressions in {}", path.toStdString());
+}
+
+// init the visitor, using the kernel cache if enabled
+template <typename LLVMVisitor>
+static void initLLVMVisitor(LLVMVisitor &visitor,
+                            const SymEngine::vec_basic &variables,
+                            const SymEngine::vec_basic &expressions,
+                            bool doCSE, unsigned optLevel,
+                            const char *precision) {
+  // the LLVM target registry is not safe to initialise concurrently: do it
+  // once here, after which the initialisation done by every visitor is a
+  // no-op
+  static std::once_flag llvmInitialised;
+  std::call_once(llvmInitialised, []() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+  });
+  const auto directory{getKernelCacheDirectory()};
+  if (directory.empty()) {
+    visitor.init(variables, expressions, doCSE, optLevel);
+    return;
+  }
+  const auto key{
+      getKernelCacheKey(variables, expressions, doCSE, optLevel, precision)};
+  if (loadCachedKernel(visitor, directory, key)) {
+    return;
+  }
+  visitor.init(variables, expressions, doCSE, optLevel);
+  storeCachedKernel(visitor, directory, key);
+}
+
+// number of points evaluated by one call of the batch kernel
+constexpr std::size_t batchWidth{4};
+
+// the batch kernel evaluates the expressions at batchWidth consecutive
+// points: it is compiled from batchWidth copies of the expressions, each
+// using its own copy of the variables, so that LLVM can vectorise across the
+// copies. Only worth doing if the optimizer runs the SLP vectorizer
+static bool useBatchKernel(const SymEngine::vec_basic &variables,
+                           const SymEngine::vec_basic &expressions,
+                           unsigned optLevel) {
+  return optLevel >= 2 && !variables.empty() && !expressions.empty();
+}
+
+template <typename LLVMVisitor>
+static void initBatchLLVMVisitor(LLVMVisitor &visitor,
+                                 const SymEngine::vec_basic &variables,
+                                 const SymEngine::vec_basic &expressions,
+                                 bool doCSE, unsigned optLevel,
+                                 const char *precision) {
+  SymEngine::vec_basic batchVariables;
+  SymEngine::vec_basic batchExpressions;
+  batchVariables.reserve(batchWidth * variables.size());
+  batchExpressions.reserve(batchWidth * expressions.size());
+  for (std::size_t w = 0; w < batchWidth; ++w) {
+    SymEngine::map_basic_basic d;
+    for (const auto &v : variables) {
+      // not a valid SBML id, so can't clash with any existing symbol
+      auto vw{SymEngine::symbol(fmt::format("{}[{}]", toString(v), w))};
+      d[v] = vw;
+      batchVariables.push_back(vw);
+    }
+    for (const auto &e : expressions) {
+      batchExpressions.push_back(e->xreplace(d));
+    }
+  }
+  initLLVMVisitor(visitor, batchVariables, batchExpressions, doCSE, optLevel,
+                  precision);
+}
+
+// evaluate n points, using the batch kernel for each complete batch of
+// points if they are contiguous, and the single point kernel for the rest
+template <typename T, typename LLVMVisitor>
+static void evalPoints(const LLVMVisitor &lambda,
+                       const LLVMVisitor *batchLambda, T *results,
+                       const T *vars, std::size_t n, std::size_t resultStride,
+                       std::size_t varStride, std::size_t nResults,
+                       std::size_t nVars) {
+  std::size_t i{0};
+  if (batchLambda != nullptr && resultStride == nResults &&
+      varStride == nVars) {
+    for (; i + batchWidth <= n; i += batchWidth) {
+      batchLambda->call(results + i * resultStride, vars + i * varStride);
+    }
+  }
+  for (; i < n; ++i) {
+    lambda.call(results + i * resultStride, vars + i * varStride);
+  }
+}
+
+namespace {
+
+// register-based bytecode for a set of expressions: each instruction writes
+// the register with the same index, and identical subexpressions are only
+// evaluated once. Much slower than the LLVM compiled code, but available
+// immediately
+class Bytecode {
+private:
+  enum class Op : std::uint8_t {
+    Const,
+    Var,
+    Add,
+    Mul,
+    Pow,
+    Log,
+    Sin,
+    Cos,
+    Tan,
+    Asin,
+    Acos,
+    Atan,
+    Sinh,
+    Cosh,
+    Tanh,
+    Abs,
+    Floor,
+    Ceil,
+    Max,
+    Min,
+    Lt,
+    Le,
+    Eq,
+    Ne,
+    And,
+    Or,
+    Not,
+    Select
+  };
+  struct Instruction {
+    Op op;
+    std::uint32_t a;
+    std::uint32_t b;
+    std::uint32_t c;
+    double value;
+  };
+  std::vector<Instruction> code;
+  std::vector<std::uint32_t> outputs;
+  std::unordered_map<SymEngine::RCP<const SymEngine::Basic>, std::uint32_t,
+                     SymEngine::RCPBasicHash, SymEngine::RCPBasicKeyEq>
+      registers;
+  const SymEngine::vec_basic &variables;
+  std::uint32_t emit(Op op, std::uint32_t a = 0, std::uint32_t b = 0,
+                     std::uint32_t c = 0, double value = 0);
+  std::uint32_t fold(Op op, const SymEngine::vec_basic &args);
+  std::uint32_t add(const SymEngine::RCP<const SymEngine::Basic> &e);
+
+public:
+  // throws if an expression is not supported
+  Bytecode(const SymEngine::vec_basic &vars,
+           const SymEngine::vec_basic &expressions);
+  template <typename T> void eval(T *results, const T *vars) const;
+};
+
+std::uint32_t Bytecode::emit(Op op, std::uint32_t a, std::uint32_t b,
+                             std::uint32_t c, double value) {
+  code.push_back({op, a, b, c, value});
+  return static_cast<std::uint32_t>(code.size() - 1);
+}
+
+std::uint32_t Bytecode::fold(Op op, const SymEngine::vec_basic &args) {
+  if (args.empty()) {
+    throw std::invalid_argument("function with no arguments");
+  }
+  std::uint32_t r{add(args[0])};
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    r = emit(op, r, add(args[i]));
+  }
+  return r;
+}
+
+std::uint32_t Bytecode::add(const SymEngine::RCP<const SymEngine::Basic> &e) {
+  if (auto iter{registers.find(e)}; iter != registers.cend()) {
+    return iter->second;
+  }
+  std::uint32_t r;
+  if (SymEngine::is_a_Number(*e) || SymEngine::is_a<SymEngine::Constant>(*e)) {
+    r = emit(Op::Const, 0, 0, 0, SymEngine::eval_double(*e));
+    registers[e] = r;
+    return r;
+  }
+  const auto &args{e->get_args()};
+  auto unary{[this, &args](Op op) { return emit(op, add(args[0])); }};
+  auto binary{[this, &args](Op op) {
+    return emit(op, add(args[0]), add(args[1]));
+  }};
+  switch (e->get_type_code()) {
+  case SymEngine::SYMENGINE_SYMBOL: {
+    auto iter{std::find_if(
+        variables.cbegin(), variables.cend(),
+        [&e](const auto &v) { return SymEngine::eq(*v, *e); })};
+    if (iter == variables.cend()) {
+      throw std::invalid_argument("unknown symbol " + toString(e));
+    }
+    r = emit(Op::Var,
+             static_cast<std::uint32_t>(iter - variables.cbegin()));
+    break;
+  }
+  case SymEngine::SYMENGINE_ADD:
+    r = fold(Op::Add, args);
+    break;
+  case SymEngine::SYMENGINE_MUL:
+    r = fold(Op::Mul, args);
+    break;
+  case SymEngine::SYMENGINE_POW:
+    r = binary(Op::Pow);
+    break;
+  case SymEngine::SYMENGINE_LOG:
+    r = unary(Op::Log);
+    break;
+  case SymEngine::SYMENGINE_SIN:
+    r = unary(Op::Sin);
+    break;
+  case SymEngine::SYMENGINE_COS:
+    r = unary(Op::Cos);
+    break;
+  case SymEngine::SYMENGINE_TAN:
+    r = unary(Op::Tan);
+    break;
+  case SymEngine::SYMENGINE_ASIN:
+    r = unary(Op::Asin);
+    break;
+  case SymEngine::SYMENGINE_ACOS:
+    r = unary(Op::Acos);
+    break;
+  case SymEngine::SYMENGINE_ATAN:
+    r = unary(Op::Atan);
+    break;
+  case SymEngine::SYMENGINE_SINH:
+    r = unary(Op::Sinh);
+    break;
+  case SymEngine::SYMENGINE_COSH:
+    r = unary(Op::Cosh);
+    break;
+  case SymEngine::SYMENGINE_TANH:
+    r = unary(Op::Tanh);
+    break;
+  case SymEngine::SYMENGINE_ABS:
+    r = unary(Op::Abs);
+    break;
+  case SymEngine::SYMENGINE_FLOOR:
+    r = unary(Op::Floor);
+    break;
+  case SymEngine::SYMENGINE_CEILING:
+    r = unary(Op::Ceil);
+    break;
+  case SymEngine::SYMENGINE_MAX:
+    r = fold(Op::Max, args);
+    break;
+  case SymEngine::SYMENGINE_MIN:
+    r = fold(Op::Min, args);
+    break;
+  case SymEngine::SYMENGINE_STRICTLESSTHAN:
+    r = binary(Op::Lt);
+    break;
+  case SymEngine::SYMENGINE_LESSTHAN:
+    r = binary(Op::Le);
+    break;
+  case SymEngine::SYMENGINE_EQUALITY:
+    r = binary(Op::Eq);
+    break;
+  case SymEngine::SYMENGINE_UNEQUALITY:
+    r = binary(Op::Ne);
+    break;
+  case SymEngine::SYMENGINE_AND:
+    r = fold(Op::And, args);
+    break;
+  case SymEngine::SYMENGINE_OR:
+    r = fold(Op::Or, args);
+    break;
+  case SymEngine::SYMENGINE_NOT:
+    r = unary(Op::Not);
+    break;
+  case SymEngine::SYMENGINE_BOOLEAN_ATOM:
+    r = emit(Op::Const, 0, 0, 0,
+             SymEngine::down_cast<const SymEngine::BooleanAtom &>(*e).get_val()
+                 ? 1.0
+                 : 0.0);
+    break;
+  case SymEngine::SYMENGINE_PIECEWISE: {
+    // nested selects, starting from the last (expression, condition) pair:
+    // if no condition is true the result is nan
+    const auto &pieces{
+        SymEngine::down_cast<const SymEngine::Piecewise &>(*e).get_vec()};
+    r = emit(Op::Const, 0, 0, 0, std::numeric_limits<double>::quiet_NaN());
+    for (auto iter = pieces.crbegin(); iter != pieces.crend(); ++iter) {
+      r = emit(Op::Select, add(iter->second), add(iter->first), r);
+    }
+    break;
+  }
+  default:
+    throw std::invalid_argument("unsupported expression " + toString(e));
+  }
+  registers[e] = r;
+  return r;
+}
+
+Bytecode::Bytecode(const SymEngine::vec_basic &vars,
+                   const SymEngine::vec_basic &expressions)
+    : variables{vars} {
+  for (const auto &e : expressions) {
+    outputs.push_back(add(e));
+  }
+  registers.clear();
+  SPDLOG_DEBUG("{} expressions -> {} bytecode instructions", outputs.size(),
+               code.size());
+}
+
+template <typename T> void Bytecode::eval(T *results, const T *vars) const {
+  // evaluated in double precision, with one set of registers per thread
+  thread_local std::vector<double> regs;
+  regs.resize(code.size());
+  for (std::size_t i = 0; i < code.size(); ++i) {
+    const auto &[op, a, b, c, value]{code[i]};
+    double &r{regs[i]};
+    switch (op) {
+    case Op::Const:
+      r = value;
+      break;
+    case Op::Var:
+      r = static_cast<double>(vars[a]);
+      break;
+    case Op::Add:
+      r = regs[a] + regs[b];
+      break;
+    case Op::Mul:
+      r = regs[a] * regs[b];
+      break;
+    case Op::Pow:
+      r = std::pow(regs[a], regs[b]);
+      break;
+    case Op::Log:
+      r = std::log(regs[a]);
+      break;
+    case Op::Sin:
+      r = std::sin(regs[a]);
+      break;
+    case Op::Cos:
+      r = std::cos(regs[a]);
+      break;
+    case Op::Tan:
+      r = std::tan(regs[a]);
+      break;
+    case Op::Asin:
+      r = std::asin(regs[a]);
+      break;
+    case Op::Acos:
+      r = std::acos(regs[a]);
+      break;
+    case Op::Atan:
+      r = std::atan(regs[a]);
+      break;
+    case Op::Sinh:
+      r = std::sinh(regs[a]);
+      break;
+    case Op::Cosh:
+      r = std::cosh(regs[a]);
+      break;
+    case Op::Tanh:
+      r = std::tanh(regs[a]);
+      break;
+    case Op::Abs:
+      r = std::abs(regs[a]);
+      break;
+    case Op::Floor:
+      r = std::floor(regs[a]);
+      break;
+    case Op::Ceil:
+      r = std::ceil(regs[a]);
+      break;
+    case Op::Max:
+      r = std::max(regs[a], regs[b]);
+      break;
+    case Op::Min:
+      r = std::min(regs[a], regs[b]);
+      break;
+    case Op::Lt:
+      r = regs[a] < regs[b] ? 1.0 : 0.0;
+      break;
+    case Op::Le:
+      r = regs[a] <= regs[b] ? 1.0 : 0.0;
+      break;
+    case Op::Eq:
+      r = regs[a] == regs[b] ? 1.0 : 0.0;
+      break;
+    case Op::Ne:
+      r = regs[a] != regs[b] ? 1.0 : 0.0;
+      break;
+    case Op::And:
+      r = (regs[a] != 0.0 && regs[b] != 0.0) ? 1.0 : 0.0;
+      break;
+    case Op::Or:
+      r = (regs[a] != 0.0 || regs[b] != 0.0) ? 1.0 : 0.0;
+      break;
+    case Op::Not:
+      r = regs[a] == 0.0 ? 1.0 : 0.0;
+      break;
+    case Op::Select:
+      r = regs[a] != 0.0 ? regs[b] : regs[c];
+      break;
+    }
+  }
+  for (std::size_t i = 0; i < outputs.size(); ++i) {
+    results[i] = static_cast<T>(regs[outputs[i]]);
+  }
+}
+
+} // namespace
+
 struct Symbolic::SymEngineFunc {
   std::string name;
   SymEngine::vec_basic args;
@@ -39,19 +658,51 @@ struct Symbolic::SymEngineImpl {
   SymEngine::vec_basic exprOriginal{};
   SymEngine::vec_basic varVec{};
   SymEngine::LLVMDoubleVisitor lambdaLLVM{};
+  SymEngine::LLVMFloatVisitor lambdaLLVMFloat{};
+  // batch kernels, see initBatchLLVMVisitor
+  SymEngine::LLVMDoubleVisitor lambdaLLVMBatch{};
+  SymEngine::LLVMFloatVisitor lambdaLLVMFloatBatch{};
+  bool batchCompiled{false};
+  bool batchCompiledFloat{false};
+  // compile the batch kernels if supported
+  bool batchKernel{false};
   std::map<std::string, SymEngine::RCP<const SymEngine::Symbol>> symbols{};
   bool valid{false};
   bool compiled{false};
+  bool compiledFloat{false};
   std::string errorMessage{};
+  // tiered compilation: the interpreter is used until the background
+  // compilation has finished & updateTieredCompilation() is called
+  std::unique_ptr<Bytecode> bytecode{};
+  bool tieredSinglePrecision{false};
+  void initVariables(const std::vector<std::string> &variables);
   void init(const std::vector<std::string> &expressions,
             const std::vector<std::string> &variables,
             const std::vector<std::pair<std::string, double>> &constants,
             const std::vector<Function> &functions);
+  // init the llvm visitors, without setting the compiled flags
+  void initVisitors(bool doCSE, unsigned optLevel);
+  void initVisitorsFloat(bool doCSE, unsigned optLevel);
   void compile(bool doCSE, unsigned optLevel);
+  void compileFloat(bool doCSE, unsigned optLevel);
+  void compileTiered(bool doCSE, unsigned optLevel, bool singlePrecision);
+  bool updateTieredCompilation(bool wait);
   void relabel(const std::vector<std::string> &newVariables);
   void rescale(double factor, const std::vector<std::string> &exclusions = {});
+  // declared last: destroyed first, which waits for the compilation to
+  // finish before the members it uses are destroyed
+  std::future<void> backgroundCompilation{};
 };
 
+void Symbolic::SymEngineImpl::initVariables(
+    const std::vector<std::string> &variables) {
+  for (const auto &v : variables) {
+    SPDLOG_DEBUG("  - variable {}", v);
+    symbols[v] = SymEngine::symbol(v);
+    varVec.push_back(symbols[v]);
+  }
+}
+
 void Symbolic::SymEngineImpl::init(
     const std::vector<std::string> &expressions,
     const std::vector<std::string> &variables,
@@ -60,19 +711,14 @@ void Symbolic::SymEngineImpl::init(
   SPDLOG_DEBUG("parsing {} expressions", expressions.size());
   valid = true;
   compiled = false;
-  for (const auto &v : variables) {
-    SPDLOG_DEBUG("  - variable {}", v);
-    symbols[v] = SymEngine::symbol(v);
-    varVec.push_back(symbols[v]);
-  }
+  compiledFloat = false;
+  initVariables(variables);
   SymEngine::map_basic_basic d;
   for (const auto &[name, value] : constants) {
     SPDLOG_DEBUG("  - constant {} = {}", name, value);
     d[SymEngine::symbol(name)] = SymEngine::real_double(value);
   }
-  // hack until https://github.com/symengine/symengine/issues/1566 is resolved:
-  // (SymEngine parser relies on strtod and assumes C locale)
-  std::locale userLocale = std::locale::global(std::locale::classic());
+  ScopedThreadCLocale cLocale;
   SymEngine::SbmlParser parser;
   // map from function id to symengine expressions
   std::map<std::string, Symbolic::SymEngineFunc> symEngineFuncs;
@@ -115,7 +761,6 @@ void Symbolic::SymEngineImpl::init(
                   fmt::format("Function '{}' requires {} argument(s), found {}",
                               f.name, f.args.size(), args.size());
               SPDLOG_WARN("{}", errorMessage);
-              std::locale::global(userLocale);
               return;
             }
             SymEngine::map_basic_basic arg_map;
@@ -137,7 +782,6 @@ void Symbolic::SymEngineImpl::init(
         valid = false;
         errorMessage = "Recursive function calls not supported";
         SPDLOG_WARN("{}", errorMessage);
-        std::locale::global(userLocale);
         return;
       }
       exprInlined.push_back(e->subs(d));
@@ -146,7 +790,6 @@ void Symbolic::SymEngineImpl::init(
       SPDLOG_WARN("{}", e.what());
       valid = false;
       errorMessage = e.what();
-      std::locale::global(userLocale);
       return;
     }
     SPDLOG_DEBUG("  --> {}", toString(exprInlined.back()));
@@ -161,7 +804,6 @@ void Symbolic::SymEngineImpl::init(
       valid = false;
       errorMessage = "Unknown symbol: " + toString(*iter);
       SPDLOG_WARN("{}", errorMessage);
-      std::locale::global(userLocale);
       return;
     }
     auto fn = SymEngine::function_symbols(*exprInlined.back());
@@ -169,11 +811,9 @@ void Symbolic::SymEngineImpl::init(
       valid = false;
       errorMessage = "Unknown function: " + toString(*fn.begin());
       SPDLOG_WARN("{}", errorMessage);
-      std::locale::global(userLocale);
       return;
     }
   }
-  std::locale::global(userLocale);
 }
 
 void Symbolic::SymEngineImpl::compile(bool doCSE, unsigned optLevel) {
@@ -186,10 +826,91 @@ void Symbolic::SymEngineImpl::compile(bool doCSE, unsigned optLevel) {
     }
   }
 #endif
-  lambdaLLVM.init(varVec, exprInlined, doCSE, optLevel);
+  initVisitors(doCSE, optLevel);
   compiled = true;
 }
 
+void Symbolic::SymEngineImpl::compileFloat(bool doCSE, unsigned optLevel) {
+  SPDLOG_DEBUG("compiling single precision expression");
+  initVisitorsFloat(doCSE, optLevel);
+  compiledFloat = true;
+}
+
+void Symbolic::SymEngineImpl::initVisitors(bool doCSE, unsigned optLevel) {
+  initLLVMVisitor(lambdaLLVM, varVec, exprInlined, doCSE, optLevel, "double");
+  batchCompiled = batchKernel && useBatchKernel(varVec, exprInlined, optLevel);
+  if (batchCompiled) {
+    initBatchLLVMVisitor(lambdaLLVMBatch, varVec, exprInlined, doCSE,
+                         optLevel, "double");
+  }
+}
+
+void Symbolic::SymEngineImpl::initVisitorsFloat(bool doCSE,
+                                                unsigned optLevel) {
+  initLLVMVisitor(lambdaLLVMFloat, varVec, exprInlined, doCSE, optLevel,
+                  "float");
+  batchCompiledFloat =
+      batchKernel && useBatchKernel(varVec, exprInlined, optLevel);
+  if (batchCompiledFloat) {
+    initBatchLLVMVisitor(lambdaLLVMFloatBatch, varVec, exprInlined, doCSE,
+                         optLevel, "float");
+  }
+}
+
+void Symbolic::SymEngineImpl::compileTiered(bool doCSE, unsigned optLevel,
+                                           bool singlePrecision) {
+  updateTieredCompilation(true);
+  try {
+    if (!isSymbolicThreadSafe()) {
+      SPDLOG_WARN("Tiered compilation requires SymEngine to be built with "
+                  "thread-safe reference counting: compiling now instead");
+      throw std::runtime_error("SymEngine is not thread-safe");
+    }
+    bytecode = std::make_unique<Bytecode>(varVec, exprInlined);
+  } catch (const std::exception &e) {
+    SPDLOG_INFO("Tiered compilation not supported: {}, compiling now",
+                e.what());
+    bytecode.reset();
+    if (singlePrecision) {
+      compileFloat(doCSE, optLevel);
+    } else {
+      compile(doCSE, optLevel);
+    }
+    return;
+  }
+  tieredSinglePrecision = singlePrecision;
+  // the background thread only touches the llvm visitors, which are not used
+  // by eval until updateTieredCompilation() has seen the result
+  backgroundCompilation = std::async(
+      std::launch::async, [this, doCSE, optLevel, singlePrecision]() {
+        if (singlePrecision) {
+          initVisitorsFloat(doCSE, optLevel);
+        } else {
+          initVisitors(doCSE, optLevel);
+        }
+      });
+}
+
+bool Symbolic::SymEngineImpl::updateTieredCompilation(bool wait) {
+  if (!backgroundCompilation.valid()) {
+    return bytecode == nullptr;
+  }
+  if (!wait && backgroundCompilation.wait_for(std::chrono::seconds(0)) !=
+                   std::future_status::ready) {
+    return false;
+  }
+  // rethrows any exception from the background thread
+  backgroundCompilation.get();
+  if (tieredSinglePrecision) {
+    compiledFloat = true;
+  } else {
+    compiled = true;
+  }
+  bytecode.reset();
+  SPDLOG_DEBUG("switched from bytecode to compiled expressions");
+  return true;
+}
+
 void Symbolic::SymEngineImpl::relabel(
     const std::vector<std::string> &newVariables) {
   if (varVec.size() != newVariables.size()) {
@@ -198,6 +919,7 @@ void Symbolic::SymEngineImpl::relabel(
                 newVariables.size(), varVec.size());
     return;
   }
+  updateTieredCompilation(true);
   decltype(varVec) newVarVec;
   decltype(symbols) newSymbols;
   SymEngine::map_basic_basic d;
@@ -226,10 +948,14 @@ void Symbolic::SymEngineImpl::relabel(
   if (compiled) {
     compile(true, 3);
   }
+  if (compiledFloat) {
+    compileFloat(true, 3);
+  }
 }
 
 void Symbolic::SymEngineImpl::rescale(
     double factor, const std::vector<std::string> &exclusions) {
+  updateTieredCompilation(true);
   SymEngine::map_basic_basic d;
   auto f = SymEngine::number(factor);
   for (const auto &v : varVec) {
@@ -253,35 +979,50 @@ void Symbolic::SymEngineImpl::rescale(
   if (compiled) {
     compile(true, 3);
   }
+  if (compiledFloat) {
+    compileFloat(true, 3);
+  }
+}
+
+// integer coefficients are kept exact, as they would be if parsed
+static SymEngine::RCP<const SymEngine::Number> toNumber(double value) {
+  if (std::trunc(value) == value &&
+      std::abs(value) <= std::numeric_limits<int>::max()) {
+    return SymEngine::integer(static_cast<int>(value));
+  }
+  return SymEngine::real_double(value);
 }
 
 std::string symbolicDivide(const std::string &expr, const std::string &var) {
-  std::locale userLocale = std::locale::global(std::locale::classic());
-  std::string result = toString(
+  ScopedThreadCLocale cLocale;
+  return toString(
       SymEngine::div(SymEngine::parse_sbml(expr), SymEngine::symbol(var)));
-  std::locale::global(userLocale);
-  return result;
 }
 
 std::string symbolicMultiply(const std::string &expr, const std::string &var) {
-  std::locale userLocale = std::locale::global(std::locale::classic());
-  std::string result = toString(
+  ScopedThreadCLocale cLocale;
+  return toString(
       SymEngine::mul(SymEngine::parse_sbml(expr), SymEngine::symbol(var)));
-  std::locale::global(userLocale);
-  return result;
 }
 
 bool symbolicContains(const std::string &expr, const std::string &var) {
-  std::locale userLocale = std::locale::global(std::locale::classic());
+  ScopedThreadCLocale cLocale;
   auto e{SymEngine::parse_sbml(expr)};
   auto v{SymEngine::symbol(var)};
   auto fs = SymEngine::free_symbols(*e);
-  std::locale::global(userLocale);
   return fs.find(v) != fs.cend();
 }
 
 const char *getLLVMVersion() { return LLVM_VERSION_STRING; }
 
+bool isSymbolicThreadSafe() {
+#ifdef WITH_SYMENGINE_THREAD_SAFE
+  return true;
+#else
+  return false;
+#endif
+}
+
 Symbolic::Symbolic() = default;
 
 Symbolic::Symbolic(const std::vector<std::string> &expressions,
@@ -302,10 +1043,90 @@ Symbolic::Symbolic(Symbolic &&) noexcept = default;
 
 Symbolic &Symbolic::operator=(Symbolic &&) noexcept = default;
 
-void Symbolic::compile(bool doCSE, unsigned optLevel) {
+Symbolic Symbolic::linearCombination(
+    const std::vector<Symbolic> &terms,
+    const std::vector<std::vector<double>> &coefficients,
+    const std::vector<std::string> &variables) {
+  Symbolic sym;
+  sym.pSymEngineImpl = std::make_unique<SymEngineImpl>();
+  auto &impl{*sym.pSymEngineImpl};
+  impl.initVariables(variables);
+  impl.valid = true;
+  SymEngine::vec_basic termsInlined;
+  SymEngine::vec_basic termsOriginal;
+  for (const auto &term : terms) {
+    const auto &t{*term.pSymEngineImpl};
+    if (!t.valid) {
+      impl.valid = false;
+      impl.errorMessage = t.errorMessage;
+      return sym;
+    }
+    termsInlined.insert(termsInlined.end(), t.exprInlined.cbegin(),
+                        t.exprInlined.cend());
+    termsOriginal.insert(termsOriginal.end(), t.exprOriginal.cbegin(),
+                         t.exprOriginal.cend());
+  }
+  SPDLOG_DEBUG("constructing {} linear combinations of {} terms",
+               coefficients.size(), termsInlined.size());
+  for (const auto &row : coefficients) {
+    SymEngine::vec_basic inlined;
+    SymEngine::vec_basic original;
+    for (std::size_t j = 0; j < std::min(row.size(), termsInlined.size());
+         ++j) {
+      if (row[j] == 0.0) {
+        continue;
+      }
+      auto c{toNumber(row[j])};
+      inlined.push_back(SymEngine::mul(c, termsInlined[j]));
+      original.push_back(SymEngine::mul(c, termsOriginal[j]));
+    }
+    impl.exprInlined.push_back(SymEngine::add(inlined));
+    impl.exprOriginal.push_back(SymEngine::add(original));
+    SPDLOG_DEBUG("  --> {}", toString(impl.exprInlined.back()));
+  }
+  return sym;
+}
+
+Symbolic Symbolic::jacobian(const std::vector<std::string> &variables) const {
+  Symbolic sym;
+  sym.pSymEngineImpl = std::make_unique<SymEngineImpl>();
+  auto &impl{*sym.pSymEngineImpl};
+  impl.varVec = pSymEngineImpl->varVec;
+  impl.symbols = pSymEngineImpl->symbols;
+  impl.valid = pSymEngineImpl->valid;
+  impl.errorMessage = pSymEngineImpl->errorMessage;
+  if (!impl.valid) {
+    return sym;
+  }
+  std::vector<SymEngine::RCP<const SymEngine::Symbol>> vars;
+  vars.reserve(variables.size());
+  for (const auto &v : variables) {
+    vars.push_back(SymEngine::symbol(v));
+  }
+  for (const auto &e : pSymEngineImpl->exprInlined) {
+    for (const auto &v : vars) {
+      impl.exprInlined.push_back(e->diff(v));
+    }
+  }
+  impl.exprOriginal = impl.exprInlined;
+  return sym;
+}
+
+std::size_t Symbolic::size() const {
+  return pSymEngineImpl->exprInlined.size();
+}
+
+void Symbolic::compile(bool doCSE, unsigned optLevel, bool batch) {
+  pSymEngineImpl->batchKernel = batch;
   pSymEngineImpl->compile(doCSE, optLevel);
 }
 
+void Symbolic::compileSinglePrecision(bool doCSE, unsigned optLevel,
+                                      bool batch) {
+  pSymEngineImpl->batchKernel = batch;
+  pSymEngineImpl->compileFloat(doCSE, optLevel);
+}
+
 std::string Symbolic::expr(std::size_t i) const {
   return toString(pSymEngineImpl->exprOriginal[i]);
 }
@@ -320,6 +1141,18 @@ std::string Symbolic::diff(const std::string &var, std::size_t i) const {
   return toString(dexpr_dvar);
 }
 
+void Symbolic::compileTiered(bool doCSE, unsigned optLevel,
+                             bool singlePrecision, bool batch) {
+  // a previous background compilation may still be reading batchKernel
+  pSymEngineImpl->updateTieredCompilation(true);
+  pSymEngineImpl->batchKernel = batch;
+  pSymEngineImpl->compileTiered(doCSE, optLevel, singlePrecision);
+}
+
+bool Symbolic::updateTieredCompilation(bool wait) {
+  return pSymEngineImpl->updateTieredCompilation(wait);
+}
+
 void Symbolic::relabel(const std::vector<std::string> &newVariables) {
   pSymEngineImpl->relabel(newVariables);
 }
@@ -331,13 +1164,55 @@ void Symbolic::rescale(double factor,
 
 void Symbolic::eval(std::vector<double> &results,
                     const std::vector<double> &vars) const {
-  pSymEngineImpl->lambdaLLVM.call(results.data(), vars.data());
+  eval(results.data(), vars.data());
 }
 
 void Symbolic::eval(double *results, const double *vars) const {
+  if (const auto &bytecode{pSymEngineImpl->bytecode}; bytecode != nullptr) {
+    bytecode->eval(results, vars);
+    return;
+  }
   pSymEngineImpl->lambdaLLVM.call(results, vars);
 }
 
+void Symbolic::eval(double *results, const double *vars, std::size_t n,
+                    std::size_t resultStride, std::size_t varStride) const {
+  if (const auto &bytecode{pSymEngineImpl->bytecode}; bytecode != nullptr) {
+    for (std::size_t i = 0; i < n; ++i) {
+      bytecode->eval(results + i * resultStride, vars + i * varStride);
+    }
+    return;
+  }
+  const auto &impl{*pSymEngineImpl};
+  evalPoints(impl.lambdaLLVM,
+             impl.batchCompiled ? &impl.lambdaLLVMBatch : nullptr, results,
+             vars, n, resultStride, varStride, impl.exprInlined.size(),
+             impl.varVec.size());
+}
+
+void Symbolic::eval(float *results, const float *vars) const {
+  if (const auto &bytecode{pSymEngineImpl->bytecode}; bytecode != nullptr) {
+    bytecode->eval(results, vars);
+    return;
+  }
+  pSymEngineImpl->lambdaLLVMFloat.call(results, vars);
+}
+
+void Symbolic::eval(float *results, const float *vars, std::size_t n,
+                    std::size_t resultStride, std::size_t varStride) const {
+  if (const auto &bytecode{pSymEngineImpl->bytecode}; bytecode != nullptr) {
+    for (std::size_t i = 0; i < n; ++i) {
+      bytecode->eval(results + i * resultStride, vars + i * varStride);
+    }
+    return;
+  }
+  const auto &impl{*pSymEngineImpl};
+  evalPoints(impl.lambdaLLVMFloat,
+             impl.batchCompiledFloat ? &impl.lambdaLLVMFloatBatch : nullptr,
+             results, vars, n, resultStride, varStride,
+             impl.exprInlined.size(), impl.varVec.size());
+}
+
 bool Symbolic::isValid() const { return pSymEngineImpl->valid; }
 
 bool Symbolic::isCompiled() const { return pSymEngineImpl->compiled; }
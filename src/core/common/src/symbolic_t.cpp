@@ -1,7 +1,13 @@
 #include "catch_wrapper.hpp"
 #include "math_test_utils.hpp"
 #include "symbolic.hpp"
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <clocale>
 #include <cmath>
+#include <future>
+#include <string>
 
 using namespace sme;
 
@@ -153,6 +159,54 @@ SCENARIO("Symbolic", "[core/common/symbolic][core/common][core][symbolic]") {
         }
       }
     }
+    // batch evaluation with strided input & output
+    std::vector<double> vars{0.2, 0.3, 0.4, -1, 1.1, 1.2, 1.3, -1};
+    std::vector<double> results(6, -99);
+    sym.eval(results.data(), vars.data(), 2, 3, 4);
+    REQUIRE(results[0] == dbl_approx(3 * 0.2 + 4 / 0.3 - 1.0 * 0.2 +
+                                     0.2 * 0.2 * 0.3 - 0.1));
+    REQUIRE(results[1] == dbl_approx(0.4 - cos(0.2) * sin(0.3) - 0.2 * 0.3));
+    REQUIRE(results[2] == dbl_approx(-99));
+    REQUIRE(results[3] == dbl_approx(3 * 1.1 + 4 / 1.2 - 1.0 * 1.1 +
+                                     0.2 * 1.1 * 1.2 - 0.1));
+    REQUIRE(results[4] == dbl_approx(1.3 - cos(1.1) * sin(1.2) - 1.1 * 1.2));
+    REQUIRE(results[5] == dbl_approx(-99));
+    // single precision batch evaluation
+    sym.compileSinglePrecision();
+    std::vector<float> varsFloat{0.2f, 0.3f, 0.4f, 1.1f, 1.2f, 1.3f};
+    std::vector<float> resultsFloat(4, -99.0f);
+    sym.eval(resultsFloat.data(), varsFloat.data(), 2, 2, 3);
+    double x0{3 * 0.2 + 4 / 0.3 - 1.0 * 0.2 + 0.2 * 0.2 * 0.3 - 0.1};
+    double x3{1.3 - cos(1.1) * sin(1.2) - 1.1 * 1.2};
+    REQUIRE(static_cast<double>(resultsFloat[0]) ==
+            Catch::Approx(x0).epsilon(1e-6));
+    REQUIRE(static_cast<double>(resultsFloat[3]) ==
+            Catch::Approx(x3).epsilon(1e-6));
+    // contiguous batch evaluation: batch kernel for complete batches of
+    // points, single point kernel for the rest
+    sym.compile(true, 3, true);
+    sym.compileSinglePrecision(true, 3, true);
+    for (auto n : std::vector<std::size_t>{1, 4, 11}) {
+      CAPTURE(n);
+      std::vector<double> batchVars(3 * n);
+      for (std::size_t i = 0; i < batchVars.size(); ++i) {
+        batchVars[i] = 0.1 + 0.37 * static_cast<double>(i);
+      }
+      std::vector<double> batchResults(2 * n, -99);
+      sym.eval(batchResults.data(), batchVars.data(), n, 2, 3);
+      std::vector<float> batchVarsFloat(batchVars.cbegin(), batchVars.cend());
+      std::vector<float> batchResultsFloat(2 * n, -99.0f);
+      sym.eval(batchResultsFloat.data(), batchVarsFloat.data(), n, 2, 3);
+      for (std::size_t i = 0; i < n; ++i) {
+        sym.eval(res, {batchVars[3 * i], batchVars[3 * i + 1],
+                       batchVars[3 * i + 2]});
+        for (std::size_t j = 0; j < 2; ++j) {
+          REQUIRE(batchResults[2 * i + j] == dbl_approx(res[j]));
+          REQUIRE(static_cast<double>(batchResultsFloat[2 * i + j]) ==
+                  Catch::Approx(res[j]).epsilon(1e-5));
+        }
+      }
+    }
   }
   GIVEN("exponentiale^(4*x): print exponential function") {
     std::string expr = "exponentiale^(4*x)";
@@ -413,3 +467,228 @@ SCENARIO("Symbolic", "[core/common/symbolic][core/common][core][symbolic]") {
             true);
   }
 }
+
+SCENARIO("Symbolic: kernel cache",
+         "[core/common/symbolic][core/common][core][symbolic]") {
+  const auto previousDir{utils::getKernelCacheDirectory()};
+  QTemporaryDir tmpDir;
+  REQUIRE(tmpDir.isValid());
+  // cache directory is created if it doesn't exist
+  const QString dir{QDir(tmpDir.path()).filePath("cache")};
+  auto cacheFiles{[&dir]() {
+    return QDir(dir).entryList(QDir::Files);
+  }};
+  utils::setKernelCacheDirectory(dir.toStdString());
+  REQUIRE(utils::getKernelCacheDirectory() == dir.toStdString());
+  std::vector<double> res(2, 0);
+  std::vector<std::string> expr{"3*x + y", "x*y - 2"};
+  WHEN("compile: stored in cache") {
+    utils::Symbolic sym(expr, {"x", "y"});
+    REQUIRE(sym.isCompiled());
+    REQUIRE(cacheFiles().size() == 1);
+    sym.eval(res, {1.0, 2.0});
+    REQUIRE(res[0] == dbl_approx(5.0));
+    REQUIRE(res[1] == dbl_approx(0.0));
+    // same expressions: loaded from cache
+    utils::Symbolic sym2(expr, {"x", "y"});
+    REQUIRE(cacheFiles().size() == 1);
+    sym2.eval(res, {2.0, 3.0});
+    REQUIRE(res[0] == dbl_approx(9.0));
+    REQUIRE(res[1] == dbl_approx(4.0));
+    // different opt level or precision: new cache entry
+    utils::Symbolic sym3(expr, {"x", "y"}, {}, {}, true, true, 1);
+    REQUIRE(cacheFiles().size() == 2);
+    sym3.compileSinglePrecision();
+    REQUIRE(cacheFiles().size() == 3);
+    std::vector<float> resFloat(2, 0);
+    std::vector<float> vars{2.0f, 3.0f};
+    sym3.eval(resFloat.data(), vars.data());
+    REQUIRE(resFloat[0] == Catch::Approx(9.0f));
+    REQUIRE(resFloat[1] == Catch::Approx(4.0f));
+  }
+  WHEN("invalid cache file: recompiled & replaced") {
+    { utils::Symbolic sym(expr, {"x", "y"}); }
+    REQUIRE(cacheFiles().size() == 1);
+    QFile file(QDir(dir).filePath(cacheFiles()[0]));
+    REQUIRE(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("invalid");
+    file.close();
+    utils::Symbolic sym(expr, {"x", "y"});
+    sym.eval(res, {1.0, 2.0});
+    REQUIRE(res[0] == dbl_approx(5.0));
+    REQUIRE(res[1] == dbl_approx(0.0));
+    REQUIRE(cacheFiles().size() == 1);
+    REQUIRE(file.size() > 7);
+  }
+  WHEN("cache disabled") {
+    utils::setKernelCacheDirectory("");
+    utils::Symbolic sym(expr, {"x", "y"});
+    REQUIRE(sym.isCompiled());
+    REQUIRE(cacheFiles().isEmpty());
+  }
+  utils::setKernelCacheDirectory(previousDir);
+}
+
+SCENARIO("Symbolic: tiered compilation",
+         "[core/common/symbolic][core/common][core][symbolic]") {
+  std::vector<std::string> expr{"3*x + y^2 - 2", "sin(x)*exp(y)/(1 + x)",
+                                "piecewise(x, lt(x, y), y) + abs(x - y)",
+                                "log(1 + x*x)*cos(y) + 3*x + y^2"};
+  std::vector<std::vector<double>> inputs{
+      {0.0, 1.0}, {0.3, -0.2}, {1.5, 1.2}, {-2.0, 0.7}};
+  // reference values from compiled expressions
+  utils::Symbolic symCompiled(expr, {"x", "y"});
+  std::vector<std::vector<double>> ref;
+  for (const auto &v : inputs) {
+    auto &r{ref.emplace_back(expr.size(), 0.0)};
+    symCompiled.eval(r, v);
+  }
+  std::vector<double> res(expr.size(), 0);
+  WHEN("double precision") {
+    utils::Symbolic sym(expr, {"x", "y"}, {}, {}, false);
+    REQUIRE(sym.isCompiled() == false);
+    sym.compileTiered();
+    // compiled immediately instead if SymEngine is not thread-safe
+    REQUIRE(sym.isCompiled() == !utils::isSymbolicThreadSafe());
+    // interpreter
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+      sym.eval(res, inputs[i]);
+      for (std::size_t j = 0; j < expr.size(); ++j) {
+        REQUIRE(res[j] == dbl_approx(ref[i][j]));
+      }
+    }
+    // compiled
+    REQUIRE(sym.updateTieredCompilation(true) == true);
+    REQUIRE(sym.isCompiled() == true);
+    REQUIRE(sym.updateTieredCompilation() == true);
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+      sym.eval(res, inputs[i]);
+      for (std::size_t j = 0; j < expr.size(); ++j) {
+        REQUIRE(res[j] == dbl_approx(ref[i][j]));
+      }
+    }
+  }
+  WHEN("single precision") {
+    utils::Symbolic sym(expr, {"x", "y"}, {}, {}, false);
+    sym.compileTiered(true, 3, true);
+    std::vector<float> resFloat(expr.size(), 0);
+    for (bool compiled : {false, true}) {
+      if (compiled) {
+        REQUIRE(sym.updateTieredCompilation(true) == true);
+      }
+      for (std::size_t i = 0; i < inputs.size(); ++i) {
+        std::vector<float> vars{static_cast<float>(inputs[i][0]),
+                                static_cast<float>(inputs[i][1])};
+        sym.eval(resFloat.data(), vars.data());
+        for (std::size_t j = 0; j < expr.size(); ++j) {
+          REQUIRE(resFloat[j] ==
+                  Catch::Approx(static_cast<float>(ref[i][j])).epsilon(1e-5));
+        }
+      }
+    }
+  }
+  WHEN("relabel waits for the background compilation") {
+    utils::Symbolic sym(expr, {"x", "y"}, {}, {}, false);
+    sym.compileTiered();
+    sym.relabel({"a", "b"});
+    REQUIRE(sym.isCompiled() == true);
+    sym.eval(res, inputs[2]);
+    for (std::size_t j = 0; j < expr.size(); ++j) {
+      REQUIRE(res[j] == dbl_approx(ref[2][j]));
+    }
+  }
+}
+
+SCENARIO("Symbolic: concurrent parsing and compilation",
+         "[core/common/symbolic][core/common][core][symbolic]") {
+  // global locale is not modified
+  const std::string cLocale{std::setlocale(LC_ALL, nullptr)};
+  utils::Symbolic sym0("2.5*x", {"x"});
+  REQUIRE(std::setlocale(LC_ALL, nullptr) == cLocale);
+  REQUIRE(utils::symbolicDivide("x", "1.3") == "x/1.3");
+  REQUIRE(std::setlocale(LC_ALL, nullptr) == cLocale);
+  if (!utils::isSymbolicThreadSafe()) {
+    return;
+  }
+  constexpr int nThreads{8};
+  std::vector<std::future<std::vector<double>>> futures;
+  for (int i = 0; i < nThreads; ++i) {
+    futures.push_back(std::async(std::launch::async, [i]() {
+      auto n{std::to_string(i)};
+      utils::Symbolic sym({n + ".5*x + y", "sin(" + n + "*x)*y"}, {"x", "y"});
+      std::vector<double> res(2, 0);
+      sym.eval(res, {0.5, 2.0});
+      return res;
+    }));
+  }
+  for (int i = 0; i < nThreads; ++i) {
+    auto res{futures[static_cast<std::size_t>(i)].get()};
+    REQUIRE(res[0] == dbl_approx((i + 0.5) * 0.5 + 2.0));
+    REQUIRE(res[1] == dbl_approx(std::sin(i * 0.5) * 2.0));
+  }
+}
+
+SCENARIO("Symbolic: linear combinations and Jacobian",
+         "[core/common/symbolic][core/common][core][symbolic]") {
+  std::vector<std::string> vars{"x", "y", "z"};
+  std::vector<std::pair<std::string, double>> constants{{"k", 0.5}};
+  std::vector<utils::Function> functions{{"f", "f", {"a"}, "2*a"}};
+  // terms are parsed separately, with their own constants & functions
+  std::vector<utils::Symbolic> terms;
+  terms.emplace_back("k*x*y", vars, constants, functions, false);
+  terms.emplace_back(std::vector<std::string>{"f(y)", "z"}, vars,
+                     std::vector<std::pair<std::string, double>>{}, functions,
+                     false);
+  WHEN("linear combinations") {
+    auto sym{utils::Symbolic::linearCombination(
+        terms, {{1.0, 0.0, -3.0}, {-2.0, 1.5}, {}}, vars)};
+    REQUIRE(sym.isValid());
+    REQUIRE(sym.isCompiled() == false);
+    REQUIRE(sym.size() == 3);
+    REQUIRE(symEq(sym.inlinedExpr(0), "0.5*x*y - 3*z"));
+    REQUIRE(symEq(sym.inlinedExpr(1), "-x*y + 3*y"));
+    REQUIRE(symEq(sym.inlinedExpr(2), "0"));
+    sym.compile();
+    std::vector<double> res(3, 0);
+    sym.eval(res, {1.0, 2.0, 3.0});
+    REQUIRE(res[0] == dbl_approx(-8.0));
+    REQUIRE(res[1] == dbl_approx(4.0));
+    REQUIRE(res[2] == dbl_approx(0.0));
+    THEN("Jacobian") {
+      auto jac{sym.jacobian(vars)};
+      REQUIRE(jac.isValid());
+      REQUIRE(jac.size() == 9);
+      REQUIRE(symEq(jac.inlinedExpr(0), "0.5*y"));
+      REQUIRE(symEq(jac.inlinedExpr(1), "0.5*x"));
+      REQUIRE(symEq(jac.inlinedExpr(2), "-3"));
+      REQUIRE(symEq(jac.inlinedExpr(3), "-y"));
+      REQUIRE(symEq(jac.inlinedExpr(4), "-x + 3"));
+      REQUIRE(symEq(jac.inlinedExpr(5), "0"));
+      for (std::size_t i = 6; i < 9; ++i) {
+        REQUIRE(symEq(jac.inlinedExpr(i), "0"));
+      }
+      jac.compile();
+      std::vector<double> jacRes(9, 0);
+      jac.eval(jacRes, {1.0, 2.0, 3.0});
+      REQUIRE(jacRes[0] == dbl_approx(1.0));
+      REQUIRE(jacRes[4] == dbl_approx(2.0));
+    }
+    THEN("relabel & rescale") {
+      sym.rescale(2.0, {"z"});
+      sym.relabel({"a", "b", "c"});
+      REQUIRE(symEq(sym.inlinedExpr(0), "2*a*b - 3*c"));
+      REQUIRE(symEq(sym.inlinedExpr(1), "-4*a*b + 6*b"));
+    }
+  }
+  WHEN("invalid term") {
+    terms.emplace_back("x + q", vars, constants, functions, false);
+    REQUIRE(terms.back().isValid() == false);
+    auto sym{utils::Symbolic::linearCombination(terms, {{1.0, 1.0, 1.0, 1.0}},
+                                                vars)};
+    REQUIRE(sym.isValid() == false);
+    REQUIRE(sym.getErrorMessage() == "Unknown symbol: q");
+    auto jac{sym.jacobian(vars)};
+    REQUIRE(jac.isValid() == false);
+    REQUIRE(jac.size() == 0);
+  }
+}
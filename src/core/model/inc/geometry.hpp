@@ -11,6 +11,7 @@
 #include <QPoint>
 #include <QRgb>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
@@ -22,7 +23,7 @@ namespace geometry {
 class Compartment {
 private:
   // indices of nearest neighbours
-  std::vector<std::size_t> nn;
+  std::vector<std::uint32_t> nn;
   std::string compartmentId;
   // vector of points that make up compartment
   std::vector<QPoint> ix;
@@ -47,6 +48,11 @@ public:
   inline std::size_t dn_x(std::size_t i) const { return nn[4 * i + 1]; }
   inline std::size_t up_y(std::size_t i) const { return nn[4 * i + 2]; }
   inline std::size_t dn_y(std::size_t i) const { return nn[4 * i + 3]; }
+  // neighbours of each point, in the order +x, -x, +y, -y
+  const std::vector<std::uint32_t> &getNeighbourIndices() const;
+  // permutation of point indices along a Morton (Z-order) curve:
+  // element i is the index of the i-th point in this ordering
+  std::vector<std::size_t> getMortonOrdering() const;
   // return a QImage of the compartment geometry
   const QImage &getCompartmentImage() const;
   const std::vector<std::size_t> &getArrayPoints() const;
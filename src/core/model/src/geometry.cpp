@@ -2,8 +2,10 @@
 #include "logger.hpp"
 #include "utils.hpp"
 #include <algorithm>
+#include <cstdint>
 #include <initializer_list>
 #include <limits>
+#include <numeric>
 #include <optional>
 #include <stdexcept>
 #include <utility>
@@ -111,6 +113,10 @@ Compartment::Compartment(std::string compId, const QImage &img, QRgb col)
 
   utils::QPointIndexer ixIndexer(img.size(), ix);
   // find nearest neighbours of each point
+  // (stored as 32-bit indices to reduce memory traffic in stencil operations)
+  if (ix.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::invalid_argument("Too many pixels in compartment");
+  }
   nn.clear();
   nn.reserve(4 * ix.size());
   // find neighbours of each pixel in compartment
@@ -122,11 +128,11 @@ Compartment::Compartment(std::string compId, const QImage &img, QRgb col)
       auto index = ixIndexer.getIndex(pp);
       if (index) {
         // neighbour of p is in same compartment
-        nn.push_back(index.value());
+        nn.push_back(static_cast<std::uint32_t>(index.value()));
       } else {
         // neighbour of p is outside compartment
         // Neumann zero flux bcs: set external neighbour of p to itself
-        nn.push_back(i);
+        nn.push_back(static_cast<std::uint32_t>(i));
       }
     }
   }
@@ -145,6 +151,40 @@ const std::vector<std::size_t> &Compartment::getArrayPoints() const {
   return arrayPoints;
 }
 
+const std::vector<std::uint32_t> &Compartment::getNeighbourIndices() const {
+  return nn;
+}
+
+// interleave the bits of x and y
+static std::uint64_t mortonCode(int x, int y) {
+  auto spreadBits{[](std::uint64_t v) {
+    v &= 0x00000000ffffffff;
+    v = (v | (v << 16)) & 0x0000ffff0000ffff;
+    v = (v | (v << 8)) & 0x00ff00ff00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0f;
+    v = (v | (v << 2)) & 0x3333333333333333;
+    v = (v | (v << 1)) & 0x5555555555555555;
+    return v;
+  }};
+  return spreadBits(static_cast<std::uint64_t>(x)) |
+         (spreadBits(static_cast<std::uint64_t>(y)) << 1);
+}
+
+std::vector<std::size_t> Compartment::getMortonOrdering() const {
+  std::vector<std::uint64_t> codes;
+  codes.reserve(ix.size());
+  for (const auto &p : ix) {
+    codes.push_back(mortonCode(p.x(), p.y()));
+  }
+  std::vector<std::size_t> order(ix.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&codes](std::size_t a, std::size_t b) {
+                     return codes[a] < codes[b];
+                   });
+  return order;
+}
+
 Membrane::Membrane(std::string membraneId, const Compartment *A,
                    const Compartment *B,
                    const std::vector<std::pair<QPoint, QPoint>> *membranePairs)
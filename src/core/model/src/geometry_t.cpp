@@ -1,5 +1,6 @@
 #include "catch_wrapper.hpp"
 #include "geometry.hpp"
+#include <algorithm>
 
 using namespace sme;
 
@@ -163,6 +164,42 @@ SCENARIO("Geometry: Compartments and Fields",
     REQUIRE(field.getConcentration()[0] == dbl_approx(0.0));
     REQUIRE(field.getConcentration()[1] == dbl_approx(0.0));
   }
+  WHEN("getMortonOrdering") {
+    QImage img(4, 4, QImage::Format_RGB32);
+    auto col = qRgb(12, 12, 12);
+    img.fill(col);
+    geometry::Compartment comp("comp", img, col);
+    REQUIRE(comp.nPixels() == 16);
+    REQUIRE(comp.getNeighbourIndices().size() == 4 * comp.nPixels());
+    // pixels are stored column by column
+    REQUIRE(comp.getPixel(1) == QPoint(0, 1));
+    REQUIRE(comp.getPixel(4) == QPoint(1, 0));
+    // interior pixel (1,1): neighbours at fixed offsets
+    REQUIRE(comp.getPixel(5) == QPoint(1, 1));
+    REQUIRE(comp.up_x(5) == 9);
+    REQUIRE(comp.dn_x(5) == 1);
+    REQUIRE(comp.up_y(5) == 6);
+    REQUIRE(comp.dn_y(5) == 4);
+    // boundary pixel (0,0): outside neighbours are itself
+    REQUIRE(comp.up_x(0) == 4);
+    REQUIRE(comp.dn_x(0) == 0);
+    REQUIRE(comp.up_y(0) == 1);
+    REQUIRE(comp.dn_y(0) == 0);
+    auto order{comp.getMortonOrdering()};
+    REQUIRE(order.size() == comp.nPixels());
+    // Z-order curve visits each 2x2 block in turn
+    REQUIRE(comp.getPixel(order[0]) == QPoint(0, 0));
+    REQUIRE(comp.getPixel(order[1]) == QPoint(1, 0));
+    REQUIRE(comp.getPixel(order[2]) == QPoint(0, 1));
+    REQUIRE(comp.getPixel(order[3]) == QPoint(1, 1));
+    REQUIRE(comp.getPixel(order[4]) == QPoint(2, 0));
+    REQUIRE(comp.getPixel(order[15]) == QPoint(3, 3));
+    // order is a permutation of the pixel indices
+    std::sort(order.begin(), order.end());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      REQUIRE(order[i] == i);
+    }
+  }
   WHEN("getConcentrationImageArray") {
     QImage img(":/geometry/concave-cell-nucleus-100x100.png");
     QRgb col0 = img.pixel(0, 0);
@@ -3,14 +3,18 @@
 //  - constructs PDE reaction terms:
 //  R(speciesScaleFactor*species_vector)*reactionScaleFactor
 //  - also Jacobian of reaction terms for each species
+//  - optionally leaves some constants as variables (runtime parameters)
 //  - factor to rescale species
 //  - factor to rescale reaction
+//  - expressions are constructed as symbolic expressions, and only converted
+//  to strings if requested
 // Reaction class
 //  - construct matrix of stoich coefficients and reaction terms as strings
 //  - along with a map of constants
 
 #pragma once
 
+#include "symbolic.hpp"
 #include <cstddef>
 #include <map>
 #include <stdexcept>
@@ -38,8 +42,16 @@ struct PdeScaleFactors {
 
 class Pde {
 private:
-  std::vector<std::string> rhs;
-  std::vector<std::vector<std::string>> jacobian;
+  utils::Symbolic rhsSymbolic;
+  utils::Symbolic jacobianSymbolic;
+  std::size_t nRHS{0};
+  std::size_t nJacobianColumns{0};
+  // set once the symbolic expressions have been moved out of this Pde
+  bool rhsTaken{false};
+  bool jacobianTaken{false};
+  // string versions of the expressions, only generated if requested
+  mutable std::vector<std::string> rhs;
+  mutable std::vector<std::vector<std::string>> jacobian;
 
 public:
   explicit Pde(const model::Model *doc_ptr,
@@ -49,9 +61,17 @@ public:
                const PdeScaleFactors &pdeScaleFactors = {},
                const std::vector<std::string> &extraVariables = {},
                const std::vector<std::string> &relabelledExtraVariables = {},
-               const std::map<std::string, double, std::less<>> &substitutions = {});
+               const std::map<std::string, double, std::less<>> &substitutions = {},
+               const std::vector<std::string> &runtimeParameters = {});
+  // the expressions are converted to strings on the first call: throws a
+  // PdeError if the symbolic expressions were already taken before that
   const std::vector<std::string> &getRHS() const;
   const std::vector<std::vector<std::string>> &getJacobian() const;
+  // the same expressions without converting them to strings, with the
+  // (relabelled) species, extra variables & runtime parameters as variables,
+  // and the Jacobian flattened to a row-major vector of expressions
+  utils::Symbolic takeSymbolicRHS() &&;
+  utils::Symbolic takeSymbolicJacobian() &&;
 };
 
 class Reaction {
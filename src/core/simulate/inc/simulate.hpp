@@ -54,11 +54,24 @@ private:
   std::atomic<bool> isRunning{false};
   std::atomic<bool> stopRequested{false};
   std::atomic<std::size_t> nCompletedTimesteps{0};
+  // pixel simulator steps taken by simulators replaced after events
+  std::size_t nPreviousAcceptedSteps{0};
+  std::size_t nPreviousDiscardedSteps{0};
+  // events applied by restarting the existing simulator
+  std::size_t nSimulatorRestarts{0};
   std::queue<SimEvent> simEvents;
+  // scaled norm of dc/dt at the last time point, if it was evaluated
+  double dcdtNorm{std::numeric_limits<double>::max()};
+  bool steadyStateReached{false};
+  // steady state found by SteadyStateOptions::newtonKrylov, in the same
+  // format as a time point of the simulation data: empty if there is none
+  std::vector<std::vector<double>> steadyStateConcentration;
   void initModel();
   void initEvents();
   void applyNextEvent();
   void updateConcentrations(double t);
+  double getDifferenceQuotientNorm() const;
+  bool checkSteadyState();
 
 public:
   explicit Simulation(model::Model &model);
@@ -101,6 +114,31 @@ public:
             std::map<std::string, std::vector<std::vector<double>>>>
   getPyConcs(std::size_t timeIndex) const;
   std::size_t getNCompletedTimesteps() const;
+  // number of accepted & discarded pixel simulator steps
+  std::size_t getAcceptedSteps() const;
+  std::size_t getDiscardedSteps() const;
+  // number of events applied by restarting the existing simulator instead of
+  // replacing it, see PixelOptions::runtimeParameters
+  std::size_t getSimulatorRestarts() const;
+  // largest max|dc/dt| / max|c| of any species at the last time point, or of
+  // the Newton-Krylov steady state if there is one, only evaluated if
+  // SteadyStateOptions::tolerance is set
+  double getDcdtNorm() const;
+  // true if the last simulation stopped because a steady state was reached
+  bool getIsSteadyState() const;
+  // true if this steady state was found by SteadyStateOptions::newtonKrylov:
+  // it is not part of the simulation data, where the last time point holds
+  // the concentrations at the time the Newton-Krylov iterations started
+  bool getHasSteadyStateConcs() const;
+  // Newton-Krylov steady state, in the same format as getConcArray
+  std::vector<double> getSteadyStateConcArray(std::size_t compartmentIndex,
+                                              std::size_t speciesIndex) const;
+  // set the initial concentrations of m to the Newton-Krylov steady state
+  void applySteadyStateConcsToModel(model::Model &m) const;
+  // map from name to vec<vec<double>> Newton-Krylov steady state species
+  // conc for python bindings, empty if there is no steady state
+  std::map<std::string, std::vector<std::vector<double>>>
+  getPySteadyStateConcs() const;
   const SimulationData &getSimulationData() const;
   bool getIsRunning() const;
   bool getIsStopping() const;
@@ -45,7 +45,15 @@ struct DuneOptions {
   }
 };
 
-enum class PixelIntegratorType { RK101, RK212, RK323, RK435 };
+enum class PixelIntegratorType {
+  RK101,
+  RK212,
+  RK323,
+  RK435,
+  IMEX,
+  RKL2,
+  BDF
+};
 
 struct PixelIntegratorError {
   double abs{std::numeric_limits<double>::max()};
@@ -67,6 +75,42 @@ struct PixelOptions {
   std::size_t maxThreads{0};
   bool doCSE{true};
   unsigned optLevel{3};
+  // store concentrations as one contiguous array per species
+  bool speciesMajorLayout{false};
+  // renumber pixels along a Morton curve to improve memory locality
+  bool mortonOrdering{false};
+  // explicit RK integrators only: each compartment takes its own stable
+  // (RK101) or error controlled (RK212, RK323, RK435) timesteps, with
+  // membrane fluxes held constant over the longest of these timesteps
+  bool multirate{false};
+  // store concentrations in single precision: halves memory use at the cost
+  // of accuracy, reductions are still done in double precision
+  bool singlePrecision{false};
+  // skip tiles of pixels where all |dc/dt| are below this value until a
+  // neighbouring pixel changes: 0 disables this
+  double activityTolerance{0};
+  // adaptive integrators: PI step size controller, using the error of the
+  // previous step as well as the current one (Gustafsson)
+  bool piController{false};
+  // adaptive integrators: accept a step if the RMS of the errors, each
+  // weighted by maxErr.abs + maxErr.rel * |c|, is below 1, instead of
+  // requiring every pixel to satisfy maxErr
+  bool rmsErrorNorm{false};
+  // adaptive integrators: steps are not shortened to end at output times,
+  // instead the output is interpolated from the step that includes it.
+  // Ignored if SteadyStateOptions::tolerance is set
+  bool denseOutput{false};
+  // start integrating straight away with interpreted reaction terms, and
+  // switch to the compiled reaction terms once they are ready
+  bool tieredCompilation{false};
+  // parameters changed by events are inputs to the compiled reaction terms
+  // instead of constants, so events don't require recompiling them
+  bool runtimeParameters{false};
+  // at each output time, integrate a compartment that can remain uniform as
+  // a single pixel once every concentration is within this fraction of the
+  // largest concentration of its species from their spatial average: 0 only
+  // does this for exactly uniform concentrations
+  double uniformTolerance{0};
 
   template <class Archive>
   void serialize(Archive &ar, std::uint32_t const version) {
@@ -74,6 +118,36 @@ struct PixelOptions {
       ar(CEREAL_NVP(integrator), CEREAL_NVP(maxErr), CEREAL_NVP(maxTimestep),
          CEREAL_NVP(enableMultiThreading), CEREAL_NVP(maxThreads),
          CEREAL_NVP(doCSE), CEREAL_NVP(optLevel));
+    } else if (version == 1) {
+      ar(CEREAL_NVP(integrator), CEREAL_NVP(maxErr), CEREAL_NVP(maxTimestep),
+         CEREAL_NVP(enableMultiThreading), CEREAL_NVP(maxThreads),
+         CEREAL_NVP(doCSE), CEREAL_NVP(optLevel),
+         CEREAL_NVP(speciesMajorLayout), CEREAL_NVP(mortonOrdering),
+         CEREAL_NVP(multirate), CEREAL_NVP(singlePrecision),
+         CEREAL_NVP(activityTolerance), CEREAL_NVP(piController),
+         CEREAL_NVP(rmsErrorNorm), CEREAL_NVP(denseOutput),
+         CEREAL_NVP(tieredCompilation), CEREAL_NVP(runtimeParameters),
+         CEREAL_NVP(uniformTolerance));
+    }
+  }
+};
+
+struct SteadyStateOptions {
+  // stop the simulation once the scaled norm of dc/dt, i.e. the largest
+  // max|dc/dt| / max|c| of any species, is below this value: 0 disables this
+  double tolerance{0};
+  // pixel simulator: at each output time, try to solve dc/dt = 0 directly
+  // with pseudo-transient Newton-Krylov iterations from the current state:
+  // if this succeeds the simulation stops, and the steady state is stored
+  // separately from the output at that time, see Simulation
+  bool newtonKrylov{false};
+  std::size_t maxNewtonIterations{20};
+
+  template <class Archive>
+  void serialize(Archive &ar, std::uint32_t const version) {
+    if (version == 0) {
+      ar(CEREAL_NVP(tolerance), CEREAL_NVP(newtonKrylov),
+         CEREAL_NVP(maxNewtonIterations));
     }
   }
 };
@@ -81,11 +155,14 @@ struct PixelOptions {
 struct Options {
   DuneOptions dune;
   PixelOptions pixel;
+  SteadyStateOptions steadyState;
 
   template <class Archive>
   void serialize(Archive &ar, std::uint32_t const version) {
     if (version == 0) {
       ar(CEREAL_NVP(dune), CEREAL_NVP(pixel));
+    } else if (version == 1) {
+      ar(CEREAL_NVP(dune), CEREAL_NVP(pixel), CEREAL_NVP(steadyState));
     }
   }
 };
@@ -107,8 +184,9 @@ bool operator==(const AvgMinMax &lhs, const AvgMinMax &rhs);
 
 } // namespace sme::simulate
 
-CEREAL_CLASS_VERSION(sme::simulate::Options, 0);
+CEREAL_CLASS_VERSION(sme::simulate::Options, 1);
 CEREAL_CLASS_VERSION(sme::simulate::DuneOptions, 0);
 CEREAL_CLASS_VERSION(sme::simulate::PixelIntegratorError, 0);
-CEREAL_CLASS_VERSION(sme::simulate::PixelOptions, 0);
+CEREAL_CLASS_VERSION(sme::simulate::PixelOptions, 1);
+CEREAL_CLASS_VERSION(sme::simulate::SteadyStateOptions, 0);
 CEREAL_CLASS_VERSION(sme::simulate::AvgMinMax, 0);
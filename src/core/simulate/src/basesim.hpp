@@ -3,6 +3,7 @@
 #pragma once
 
 #include <QImage>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -12,12 +13,20 @@ class BaseSim {
 public:
   virtual ~BaseSim() = default;
   virtual std::size_t run(double time, double timeout_ms = -1.0) = 0;
-  virtual const std::vector<double> &
+  // concentrations with ordering: ix, species, followed by any padding
+  virtual std::vector<double>
   getConcentrations(std::size_t compartmentIndex) const = 0;
   virtual std::size_t getConcentrationPadding() const = 0;
   virtual const std::string &errorMessage() const = 0;
   virtual const QImage &errorImage() const = 0;
   virtual void setStopRequested(bool stop) = 0;
+  // continue from the last time point of the simulation data with the given
+  // parameter substitutions, without re-creating the simulator: returns false
+  // if this is not supported, in which case the simulator is unchanged
+  virtual bool restart(
+      const std::map<std::string, double, std::less<>> & /*substitutions*/) {
+    return false;
+  }
 };
 
 } // namespace sme::simulate
@@ -254,7 +254,7 @@ std::size_t DuneSim::run(double time, double timeout_ms) {
   return 1;
 }
 
-const std::vector<double> &
+std::vector<double>
 DuneSim::getConcentrations(std::size_t compartmentIndex) const {
   return duneCompartments[compartmentIndex].concentration;
 }
@@ -72,7 +72,7 @@ public:
       const std::map<std::string, double, std::less<>> &substitutions = {});
   ~DuneSim() override;
   std::size_t run(double time, double timeout_ms) override;
-  [[nodiscard]] const std::vector<double> &
+  [[nodiscard]] std::vector<double>
   getConcentrations(std::size_t compartmentIndex) const override;
   [[nodiscard]] std::size_t getConcentrationPadding() const override;
   [[nodiscard]] const std::string &errorMessage() const override;
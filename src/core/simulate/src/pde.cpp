@@ -23,7 +23,8 @@ Pde::Pde(const model::Model *doc_ptr,
          const PdeScaleFactors &pdeScaleFactors,
          const std::vector<std::string> &extraVariables,
          const std::vector<std::string> &relabelledExtraVariables,
-         const std::map<std::string, double, std::less<>> &substitutions) {
+         const std::map<std::string, double, std::less<>> &substitutions,
+         const std::vector<std::string> &runtimeParameters) {
   bool relabel{!relabelledSpeciesIDs.empty() ||
                !relabelledExtraVariables.empty()};
   if (relabel && relabelledSpeciesIDs.size() != speciesIDs.size()) {
@@ -43,73 +44,115 @@ Pde::Pde(const model::Model *doc_ptr,
   // construct reaction expressions and stoich matrix
   Reaction reactions(doc_ptr, speciesIDs, reactionIDs);
 
-  // construct symbolic expressions: one rhs + Jacobian for each species
-  rhs.clear();
-  jacobian.clear();
-  for (std::size_t i = 0; i < speciesIDs.size(); ++i) {
-    jacobian.emplace_back();
-    QString r("0.0");
-    auto vars{reactions.getSpeciesIDs()};
-    vars.insert(vars.end(), extraVariables.cbegin(), extraVariables.cend());
-    for (std::size_t j = 0; j < reactions.size(); ++j) {
-      // get reaction term
-      QString expr =
-          QString("%1*(%2) ")
-              .arg(utils::dblToQStr(reactions.getMatrixElement(j, i)),
-                   reactions.getExpression(j).c_str());
-      // rescale by supplied reactionScaleFactor
-      auto str = fmt::format("{}", pdeScaleFactors.reaction);
-      expr = QString("((%1)*(%2)) ").arg(expr, str.c_str());
-      SPDLOG_DEBUG("Species {} Reaction {} = {}", speciesIDs.at(i), j,
-                   expr.toStdString());
-      auto constants{reactions.getConstants(j)};
-      if (!substitutions.empty()) {
-        // substitute values of any constants in substitutions map
-        for (auto &[id, v] : constants) {
-          if (auto iter = substitutions.find(id); iter != substitutions.end()) {
-            SPDLOG_INFO("Substituting: {} = {} -> {}", id, v, iter->second);
-            v = iter->second;
-          }
+  // parse each reaction term once, with its own constants
+  auto vars{reactions.getSpeciesIDs()};
+  vars.insert(vars.end(), extraVariables.cbegin(), extraVariables.cend());
+  // runtime parameters are variables after the extra variables
+  vars.insert(vars.end(), runtimeParameters.cbegin(), runtimeParameters.cend());
+  std::vector<utils::Symbolic> terms;
+  terms.reserve(reactions.size());
+  for (std::size_t j = 0; j < reactions.size(); ++j) {
+    SPDLOG_DEBUG("Reaction {} = {}", j, reactions.getExpression(j));
+    auto constants{reactions.getConstants(j)};
+    if (!substitutions.empty()) {
+      // substitute values of any constants in substitutions map
+      for (auto &[id, v] : constants) {
+        if (auto iter = substitutions.find(id); iter != substitutions.end()) {
+          SPDLOG_INFO("Substituting: {} = {} -> {}", id, v, iter->second);
+          v = iter->second;
         }
       }
-      // parse and inline constants & function calls
-      utils::Symbolic sym(expr.toStdString(), vars, constants,
-                          doc_ptr->getFunctions().getSymbolicFunctions(),
-                          false);
-      if (!sym.isValid()) {
-        throw PdeError(sym.getErrorMessage());
-      }
-      // add term to rhs
-      r.append(QString(" + (%1)").arg(sym.inlinedExpr().c_str()));
     }
-    // reparse full rhs to simplify
-    SPDLOG_DEBUG("Species {} Reparsing all reaction terms", speciesIDs.at(i));
-    // parse expression with symengine to simplify
-    utils::Symbolic sym(r.toStdString(), vars, {}, {}, false);
-    // rescale species (but not the extra variables)
-    SPDLOG_DEBUG("rescaling species");
-    sym.rescale(pdeScaleFactors.species, extraVariables);
-    auto outputSpecies = speciesIDs;
-    if (relabel) {
-      SPDLOG_DEBUG("re-labelling species");
-      outputSpecies = relabelledSpeciesIDs;
-      outputSpecies.insert(outputSpecies.end(),
-                           relabelledExtraVariables.cbegin(),
-                           relabelledExtraVariables.cend());
-      sym.relabel(outputSpecies);
+    if (!runtimeParameters.empty()) {
+      // runtime parameters are not inlined
+      constants.erase(
+          std::remove_if(constants.begin(), constants.end(),
+                         [&runtimeParameters](const auto &c) {
+                           return std::find(runtimeParameters.cbegin(),
+                                            runtimeParameters.cend(),
+                                            c.first) !=
+                                  runtimeParameters.cend();
+                         }),
+          constants.end());
     }
-    for (const auto &s : outputSpecies) {
-      jacobian.back().push_back(sym.diff(s));
+    // parse and inline constants & function calls
+    terms.emplace_back(reactions.getExpression(j), vars, constants,
+                       doc_ptr->getFunctions().getSymbolicFunctions(), false);
+    if (!terms.back().isValid()) {
+      throw PdeError(terms.back().getErrorMessage());
     }
-    rhs.push_back(sym.inlinedExpr());
   }
+  // rhs for each species: sum of reaction terms times stoich coefficients,
+  // rescaled by supplied reactionScaleFactor
+  std::vector<std::vector<double>> coefficients(
+      speciesIDs.size(), std::vector<double>(reactions.size(), 0.0));
+  for (std::size_t i = 0; i < speciesIDs.size(); ++i) {
+    for (std::size_t j = 0; j < reactions.size(); ++j) {
+      coefficients[i][j] =
+          reactions.getMatrixElement(j, i) * pdeScaleFactors.reaction;
+    }
+  }
+  rhsSymbolic = utils::Symbolic::linearCombination(terms, coefficients, vars);
+  // rescale species (but not the extra variables or runtime parameters)
+  SPDLOG_DEBUG("rescaling species");
+  auto notSpecies{extraVariables};
+  notSpecies.insert(notSpecies.end(), runtimeParameters.cbegin(),
+                    runtimeParameters.cend());
+  rhsSymbolic.rescale(pdeScaleFactors.species, notSpecies);
+  auto outputSpecies = speciesIDs;
+  if (relabel) {
+    SPDLOG_DEBUG("re-labelling species");
+    outputSpecies = relabelledSpeciesIDs;
+    outputSpecies.insert(outputSpecies.end(), relabelledExtraVariables.cbegin(),
+                         relabelledExtraVariables.cend());
+    // runtime parameters keep their names
+    auto outputVars{outputSpecies};
+    outputVars.insert(outputVars.end(), runtimeParameters.cbegin(),
+                      runtimeParameters.cend());
+    rhsSymbolic.relabel(outputVars);
+  }
+  jacobianSymbolic = rhsSymbolic.jacobian(outputSpecies);
+  nRHS = rhsSymbolic.size();
+  nJacobianColumns = outputSpecies.size();
+}
+
+const std::vector<std::string> &Pde::getRHS() const {
+  if (rhs.empty() && nRHS > 0) {
+    if (rhsTaken) {
+      throw PdeError("Pde RHS expressions have already been taken");
+    }
+    for (std::size_t i = 0; i < nRHS; ++i) {
+      rhs.push_back(rhsSymbolic.inlinedExpr(i));
+    }
+  }
+  return rhs;
 }
 
-const std::vector<std::string> &Pde::getRHS() const { return rhs; }
 const std::vector<std::vector<std::string>> &Pde::getJacobian() const {
+  if (jacobian.empty() && nRHS > 0) {
+    if (jacobianTaken) {
+      throw PdeError("Pde Jacobian expressions have already been taken");
+    }
+    for (std::size_t i = 0; i < nRHS; ++i) {
+      auto &row{jacobian.emplace_back()};
+      for (std::size_t j = 0; j < nJacobianColumns; ++j) {
+        row.push_back(jacobianSymbolic.inlinedExpr(i * nJacobianColumns + j));
+      }
+    }
+  }
   return jacobian;
 }
 
+utils::Symbolic Pde::takeSymbolicRHS() && {
+  rhsTaken = true;
+  return std::move(rhsSymbolic);
+}
+
+utils::Symbolic Pde::takeSymbolicJacobian() && {
+  jacobianTaken = true;
+  return std::move(jacobianSymbolic);
+}
+
 // return index of species if in the species vector, and reactive
 static std::optional<std::size_t>
 getSpeciesIndex(const model::Model *doc, const std::string &speciesID,
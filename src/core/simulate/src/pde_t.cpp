@@ -143,4 +143,38 @@ SCENARIO("PDE", "[core/simulate/pde][core/simulate][core][pde]") {
     REQUIRE(symEq(pde.getJacobian()[2][1], "2.7e6*dim"));
     REQUIRE(symEq(pde.getJacobian()[2][2], "0"));
   }
+  GIVEN("ABtoC model with runtime parameter") {
+    model::Model s;
+    QFile f(":/models/ABtoC.xml");
+    f.open(QIODevice::ReadOnly);
+    s.importSBMLString(f.readAll().toStdString());
+    simulate::PdeScaleFactors scaleFactors;
+    scaleFactors.species = 2.0;
+    // k1 is not inlined, or rescaled with the species
+    simulate::Pde pde(&s, {"A", "B", "C"}, {"r1"}, {}, scaleFactors, {}, {},
+                      {{"k1", 0.3}}, {"k1"});
+    REQUIRE(symEq(pde.getRHS()[0], "-4*A*B*k1"));
+    REQUIRE(symEq(pde.getRHS()[1], "-4*A*B*k1"));
+    REQUIRE(symEq(pde.getRHS()[2], "4*A*B*k1"));
+    REQUIRE(pde.getJacobian()[0].size() == 3);
+    REQUIRE(symEq(pde.getJacobian()[0][0], "-4*B*k1"));
+    REQUIRE(symEq(pde.getJacobian()[0][1], "-4*A*k1"));
+    REQUIRE(symEq(pde.getJacobian()[0][2], "0"));
+  }
+  GIVEN("symbolic expressions taken from a Pde") {
+    model::Model s;
+    QFile f(":/models/ABtoC.xml");
+    f.open(QIODevice::ReadOnly);
+    s.importSBMLString(f.readAll().toStdString());
+    simulate::Pde pde(&s, {"A", "B", "C"}, {"r1"});
+    const auto &jacobian{pde.getJacobian()};
+    auto rhs{std::move(pde).takeSymbolicRHS()};
+    REQUIRE(rhs.size() == 3);
+    // the string expressions are no longer available, unless already
+    // generated before the expressions were taken
+    // NOLINTNEXTLINE(bugprone-use-after-move)
+    REQUIRE_THROWS_AS(pde.getRHS(), simulate::PdeError);
+    REQUIRE(&pde.getJacobian() == &jacobian);
+    REQUIRE(jacobian.size() == 3);
+  }
 }
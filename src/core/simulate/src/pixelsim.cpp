@@ -9,11 +9,18 @@
 #include <QStringList>
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
+#include <functional>
+#include <future>
 #include <memory>
+#include <numeric>
+#include <thread>
+#include <tuple>
 #include <utility>
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+#include <tbb/flow_graph.h>
 #include <tbb/global_control.h>
 #include <tbb/task_scheduler_init.h>
 #endif
@@ -23,16 +30,129 @@
 
 namespace sme::simulate {
 
-void PixelSim::calculateDcdt() {
-  // calculate dcd/dt in all compartments
+template <typename Real> void PixelSim::setStageTime(double t) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  // time at which the reaction terms are evaluated in the next dcdt
   for (auto &sim : simCompartments) {
-    if (useTBB) {
+    sim->setTime(t);
+  }
+}
+
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-      sim->evaluateReactions_tbb();
-      sim->evaluateDiffusionOperator_tbb();
+// Flow graph of the tasks that evaluate dcdt, built once for the compartments
+// & membranes, then run with the tasks for each dcdt evaluation. For each
+// compartment boundaryTask (its membrane pixels) and interiorTask (all other
+// pixels) run concurrently. Each membrane runs as soon as the boundaryTask of
+// its compartments is done, overlapping with the interior work, and
+// finaliseTask for each compartment runs once its interiorTask and all its
+// membranes are done. Membranes that share a compartment write to the same
+// dcdt, so are run in order.
+template <typename Real> class PixelTaskGraph {
+public:
+  using Task = std::function<void(SimCompartment<Real> &)>;
+
+private:
+  using Node = tbb::flow::continue_node<tbb::flow::continue_msg>;
+  // tasks of the current run
+  const Task *boundaryTask{nullptr};
+  const Task *interiorTask{nullptr};
+  const Task *finaliseTask{nullptr};
+  tbb::flow::graph g;
+  tbb::flow::broadcast_node<tbb::flow::continue_msg> start{g};
+  std::vector<std::unique_ptr<Node>> nodes;
+  template <typename Body> Node *addNode(Body body) {
+    nodes.push_back(std::make_unique<Node>(
+        g, [body](const tbb::flow::continue_msg &) { body(); }));
+    return nodes.back().get();
+  }
+
+public:
+  explicit PixelTaskGraph(const Sims<Real> &sims) {
+    const auto &simCompartments{sims.simCompartments};
+    std::vector<Node *> interiorNodes;
+    // last node that writes to the dcdt of the membrane pixels of each
+    // compartment
+    std::vector<Node *> lastWriter;
+    for (const auto &sim : simCompartments) {
+      auto *s{sim.get()};
+      lastWriter.push_back(addNode([this, s]() { (*boundaryTask)(*s); }));
+      tbb::flow::make_edge(start, *lastWriter.back());
+      interiorNodes.push_back(addNode([this, s]() { (*interiorTask)(*s); }));
+      tbb::flow::make_edge(start, *interiorNodes.back());
+    }
+    auto compartmentIndex{[&simCompartments](const SimCompartment<Real> *c) {
+      return static_cast<std::size_t>(std::distance(
+          simCompartments.cbegin(),
+          std::find_if(simCompartments.cbegin(), simCompartments.cend(),
+                       [c](const auto &p) { return p.get() == c; })));
+    }};
+    for (const auto &sim : sims.simMembranes) {
+      auto *membraneNode{
+          addNode([s = sim.get()]() { s->evaluateReactions_tbb(); })};
+      std::vector<std::size_t> indices;
+      for (const auto *c : {sim->getCompartmentA(), sim->getCompartmentB()}) {
+        if (c != nullptr) {
+          indices.push_back(compartmentIndex(c));
+        }
+      }
+      // edges from previous writers, avoiding duplicates
+      std::vector<Node *> predecessors;
+      for (auto i : indices) {
+        if (std::find(predecessors.cbegin(), predecessors.cend(),
+                      lastWriter[i]) == predecessors.cend()) {
+          predecessors.push_back(lastWriter[i]);
+        }
+      }
+      for (auto *p : predecessors) {
+        tbb::flow::make_edge(*p, *membraneNode);
+      }
+      for (auto i : indices) {
+        lastWriter[i] = membraneNode;
+      }
+    }
+    for (std::size_t i = 0; i < simCompartments.size(); ++i) {
+      auto *finaliseNode{addNode([this, s = simCompartments[i].get()]() {
+        (*finaliseTask)(*s);
+      })};
+      tbb::flow::make_edge(*interiorNodes[i], *finaliseNode);
+      tbb::flow::make_edge(*lastWriter[i], *finaliseNode);
+    }
+  }
+  PixelTaskGraph(const PixelTaskGraph &) = delete;
+  PixelTaskGraph &operator=(const PixelTaskGraph &) = delete;
+  PixelTaskGraph(PixelTaskGraph &&) = delete;
+  PixelTaskGraph &operator=(PixelTaskGraph &&) = delete;
+  ~PixelTaskGraph() = default;
+  void run(const Task &boundary, const Task &interior, const Task &finalise) {
+    boundaryTask = &boundary;
+    interiorTask = &interior;
+    finaliseTask = &finalise;
+    start.try_put(tbb::flow::continue_msg());
+    g.wait_for_all();
+  }
+};
 #endif
-    } else {
-      sim->evaluateReactions();
+
+template <typename Real> void PixelSim::calculateDcdt(bool includeDiffusion) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  auto &simMembranes{std::get<Sims<Real>>(sims).simMembranes};
+  if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+    std::get<Sims<Real>>(sims).taskGraph->run(
+        [includeDiffusion](SimCompartment<Real> &sim) {
+          sim.evaluateMembranePixels(includeDiffusion);
+        },
+        [includeDiffusion](SimCompartment<Real> &sim) {
+          sim.evaluateInteriorPixels_tbb(includeDiffusion);
+        },
+        [](SimCompartment<Real> &sim) { sim.spatiallyAverageDcdt_tbb(); });
+#endif
+    return;
+  }
+  // calculate dcd/dt in all compartments
+  for (auto &sim : simCompartments) {
+    sim->evaluateReactions();
+    if (includeDiffusion) {
       sim->evaluateDiffusionOperator();
     }
   }
@@ -45,9 +165,11 @@ void PixelSim::calculateDcdt() {
   }
 }
 
-void PixelSim::doRK101(double dt) {
+template <typename Real> void PixelSim::doRK101(double dt) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
   // RK1(0)1: Forwards Euler, no error estimate
-  calculateDcdt();
+  setStageTime<Real>(currentTime);
+  calculateDcdt<Real>();
   for (auto &sim : simCompartments) {
     if (useTBB) {
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
@@ -59,11 +181,87 @@ void PixelSim::doRK101(double dt) {
   }
 }
 
-void PixelSim::doRK212(double dt) {
+template <typename Real> double PixelSim::getMultirateTimestep() const {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  // largest finite stable timestep of any compartment: compartments with a
+  // smaller stable timestep take multiple substeps
+  double dt{0.0};
+  for (const auto &sim : simCompartments) {
+    if (double dtSim{sim->getMaxStableTimestep()};
+        dtSim < std::numeric_limits<double>::max()) {
+      dt = std::max(dt, dtSim);
+    }
+  }
+  return dt > 0.0 ? dt : std::numeric_limits<double>::max();
+}
+
+template <typename Real> void PixelSim::storeMembraneFluxes() {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  auto &simMembranes{std::get<Sims<Real>>(sims).simMembranes};
+  setStageTime<Real>(currentTime);
+  for (auto &sim : simCompartments) {
+    sim->clearDcdt();
+  }
+  for (auto &sim : simMembranes) {
+    if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+      sim->evaluateReactions_tbb();
+#endif
+    } else {
+      sim->evaluateReactions();
+    }
+  }
+  for (auto &sim : simCompartments) {
+    sim->storeMembraneFlux();
+  }
+}
+
+template <typename Real>
+void PixelSim::calculateCompartmentDcdt(SimCompartment<Real> &sim, double t) {
+  sim.setTime(t);
+  if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+    sim.evaluateReactions_tbb();
+    sim.evaluateDiffusionOperator_tbb();
+#endif
+  } else {
+    sim.evaluateReactions();
+    sim.evaluateDiffusionOperator();
+  }
+  sim.addMembraneFlux();
+  sim.spatiallyAverageDcdt();
+}
+
+template <typename Real> void PixelSim::doMultirateRK101(double dt) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  // membrane fluxes are evaluated at the start of the step and held constant
+  storeMembraneFluxes<Real>();
+  // each compartment then does forwards Euler steps with its own timestep
+  for (auto &sim : simCompartments) {
+    auto nSubsteps{static_cast<std::size_t>(
+        std::ceil(dt / std::min(dt, sim->getMaxStableTimestep())))};
+    double h{dt / static_cast<double>(nSubsteps)};
+    for (std::size_t i = 0; i < nSubsteps; ++i) {
+      calculateCompartmentDcdt<Real>(*sim,
+                                     currentTime + static_cast<double>(i) * h);
+      if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+        sim->doForwardsEulerTimestep_tbb(h);
+#endif
+      } else {
+        sim->doForwardsEulerTimestep(h);
+      }
+    }
+  }
+}
+
+template <typename Real> void PixelSim::doRK212(double dt) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
   // RK2(1)2: Heun / Modified Euler, with embedded forwards Euler error
   // estimate Shu-Osher form used here taken from eq(2.15) of
   // https://doi.org/10.1016/0021-9991(88)90177-5
-  calculateDcdt();
+  setStageTime<Real>(currentTime);
+  calculateDcdt<Real>();
   for (auto &sim : simCompartments) {
     if (useTBB) {
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
@@ -73,7 +271,8 @@ void PixelSim::doRK212(double dt) {
       sim->doRK212Substep1(dt);
     }
   }
-  calculateDcdt();
+  setStageTime<Real>(currentTime + dt);
+  calculateDcdt<Real>();
   for (auto &sim : simCompartments) {
     if (useTBB) {
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
@@ -85,69 +284,314 @@ void PixelSim::doRK212(double dt) {
   }
 }
 
-void PixelSim::doRK323(double dt) {
+// coefficients of the substeps of a low storage RK method, see
+// SimCompartment::doRKSubstep, and the factors used to combine the stored
+// stages into the embedded solution, see SimCompartment::doRKFinalise
+struct LowStorageRK {
+  std::vector<double> g1;
+  std::vector<double> g2;
+  std::vector<double> g3;
+  std::vector<double> beta;
+  std::vector<double> delta;
+  double cFactor;
+  double s2Factor;
+  double s3Factor;
+};
+
+static const LowStorageRK &getRK323() {
   // RK3(2)3: Shu Osher method with embedded Heun error estimate
   // Taken from eq(2.18) of
   // https://doi.org/10.1016/0021-9991(88)90177-5
-  constexpr std::array<double, 3> g1{1.0, 0.25, 0.666666666666666666666};
-  constexpr std::array<double, 3> g2{0.0, 0.0, 0.0};
-  constexpr std::array<double, 3> g3{0.0, 0.75, 0.333333333333333333333};
-  constexpr std::array<double, 3> beta{1.0, 0.25, 0.6666666666666666666};
-  constexpr std::array<double, 3> delta{0.0, 0.0, 1.0};
+  static const LowStorageRK rk{{1.0, 0.25, 0.666666666666666666666},
+                               {0.0, 0.0, 0.0},
+                               {0.0, 0.75, 0.333333333333333333333},
+                               {1.0, 0.25, 0.6666666666666666666},
+                               {0.0, 0.0, 1.0},
+                               0.0,
+                               2.0,
+                               -1.0};
+  return rk;
+}
+
+static const LowStorageRK &getRK435() {
+  // RK4(3)5: 3S* algorithm 6 (see also table 6)
+  // https://doi.org/10.1016/j.jcp.2009.11.006
+  // 5 stage RK4 with embedded RK3 error estimate
+  static const LowStorageRK rk{[]() {
+    constexpr std::array<double, 7> delta{1.0,
+                                          0.081252332929194,
+                                          -1.083849060586449,
+                                          -1.096110881845602,
+                                          2.859440022030827,
+                                          -0.655568367959557,
+                                          -0.194421504490852};
+    const double deltaSum{1.0 / utils::sum(delta)};
+    return LowStorageRK{{0.0, -0.497531095840104, 1.010070514199942,
+                         -3.196559004608766, 1.717835630267259},
+                        {1.0, 1.384996869124138, 3.878155713328178,
+                         -2.324512951813145, -0.514633322274467},
+                        {0.0, 0.0, 0.0, 1.642598936063715, 0.188295940828347},
+                        {0.075152045700771, 0.211361016946069,
+                         1.100713347634329, 0.728537814675568,
+                         0.393172889823198},
+                        {delta.cbegin(), delta.cbegin() + 5},
+                        deltaSum * delta[5],
+                        deltaSum,
+                        deltaSum * delta[6]};
+  }()};
+  return rk;
+}
+
+template <typename Real> void PixelSim::doLowStorageRK(double dt) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  const auto &rk{integrator == PixelIntegratorType::RK323 ? getRK323()
+                                                          : getRK435()};
   for (auto &sim : simCompartments) {
     sim->doRKInit();
   }
-  for (std::size_t i = 0; i < 3; ++i) {
-    doRKSubstep(dt, g1[i], g2[i], g3[i], beta[i], delta[i]);
+  // stage times: apply the same RK substeps to dt/dt = 1
+  double t{currentTime};
+  double tS2{0.0};
+  for (std::size_t i = 0; i < rk.g1.size(); ++i) {
+    setStageTime<Real>(t);
+    doRKSubstep<Real>(dt, rk.g1[i], rk.g2[i], rk.g3[i], rk.beta[i],
+                      rk.delta[i]);
+    tS2 += rk.delta[i] * t;
+    t = rk.g1[i] * t + rk.g2[i] * tS2 + rk.g3[i] * currentTime +
+        rk.beta[i] * dt;
   }
+  doRKFinalise<Real>(rk.cFactor, rk.s2Factor, rk.s3Factor);
+}
+
+template <typename Real> void PixelSim::doIMEX(double dt) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  // IMEX Euler: diffusion is treated implicitly (solved using conjugate
+  // gradient), reactions explicitly, so dt is not limited by diffusion
+  // stability. Error estimate from step doubling: one step of dt is the
+  // lower order solution, two steps of dt/2 the solution
   for (auto &sim : simCompartments) {
-    sim->doRKFinalise(0.0, 2.0, -1.0);
+    sim->doRKInit();
+  }
+  setStageTime<Real>(currentTime);
+  calculateDcdt<Real>(false);
+  for (auto &sim : simCompartments) {
+    if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+      sim->doIMEXSubstep1_tbb(dt);
+#endif
+    } else {
+      sim->doIMEXSubstep1(dt);
+    }
+  }
+  setStageTime<Real>(currentTime + 0.5 * dt);
+  calculateDcdt<Real>(false);
+  for (auto &sim : simCompartments) {
+    if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+      sim->doIMEXSubstep2_tbb(dt);
+#endif
+    } else {
+      sim->doIMEXSubstep2(dt);
+    }
   }
 }
 
-void PixelSim::doRK435(double dt) {
-  // RK4(3)5: 3S* algorithm 6 (see also table 6)
-  // https://doi.org/10.1016/j.jcp.2009.11.006
-  // 5 stage RK4 with embedded RK3 error estimate
-  constexpr std::array<double, 5> g1{0.0, -0.497531095840104, 1.010070514199942,
-                                     -3.196559004608766, 1.717835630267259};
-  constexpr std::array<double, 5> g2{1.0, 1.384996869124138, 3.878155713328178,
-                                     -2.324512951813145, -0.514633322274467};
-  constexpr std::array<double, 5> g3{0.0, 0.0, 0.0, 1.642598936063715,
-                                     0.188295940828347};
-  constexpr std::array<double, 5> beta{0.075152045700771, 0.211361016946069,
-                                       1.100713347634329, 0.728537814675568,
-                                       0.393172889823198};
-  constexpr std::array<double, 7> delta{1.0,
-                                        0.081252332929194,
-                                        -1.083849060586449,
-                                        -1.096110881845602,
-                                        2.859440022030827,
-                                        -0.655568367959557,
-                                        -0.194421504490852};
-  double deltaSum = 1.0 / utils::sum(delta);
+// maximum number of stages for the RKL2 integrator
+constexpr std::size_t maxRKL2Stages{256};
+
+static std::size_t getRKL2Stages(double dt, double maxStableTimestep) {
+  // stable if dt <= maxStableTimestep * (s^2 + s - 2) / 4
+  double s{std::ceil(
+      0.5 * (std::sqrt(9.0 + 16.0 * dt / maxStableTimestep) - 1.0))};
+  return std::clamp(static_cast<std::size_t>(s), std::size_t{2},
+                    maxRKL2Stages);
+}
+
+double PixelSim::getRKL2MaxTimestep() const {
+  constexpr auto s{static_cast<double>(maxRKL2Stages)};
+  return 0.25 * maxStableTimestep * (s * s + s - 2.0);
+}
+
+template <typename Real> void PixelSim::doRKL2(double dt) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  // RKL2: s-stage Runge-Kutta-Legendre super-time-stepping method,
+  // 2nd order, stable for dt up to O(s^2) times the forwards Euler limit
+  // see https://doi.org/10.1016/j.jcp.2013.08.021
+  const std::size_t s{getRKL2Stages(dt, maxStableTimestep)};
+  auto b{[](std::size_t j) {
+    if (j <= 2) {
+      return 1.0 / 3.0;
+    }
+    auto x{static_cast<double>(j)};
+    return (x * x + x - 2.0) / (2.0 * x * (x + 1.0));
+  }};
+  const double sd{static_cast<double>(s)};
+  const double w1{4.0 / (sd * sd + sd - 2.0)};
   for (auto &sim : simCompartments) {
     sim->doRKInit();
   }
-  for (std::size_t i = 0; i < 5; ++i) {
-    doRKSubstep(dt, g1[i], g2[i], g3[i], beta[i], delta[i]);
+  // stage times: apply the same stages to dt/dt = 1
+  double t{currentTime};
+  double tPrev{currentTime};
+  setStageTime<Real>(t);
+  calculateDcdt<Real>();
+  double muTilde{b(1) * w1};
+  for (auto &sim : simCompartments) {
+    sim->doRKLStage1(dt, muTilde);
   }
+  t += muTilde * dt;
+  for (std::size_t j = 2; j <= s; ++j) {
+    auto jd{static_cast<double>(j)};
+    double mu{(2.0 * jd - 1.0) / jd * b(j) / b(j - 1)};
+    double nu{-(jd - 1.0) / jd * b(j) / b(j - 2)};
+    muTilde = mu * w1;
+    double gammaTilde{-(1.0 - b(j - 1)) * muTilde};
+    setStageTime<Real>(t);
+    calculateDcdt<Real>();
+    for (auto &sim : simCompartments) {
+      if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+        sim->doRKLStage_tbb(dt, mu, nu, muTilde, gammaTilde);
+#endif
+      } else {
+        sim->doRKLStage(dt, mu, nu, muTilde, gammaTilde);
+      }
+    }
+    double tNext{mu * t + nu * tPrev + (1.0 - mu - nu) * currentTime +
+                 (muTilde + gammaTilde) * dt};
+    tPrev = t;
+    t = tNext;
+  }
+  // dcdt at end of step for the error estimate
+  setStageTime<Real>(t);
+  calculateDcdt<Real>();
   for (auto &sim : simCompartments) {
-    sim->doRKFinalise(deltaSum * delta[5], deltaSum, deltaSum * delta[6]);
+    sim->doRKLFinalise(dt);
   }
 }
 
+template <typename Real>
 void PixelSim::doRKSubstep(double dt, double g1, double g2, double g3,
                            double beta, double delta) {
-  calculateDcdt();
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  auto &simMembranes{std::get<Sims<Real>>(sims).simMembranes};
+  // where possible, evaluate dcdt and apply the RK update in a single pass
+  // over each compartment, deferring only the membrane pixels
+  if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+    std::get<Sims<Real>>(sims).taskGraph->run(
+        [](SimCompartment<Real> &sim) { sim.evaluateMembranePixels(true); },
+        [=](SimCompartment<Real> &sim) {
+          if (sim.canFuseRKSubstep()) {
+            sim.doFusedRKSubstep_tbb(dt, g1, g2, g3, beta, delta, true);
+          } else {
+            sim.evaluateInteriorPixels_tbb(true);
+          }
+        },
+        [=](SimCompartment<Real> &sim) {
+          if (sim.canFuseRKSubstep()) {
+            sim.finaliseFusedRKSubstep(dt, g1, g2, g3, beta, delta);
+          } else {
+            sim.spatiallyAverageDcdt_tbb();
+            sim.doRKSubstep_tbb(dt, g1, g2, g3, beta, delta);
+          }
+        });
+#endif
+    return;
+  }
   for (auto &sim : simCompartments) {
+    if (sim->canFuseRKSubstep()) {
+      sim->doFusedRKSubstep(dt, g1, g2, g3, beta, delta);
+    } else {
+      sim->evaluateReactions();
+      sim->evaluateDiffusionOperator();
+    }
+  }
+  // membrane contribution to dc/dt
+  for (auto &sim : simMembranes) {
+    sim->evaluateReactions();
+  }
+  for (auto &sim : simCompartments) {
+    if (sim->canFuseRKSubstep()) {
+      sim->finaliseFusedRKSubstep(dt, g1, g2, g3, beta, delta);
+    } else {
+      sim->spatiallyAverageDcdt();
+      sim->doRKSubstep(dt, g1, g2, g3, beta, delta);
+    }
+  }
+}
+
+template <typename Real>
+void PixelSim::doRKFinalise(double cFactor, double s2Factor,
+                            double s3Factor) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  PixelStepError err;
+  for (auto &sim : simCompartments) {
+    PixelStepError compErr;
     if (useTBB) {
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-      sim->doRKSubstep_tbb(dt, g1, g2, g3, beta, delta);
+      compErr = sim->doRKFinalise_tbb(cFactor, s2Factor, s3Factor, epsilon);
 #endif
     } else {
-      sim->doRKSubstep(dt, g1, g2, g3, beta, delta);
+      compErr = sim->doRKFinalise(cFactor, s2Factor, s3Factor, epsilon);
+    }
+    err.max.rel = std::max(err.max.rel, compErr.max.rel);
+    err.max.abs = std::max(err.max.abs, compErr.max.abs);
+    err.sumSquares += compErr.sumSquares;
+    err.n += compErr.n;
+  }
+  stepError = err;
+}
+
+double PixelSim::getErrorNorm(const PixelStepError &err) const {
+  if (rmsErrorNorm) {
+    if (err.n == 0) {
+      return 0.0;
     }
+    return std::sqrt(err.sumSquares / static_cast<double>(err.n));
+  }
+  return std::max(err.max.abs / errMax.abs, err.max.rel / errMax.rel);
+}
+
+template <typename Real>
+void PixelSim::storeDenseOutput(double t0, double dt) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  // evaluate dcdt at the start of the step, then at the end
+  for (auto &sim : simCompartments) {
+    sim->beginDenseOutput();
+  }
+  setStageTime<Real>(t0);
+  calculateDcdt<Real>();
+  for (auto &sim : simCompartments) {
+    sim->storeDenseOutputStart();
+  }
+  setStageTime<Real>(t0 + dt);
+  calculateDcdt<Real>();
+  for (auto &sim : simCompartments) {
+    sim->storeDenseOutputEnd();
+  }
+  denseT0 = t0;
+  denseDt = dt;
+}
+
+template <typename Real> void PixelSim::setDenseOutput(double tolerance) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  bool interpolate{currentTime - outputTime > tolerance && denseDt > 0.0};
+  for (auto &sim : simCompartments) {
+    if (interpolate) {
+      sim->interpolateDenseOutput((outputTime - denseT0) / denseDt, denseDt);
+    } else {
+      sim->clearDenseOutput();
+    }
+  }
+}
+
+void PixelSim::clearDenseOutput() {
+  for (auto &sim : std::get<Sims<double>>(sims).simCompartments) {
+    sim->clearDenseOutput();
+  }
+  for (auto &sim : std::get<Sims<float>>(sims).simCompartments) {
+    sim->clearDenseOutput();
   }
 }
 
@@ -159,67 +603,1030 @@ static double getErrorPower(PixelIntegratorType integrator) {
     errPower = 1.0 / 3.0;
   } else if (integrator == PixelIntegratorType::RK435) {
     errPower = 1.0 / 4.0;
+  } else if (integrator == PixelIntegratorType::IMEX) {
+    errPower = 1.0 / 2.0;
+  } else if (integrator == PixelIntegratorType::RKL2) {
+    errPower = 1.0 / 2.0;
   }
   return errPower;
 }
 
-double PixelSim::doRKAdaptive(double dtMax) {
+double PixelSim::getStepSizeFactor(double errNorm, double previousErrNorm,
+                                   bool rejected) const {
+  const double errPower{getErrorPower(integrator)};
+  if (!piController) {
+    return std::pow(errNorm, -errPower);
+  }
+  // PI controller, see section IV.2 of Hairer & Wanner, with the
+  // exponents from https://doi.org/10.1145/641876.641877.
+  // After a rejected step the step size is only reduced, using the
+  // elementary controller.
+  constexpr double minErrNorm{1e-10};
+  double factor;
+  if (rejected) {
+    factor =
+        std::min(1.0, std::pow(std::max(errNorm, minErrNorm), -errPower));
+  } else {
+    factor = std::pow(std::max(errNorm, minErrNorm), -0.7 * errPower) *
+             std::pow(previousErrNorm, 0.4 * errPower);
+  }
+  return std::clamp(factor, 0.2, 5.0);
+}
+
+template <typename Real>
+void PixelSim::setAccuracyError(double maxRelErr,
+                                const SimCompartment<Real> *simCompartment) {
+  currentErrorImage = {};
+  std::string problemSpecies{"unknown"};
+  for (const auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    if (simCompartment != nullptr && sim.get() != simCompartment) {
+      continue;
+    }
+    auto speciesName{sim->plotRKError(currentErrorImage, epsilon, maxRelErr)};
+    if (!speciesName.empty()) {
+      problemSpecies = speciesName;
+    }
+  }
+  currentErrorMessage = fmt::format(
+      "Failed to solve model to required accuracy. The largest "
+      "relative integration error comes from species '{}'. The location "
+      "of the pixels with the largest relative integration error are shown "
+      "below in red:",
+      problemSpecies);
+}
+
+template <typename Real> double PixelSim::doRKAdaptive(double dtMax) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
   // Adaptive timestep Runge-Kutta
-  PixelIntegratorError err;
+  PixelStepError err;
+  double errNorm;
   double dt;
-  double errPower = getErrorPower(integrator);
+  bool rejected{false};
   do {
     // do timestep
     dt = std::min(nextTimestep, dtMax);
+    stepError.reset();
     if (integrator == PixelIntegratorType::RK212) {
-      doRK212(dt);
-    } else if (integrator == PixelIntegratorType::RK323) {
-      doRK323(dt);
-    } else if (integrator == PixelIntegratorType::RK435) {
-      doRK435(dt);
-    }
-    // calculate error
-    err.abs = 0;
-    err.rel = 0;
-    for (const auto &sim : simCompartments) {
-      auto compErr = sim->calculateRKError(epsilon);
-      err.rel = std::max(err.rel, compErr.rel);
-      err.abs = std::max(err.abs, compErr.abs);
+      doRK212<Real>(dt);
+    } else if (integrator == PixelIntegratorType::RK323 ||
+               integrator == PixelIntegratorType::RK435) {
+      doLowStorageRK<Real>(dt);
+    } else if (integrator == PixelIntegratorType::IMEX) {
+      doIMEX<Real>(dt);
+    } else if (integrator == PixelIntegratorType::RKL2) {
+      doRKL2<Real>(dt);
     }
-    // calculate new timestep
-    double errFactor = std::min(errMax.abs / err.abs, errMax.rel / err.rel);
-    errFactor = std::pow(errFactor, errPower);
-    nextTimestep = std::min(0.95 * dt * errFactor, dtMax);
-    SPDLOG_TRACE("dt = {} gave rel err = {}, abs err = {} -> new dt = {}", dt,
-                 err.rel, err.abs, nextTimestep);
-    if (nextTimestep / dtMax < 1e-20) {
-      currentErrorImage = {};
-      std::string problemSpecies{"unknown"};
+    // calculate error, unless already done while finalising the step
+    if (stepError.has_value()) {
+      err = stepError.value();
+    } else {
+      err = {};
       for (const auto &sim : simCompartments) {
-        auto speciesName{sim->plotRKError(currentErrorImage, epsilon, err.rel)};
-        if (!speciesName.empty()) {
-          problemSpecies = speciesName;
+        PixelStepError compErr;
+        if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+          compErr = sim->calculateRKError_tbb(epsilon);
+#endif
+        } else {
+          compErr = sim->calculateRKError(epsilon);
         }
+        err.max.rel = std::max(err.max.rel, compErr.max.rel);
+        err.max.abs = std::max(err.max.abs, compErr.max.abs);
+        err.sumSquares += compErr.sumSquares;
+        err.n += compErr.n;
       }
-      currentErrorMessage = fmt::format(
-          "Failed to solve model to required accuracy. The largest "
-          "relative integration error comes from species '{}'. The location "
-          "of the pixels with the largest relative integration error are shown "
-          "below in red:",
-          problemSpecies);
+    }
+    // calculate new timestep
+    errNorm = getErrorNorm(err);
+    nextTimestep = std::min(
+        0.95 * dt * getStepSizeFactor(errNorm, previousErrorNorm, rejected),
+        dtMax);
+    SPDLOG_TRACE("dt = {} gave rel err = {}, abs err = {}, norm = {} -> new "
+                 "dt = {}",
+                 dt, err.max.rel, err.max.abs, errNorm, nextTimestep);
+    if (nextTimestep / std::min(dtMax, outputInterval) < 1e-20) {
+      setAccuracyError<Real>(err.max.rel);
       return nextTimestep;
     }
-    if (err.abs > errMax.abs || err.rel > errMax.rel) {
+    if (errNorm > 1.0) {
       SPDLOG_TRACE("discarding step");
       ++discardedSteps;
+      ++nDiscardedSteps;
+      rejected = true;
       for (auto &sim : simCompartments) {
         sim->undoRKStep();
       }
     }
-  } while (err.abs > errMax.abs || err.rel > errMax.rel);
+  } while (errNorm > 1.0);
+  // avoid a zero error norm, as in Hairer & Wanner
+  previousErrorNorm = std::max(errNorm, 1e-4);
+  return dt;
+}
+
+template <typename Real>
+PixelStepError PixelSim::doCompartmentRKStep(SimCompartment<Real> &sim,
+                                             double t0, double dt) {
+  // as doRK212 & doLowStorageRK, but for a single compartment, with the
+  // stored membrane flux in place of the membrane reactions
+  if (integrator == PixelIntegratorType::RK212) {
+    calculateCompartmentDcdt<Real>(sim, t0);
+    if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+      sim.doRK212Substep1_tbb(dt);
+#endif
+    } else {
+      sim.doRK212Substep1(dt);
+    }
+    calculateCompartmentDcdt<Real>(sim, t0 + dt);
+    if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+      sim.doRK212Substep2_tbb(dt);
+      return sim.calculateRKError_tbb(epsilon);
+#endif
+    }
+    sim.doRK212Substep2(dt);
+    return sim.calculateRKError(epsilon);
+  }
+  const auto &rk{integrator == PixelIntegratorType::RK323 ? getRK323()
+                                                          : getRK435()};
+  sim.doRKInit();
+  double t{t0};
+  double tS2{0.0};
+  for (std::size_t i = 0; i < rk.g1.size(); ++i) {
+    calculateCompartmentDcdt<Real>(sim, t);
+    if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+      sim.doRKSubstep_tbb(dt, rk.g1[i], rk.g2[i], rk.g3[i], rk.beta[i],
+                          rk.delta[i]);
+#endif
+    } else {
+      sim.doRKSubstep(dt, rk.g1[i], rk.g2[i], rk.g3[i], rk.beta[i],
+                      rk.delta[i]);
+    }
+    tS2 += rk.delta[i] * t;
+    t = rk.g1[i] * t + rk.g2[i] * tS2 + rk.g3[i] * t0 + rk.beta[i] * dt;
+  }
+  if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+    return sim.doRKFinalise_tbb(rk.cFactor, rk.s2Factor, rk.s3Factor,
+                                epsilon);
+#endif
+  }
+  return sim.doRKFinalise(rk.cFactor, rk.s2Factor, rk.s3Factor, epsilon);
+}
+
+template <typename Real>
+double PixelSim::doMultirateRKAdaptive(double dtMax) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  if (compartmentNextTimestep.size() != simCompartments.size()) {
+    compartmentNextTimestep.assign(simCompartments.size(), nextTimestep);
+    compartmentErrorNorm.assign(simCompartments.size(), 1.0);
+  }
+  // the compartment with the longest timestep sets the length of the step,
+  // over which the membrane fluxes are held constant
+  const double dt{std::min(dtMax,
+                           *std::max_element(compartmentNextTimestep.cbegin(),
+                                             compartmentNextTimestep.cend()))};
+  storeMembraneFluxes<Real>();
+  // each compartment then does adaptive steps with its own error control
+  for (std::size_t ic = 0; ic < simCompartments.size(); ++ic) {
+    auto &sim{*simCompartments[ic]};
+    double t{currentTime};
+    double remaining{dt};
+    bool rejected{false};
+    while (remaining > 0.0) {
+      const double h{std::min(compartmentNextTimestep[ic], remaining)};
+      auto err{doCompartmentRKStep<Real>(sim, t, h)};
+      double errNorm{getErrorNorm(err)};
+      compartmentNextTimestep[ic] = std::min(
+          0.95 * h *
+              getStepSizeFactor(errNorm, compartmentErrorNorm[ic], rejected),
+          dtMax);
+      SPDLOG_TRACE("compartment {}: dt = {} gave norm = {} -> new dt = {}",
+                   ic, h, errNorm, compartmentNextTimestep[ic]);
+      if (compartmentNextTimestep[ic] / std::min(dtMax, outputInterval) <
+          1e-20) {
+        setAccuracyError<Real>(err.max.rel, &sim);
+        return dt;
+      }
+      if (errNorm > 1.0) {
+        SPDLOG_TRACE("discarding step");
+        ++discardedSteps;
+        ++nDiscardedSteps;
+        rejected = true;
+        sim.undoRKStep();
+        continue;
+      }
+      rejected = false;
+      compartmentErrorNorm[ic] = std::max(errNorm, 1e-4);
+      t += h;
+      remaining = h < remaining ? remaining - h : 0.0;
+    }
+  }
+  nextTimestep = dt;
   return dt;
 }
 
+template <typename Real> double PixelSim::getDcdtNorm() {
+  setStageTime<Real>(currentTime);
+  calculateDcdt<Real>();
+  double norm{0};
+  for (const auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    norm = std::max(norm, sim->getDcdtNorm());
+  }
+  return norm;
+}
+
+template <typename Real> void PixelSim::updateTieredCompilation() {
+  bool compiled{true};
+  for (auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    compiled = sim->updateTieredCompilation() && compiled;
+  }
+  for (auto &sim : std::get<Sims<Real>>(sims).simMembranes) {
+    compiled = sim->updateTieredCompilation() && compiled;
+  }
+  if (compiled) {
+    SPDLOG_INFO("t={}: switched to compiled reaction terms", currentTime);
+    tieredCompilationPending = false;
+  }
+}
+
+static double norm2(const std::vector<double> &v) {
+  return std::sqrt(std::inner_product(v.cbegin(), v.cend(), v.cbegin(), 0.0));
+}
+
+// restarted GMRES with right preconditioning for A x = b, starting from
+// x = 0: applyA(v, Av), applyM(v) replaces v with M^{-1} v.
+// Stops when |b - A x| <= tol |b|, and returns false if this is not reached
+template <typename ApplyA, typename ApplyM>
+static bool solveGMRES(const ApplyA &applyA, const ApplyM &applyM,
+                       const std::vector<double> &b, std::vector<double> &x,
+                       double tol, std::size_t restart,
+                       std::size_t maxRestarts) {
+  const std::size_t n{b.size()};
+  x.assign(n, 0.0);
+  const double bNorm{norm2(b)};
+  if (bNorm == 0.0) {
+    return true;
+  }
+  // Krylov basis V, preconditioned basis Z, Hessenberg matrix H with
+  // H(i, j) = H[i * restart + j], reduced to upper triangular by the Givens
+  // rotations (cs, sn), and the rotated residual vector g
+  std::vector<std::vector<double>> V(restart + 1, std::vector<double>(n));
+  std::vector<std::vector<double>> Z(restart, std::vector<double>(n));
+  std::vector<double> H((restart + 1) * restart);
+  std::vector<double> cs(restart);
+  std::vector<double> sn(restart);
+  std::vector<double> g(restart + 1);
+  std::vector<double> y(restart);
+  for (std::size_t cycle = 0; cycle < maxRestarts; ++cycle) {
+    auto &r{V[0]};
+    applyA(x, r);
+    for (std::size_t i = 0; i < n; ++i) {
+      r[i] = b[i] - r[i];
+    }
+    const double beta{norm2(r)};
+    if (beta <= tol * bNorm) {
+      return true;
+    }
+    for (auto &ri : r) {
+      ri /= beta;
+    }
+    std::fill(g.begin(), g.end(), 0.0);
+    g[0] = beta;
+    std::size_t k{0};
+    while (k < restart) {
+      Z[k] = V[k];
+      applyM(Z[k]);
+      applyA(Z[k], V[k + 1]);
+      // modified Gram-Schmidt
+      for (std::size_t j = 0; j <= k; ++j) {
+        double h{std::inner_product(V[k + 1].cbegin(), V[k + 1].cend(),
+                                    V[j].cbegin(), 0.0)};
+        H[j * restart + k] = h;
+        for (std::size_t i = 0; i < n; ++i) {
+          V[k + 1][i] -= h * V[j][i];
+        }
+      }
+      double hNext{norm2(V[k + 1])};
+      if (hNext > 0.0) {
+        for (auto &vi : V[k + 1]) {
+          vi /= hNext;
+        }
+      }
+      for (std::size_t j = 0; j < k; ++j) {
+        double h0{H[j * restart + k]};
+        double h1{H[(j + 1) * restart + k]};
+        H[j * restart + k] = cs[j] * h0 + sn[j] * h1;
+        H[(j + 1) * restart + k] = -sn[j] * h0 + cs[j] * h1;
+      }
+      double hkk{H[k * restart + k]};
+      double denom{std::hypot(hkk, hNext)};
+      cs[k] = denom > 0.0 ? hkk / denom : 1.0;
+      sn[k] = denom > 0.0 ? hNext / denom : 0.0;
+      H[k * restart + k] = denom;
+      g[k + 1] = -sn[k] * g[k];
+      g[k] = cs[k] * g[k];
+      ++k;
+      if (std::abs(g[k]) <= tol * bNorm || hNext == 0.0) {
+        break;
+      }
+    }
+    // x += Z y, where H y = g
+    for (std::size_t i = k; i-- > 0;) {
+      double sum{g[i]};
+      for (std::size_t j = i + 1; j < k; ++j) {
+        sum -= H[i * restart + j] * y[j];
+      }
+      y[i] = H[i * restart + i] != 0.0 ? sum / H[i * restart + i] : 0.0;
+    }
+    for (std::size_t j = 0; j < k; ++j) {
+      for (std::size_t i = 0; i < n; ++i) {
+        x[i] += y[j] * Z[j][i];
+      }
+    }
+    if (std::abs(g[k]) <= tol * bNorm) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Real> void PixelSim::getState(std::vector<double> &u) const {
+  const auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  for (std::size_t i = 0; i < simCompartments.size(); ++i) {
+    const auto &c{simCompartments[i]->getStateConcentrations()};
+    std::copy(c.cbegin(), c.cend(), u.begin() + stateOffsets[i]);
+  }
+}
+
+template <typename Real> void PixelSim::setState(const std::vector<double> &u) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  for (std::size_t i = 0; i < simCompartments.size(); ++i) {
+    simCompartments[i]->setStateConcentrations(u.data() + stateOffsets[i]);
+  }
+}
+
+template <typename Real>
+double PixelSim::evaluateState(const std::vector<double> &u,
+                               std::vector<double> &f, double t) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  setState<Real>(u);
+  setStageTime<Real>(t);
+  calculateDcdt<Real>();
+  double norm{0};
+  for (std::size_t i = 0; i < simCompartments.size(); ++i) {
+    const auto &d{simCompartments[i]->getStateDcdt()};
+    std::copy(d.cbegin(), d.cend(), f.begin() + stateOffsets[i]);
+    norm = std::max(norm, simCompartments[i]->getDcdtNorm());
+  }
+  return norm;
+}
+
+template <typename Real> bool PixelSim::updateJacobian() {
+  bool hasJacobian{true};
+  for (auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    hasJacobian &= sim->updateJacobian();
+  }
+  return hasJacobian;
+}
+
+template <typename Real> void PixelSim::factoriseJacobian(double shift) {
+  for (auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    sim->factoriseJacobian(shift);
+  }
+}
+
+template <typename Real>
+void PixelSim::applyPreconditioner(std::vector<double> &v) const {
+  const auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  for (std::size_t i = 0; i < simCompartments.size(); ++i) {
+    simCompartments[i]->applyPreconditioner(v.data() + stateOffsets[i]);
+  }
+}
+
+template <typename Real>
+PixelStepError PixelSim::getStateError(const std::vector<double> &c,
+                                       const std::vector<double> &cOld,
+                                       const std::vector<double> &err) const {
+  const auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  PixelStepError e;
+  for (std::size_t i = 0; i < simCompartments.size(); ++i) {
+    const std::size_t offset{stateOffsets[i]};
+    auto compErr{simCompartments[i]->calculateStateError(
+        c.data() + offset, cOld.data() + offset, err.data() + offset,
+        epsilon)};
+    e.max.rel = std::max(e.max.rel, compErr.max.rel);
+    e.max.abs = std::max(e.max.abs, compErr.max.abs);
+    e.sumSquares += compErr.sumSquares;
+    e.n += compErr.n;
+  }
+  return e;
+}
+
+template <typename Real>
+bool PixelSim::solveSteadyState(double tolerance, std::size_t maxIterations) {
+  const auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  steadyStateConcentrations.clear();
+  steadyStateDcdtNorm = std::numeric_limits<double>::max();
+  const std::size_t n{stateOffsets.back()};
+  std::vector<double> u0(n);
+  getState<Real>(u0);
+  // f = dc/dt(v), returns the dc/dt norm
+  auto residual = [this](const std::vector<double> &v, std::vector<double> &f) {
+    return evaluateState<Real>(v, f, currentTime);
+  };
+  std::vector<double> u{u0};
+  std::vector<double> f(n);
+  double norm{residual(u, f)};
+  SPDLOG_DEBUG("steady state: initial dc/dt norm {}", norm);
+  // store the steady state u, which is the current state, then restore the
+  // concentrations to u0
+  auto storeSteadyState = [&]() {
+    steadyStateDcdtNorm = norm;
+    for (const auto &sim : simCompartments) {
+      steadyStateConcentrations.push_back(sim->getConcentrations());
+    }
+    residual(u0, f);
+    return true;
+  };
+  if (norm < tolerance) {
+    return storeSteadyState();
+  }
+  std::vector<double> du(n);
+  std::vector<double> uNew(n);
+  std::vector<double> fNew(n);
+  std::vector<double> uPerturbed(n);
+  std::vector<double> fPerturbed(n);
+  const double sqrtEps{std::sqrt(std::numeric_limits<Real>::epsilon())};
+  // pseudo-transient continuation: each iteration is a linearly implicit
+  // Euler step of length 1/shift, i.e. solves (shift - J) du = f, and the
+  // step length grows as the residual decreases, which gives Newton's method
+  // close to the steady state. The initial step length is the timescale of
+  // the current rate of change
+  double shift{norm};
+  for (std::size_t iter = 0; iter < maxIterations && std::isfinite(norm);
+       ++iter) {
+    bool usePreconditioner{updateJacobian<Real>()};
+    if (usePreconditioner) {
+      factoriseJacobian<Real>(shift);
+    }
+    const double uNorm{norm2(u)};
+    // Jacobian-vector products from finite differences of dc/dt, which
+    // includes the membrane reactions
+    auto applyA = [&](const std::vector<double> &v, std::vector<double> &av) {
+      const double vNorm{norm2(v)};
+      if (vNorm == 0.0) {
+        std::fill(av.begin(), av.end(), 0.0);
+        return;
+      }
+      const double h{sqrtEps * (1.0 + uNorm) / vNorm};
+      for (std::size_t i = 0; i < n; ++i) {
+        uPerturbed[i] = u[i] + h * v[i];
+      }
+      residual(uPerturbed, fPerturbed);
+      for (std::size_t i = 0; i < n; ++i) {
+        av[i] = shift * v[i] - (fPerturbed[i] - f[i]) / h;
+      }
+    };
+    auto applyM = [&](std::vector<double> &v) {
+      if (usePreconditioner) {
+        applyPreconditioner<Real>(v);
+      }
+    };
+    // the residual of the linear solve also changes any conserved
+    // quantities, so this is tighter than an inexact Newton method needs
+    constexpr double linearTolerance{1e-3};
+    constexpr std::size_t gmresRestart{20};
+    constexpr std::size_t gmresMaxRestarts{5};
+    solveGMRES(applyA, applyM, f, du, linearTolerance, gmresRestart,
+               gmresMaxRestarts);
+    // concentrations are kept non-negative
+    for (std::size_t i = 0; i < n; ++i) {
+      uNew[i] = std::max(u[i] + du[i], 0.0);
+    }
+    double normNew{residual(uNew, fNew)};
+    SPDLOG_DEBUG("steady state: iteration {}, step {}, dc/dt norm {}", iter,
+                 1.0 / shift, normNew);
+    if (std::isfinite(normNew) && normNew < 10.0 * norm) {
+      // switched evolution relaxation
+      shift *= normNew / norm;
+      std::swap(u, uNew);
+      std::swap(f, fNew);
+      norm = normNew;
+      if (norm < tolerance) {
+        return storeSteadyState();
+      }
+    } else {
+      // reject the step & retry with a shorter pseudo-timestep
+      shift *= 10.0;
+      residual(u, f);
+    }
+  }
+  SPDLOG_DEBUG("steady state: not found, dc/dt norm {}", norm);
+  residual(u0, f);
+  return false;
+}
+
+// derivatives at t of the Lagrange basis polynomials with nodes t, times[0],
+// ..., times[k-1]: the BDF approximation to dy/dt at t is c[0] y(t) +
+// sum_j c[j] y(times[j-1])
+static std::vector<double> getBDFCoefficients(double t,
+                                              const std::deque<double> &times,
+                                              std::size_t k) {
+  std::vector<double> nodes{t};
+  nodes.insert(nodes.end(), times.cbegin(),
+               times.cbegin() + static_cast<std::ptrdiff_t>(k));
+  std::vector<double> c(k + 1, 0.0);
+  for (std::size_t m = 1; m <= k; ++m) {
+    c[0] += 1.0 / (t - nodes[m]);
+  }
+  for (std::size_t j = 1; j <= k; ++j) {
+    double num{1.0};
+    double den{1.0};
+    for (std::size_t m = 0; m <= k; ++m) {
+      if (m != j) {
+        den *= nodes[j] - nodes[m];
+        if (m != 0) {
+          num *= t - nodes[m];
+        }
+      }
+    }
+    c[j] = num / den;
+  }
+  return c;
+}
+
+// y = value at t of the polynomial through the first n previous solutions
+static void extrapolate(std::vector<double> &y, double t,
+                        const std::deque<std::vector<double>> &history,
+                        const std::deque<double> &times, std::size_t n) {
+  std::fill(y.begin(), y.end(), 0.0);
+  for (std::size_t j = 0; j < n; ++j) {
+    double w{1.0};
+    for (std::size_t m = 0; m < n; ++m) {
+      if (m != j) {
+        w *= (t - times[m]) / (times[j] - times[m]);
+      }
+    }
+    const auto &h{history[j]};
+    for (std::size_t i = 0; i < y.size(); ++i) {
+      y[i] += w * h[i];
+    }
+  }
+}
+
+template <typename Real> double PixelSim::doBDF(double dtMax) {
+  // Variable step, variable order BDF, with coefficients from the polynomial
+  // through the previous solutions, see section III.5 of Hairer & Wanner.
+  // The nonlinear system for each step is solved with Newton's method, the
+  // linear systems with GMRES using finite difference Jacobian-vector
+  // products, and the block diagonal preconditioner is reused across steps.
+  constexpr std::size_t maxOrder{5};
+  constexpr std::size_t maxNewtonIterations{4};
+  constexpr std::size_t maxJacobianAge{20};
+  constexpr double linearTolerance{1e-3};
+  constexpr std::size_t gmresRestart{10};
+  constexpr std::size_t gmresMaxRestarts{4};
+  const std::size_t n{stateOffsets.back()};
+  std::vector<double> y(n);
+  if (bdfTimes.empty() || bdfTimes.front() != currentTime) {
+    // (re)start from the current state with a first order step
+    getState<Real>(y);
+    bdfHistory.assign(1, y);
+    bdfTimes.assign(1, currentTime);
+    bdfOrder = 1;
+    bdfStepsAtOrder = 0;
+  }
+  const std::size_t nHistory{bdfHistory.size()};
+  const auto &yOld{bdfHistory.front()};
+  std::vector<double> yPred(n);
+  std::vector<double> f(n);
+  std::vector<double> r(n);
+  std::vector<double> dy(n);
+  std::vector<double> yPerturbed(n);
+  std::vector<double> fPerturbed(n);
+  std::vector<double> err(n);
+  const double sqrtEps{std::sqrt(std::numeric_limits<Real>::epsilon())};
+  // with a single previous solution there is nothing to extrapolate: the
+  // predictor is an explicit Euler step, so that like the BDF1 local error
+  // the difference between the corrector and the predictor is O(dt^2)
+  std::vector<double> fOld;
+  if (nHistory == 1) {
+    fOld.resize(n);
+    evaluateState<Real>(yOld, fOld, currentTime);
+  }
+  double dt{std::min(nextTimestep, dtMax)};
+  while (true) {
+    const double t1{currentTime + dt};
+    const std::size_t k{std::min(bdfOrder, nHistory)};
+    // predictor: extrapolate the previous solutions
+    const std::size_t nPredict{std::min(k + 1, nHistory)};
+    if (nHistory == 1) {
+      for (std::size_t i = 0; i < n; ++i) {
+        yPred[i] = yOld[i] + dt * fOld[i];
+      }
+    } else {
+      extrapolate(yPred, t1, bdfHistory, bdfTimes, nPredict);
+    }
+    const auto c{getBDFCoefficients(t1, bdfTimes, k)};
+    // corrector: Newton iterations for c[0] y - dc/dt(y) = -sum_j c[j] y_j
+    y = yPred;
+    bool converged{false};
+    double dyNormPrevious{std::numeric_limits<double>::max()};
+    for (std::size_t iter = 0; iter < maxNewtonIterations; ++iter) {
+      evaluateState<Real>(y, f, t1);
+      for (std::size_t i = 0; i < n; ++i) {
+        r[i] = f[i] - c[0] * y[i];
+      }
+      for (std::size_t j = 1; j <= k; ++j) {
+        const auto &h{bdfHistory[j - 1]};
+        for (std::size_t i = 0; i < n; ++i) {
+          r[i] -= c[j] * h[i];
+        }
+      }
+      if (iter == 0) {
+        if (!bdfJacobianCurrent || bdfJacobianAge >= maxJacobianAge) {
+          bdfPreconditioner = updateJacobian<Real>();
+          bdfJacobianCurrent = true;
+          bdfJacobianAge = 0;
+          bdfShift = 0;
+        }
+        // only refactorise if the shift changed significantly
+        if (bdfPreconditioner && std::abs(c[0] - bdfShift) > 0.3 * bdfShift) {
+          factoriseJacobian<Real>(c[0]);
+          bdfShift = c[0];
+        }
+      }
+      const double yNorm{norm2(y)};
+      auto applyA = [&](const std::vector<double> &v,
+                        std::vector<double> &av) {
+        const double vNorm{norm2(v)};
+        if (vNorm == 0.0) {
+          std::fill(av.begin(), av.end(), 0.0);
+          return;
+        }
+        const double h{sqrtEps * (1.0 + yNorm) / vNorm};
+        for (std::size_t i = 0; i < n; ++i) {
+          yPerturbed[i] = y[i] + h * v[i];
+        }
+        evaluateState<Real>(yPerturbed, fPerturbed, t1);
+        for (std::size_t i = 0; i < n; ++i) {
+          av[i] = c[0] * v[i] - (fPerturbed[i] - f[i]) / h;
+        }
+      };
+      auto applyM = [&](std::vector<double> &v) {
+        if (bdfPreconditioner) {
+          applyPreconditioner<Real>(v);
+        }
+      };
+      solveGMRES(applyA, applyM, r, dy, linearTolerance, gmresRestart,
+                 gmresMaxRestarts);
+      for (std::size_t i = 0; i < n; ++i) {
+        y[i] += dy[i];
+      }
+      const double dyNorm{getErrorNorm(getStateError<Real>(y, yOld, dy))};
+      SPDLOG_TRACE("BDF{} dt = {}: Newton iteration {}, increment norm {}", k,
+                   dt, iter, dyNorm);
+      if (dyNorm <= 0.1) {
+        converged = true;
+        break;
+      }
+      if (!std::isfinite(dyNorm) || dyNorm > 0.9 * dyNormPrevious) {
+        break;
+      }
+      dyNormPrevious = dyNorm;
+    }
+    double errNorm{std::numeric_limits<double>::max()};
+    if (converged) {
+      // local error estimate from the difference between the corrector and
+      // the predictor: for the explicit Euler predictor this difference is
+      // dt^2 y'', twice the BDF1 local error
+      const double errFactor{nHistory == 1
+                                 ? 0.5
+                                 : dt / (t1 - bdfTimes[nPredict - 1])};
+      for (std::size_t i = 0; i < n; ++i) {
+        err[i] = errFactor * (y[i] - yPred[i]);
+      }
+      errNorm = getErrorNorm(getStateError<Real>(y, yOld, err));
+      SPDLOG_TRACE("BDF{} dt = {}: error norm {}", k, dt, errNorm);
+      if (errNorm <= 1.0) {
+        // accept step & choose the order and timestep of the next step
+        double factor{std::pow(std::max(errNorm, 1e-10),
+                               -1.0 / static_cast<double>(k + 1))};
+        std::size_t newOrder{k};
+        if (k > 1) {
+          extrapolate(yPred, t1, bdfHistory, bdfTimes, k);
+          const double lowerErrFactor{dt / (t1 - bdfTimes[k - 1])};
+          for (std::size_t i = 0; i < n; ++i) {
+            err[i] = lowerErrFactor * (y[i] - yPred[i]);
+          }
+          const double lowerNorm{
+              getErrorNorm(getStateError<Real>(y, yOld, err))};
+          const double lowerOrderFactor{std::pow(
+              std::max(lowerNorm, 1e-10), -1.0 / static_cast<double>(k))};
+          if (lowerOrderFactor > factor) {
+            newOrder = k - 1;
+            factor = lowerOrderFactor;
+          }
+        }
+        if (newOrder == k && k < maxOrder && bdfStepsAtOrder >= k + 1 &&
+            nHistory >= k + 2) {
+          extrapolate(yPred, t1, bdfHistory, bdfTimes, k + 2);
+          const double higherErrFactor{dt / (t1 - bdfTimes[k + 1])};
+          for (std::size_t i = 0; i < n; ++i) {
+            err[i] = higherErrFactor * (y[i] - yPred[i]);
+          }
+          const double higherNorm{
+              getErrorNorm(getStateError<Real>(y, yOld, err))};
+          const double higherOrderFactor{std::pow(
+              std::max(higherNorm, 1e-10), -1.0 / static_cast<double>(k + 2))};
+          if (higherOrderFactor > 1.2 * factor) {
+            newOrder = k + 1;
+            factor = higherOrderFactor;
+          }
+        }
+        factor = std::clamp(0.9 * factor, 0.2, 5.0);
+        if (factor > 1.0 && factor < 1.2) {
+          // keep the timestep to avoid refactorising the preconditioner
+          factor = 1.0;
+        }
+        bdfStepsAtOrder = newOrder == bdfOrder ? bdfStepsAtOrder + 1 : 0;
+        bdfOrder = newOrder;
+        nextTimestep = dt * factor;
+        ++bdfJacobianAge;
+        setState<Real>(y);
+        bdfHistory.push_front(y);
+        bdfTimes.push_front(t1);
+        if (bdfHistory.size() > maxOrder + 2) {
+          bdfHistory.pop_back();
+          bdfTimes.pop_back();
+        }
+        return dt;
+      }
+    }
+    ++discardedSteps;
+    ++nDiscardedSteps;
+    if (!converged && bdfJacobianAge > 0) {
+      // retry with an up to date Jacobian
+      SPDLOG_TRACE("BDF{} dt = {}: Newton failed, updating Jacobian", k, dt);
+      bdfJacobianCurrent = false;
+    } else if (!converged) {
+      dt *= 0.25;
+    } else {
+      dt *= std::max(
+          0.2, 0.9 * std::pow(errNorm, -1.0 / static_cast<double>(k + 1)));
+    }
+    if (dt / std::min(dtMax, outputInterval) < 1e-20) {
+      setState<Real>(yOld);
+      currentErrorImage = {};
+      currentErrorMessage =
+          "Failed to solve model to required accuracy using the BDF "
+          "integrator: the timestep became too small.";
+      nextTimestep = dt;
+      return dt;
+    }
+  }
+}
+
+template <typename Real>
+void PixelSim::compileReactions(std::size_t maxThreads) {
+  std::vector<std::function<void()>> tasks;
+  for (auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    tasks.emplace_back([s = sim.get()]() { s->compileReactions(); });
+  }
+  for (auto &sim : std::get<Sims<Real>>(sims).simMembranes) {
+    tasks.emplace_back([s = sim.get()]() { s->compileReactions(); });
+  }
+  if (tasks.empty()) {
+    return;
+  }
+  std::size_t nThreads{1};
+  if (utils::isSymbolicThreadSafe()) {
+    // 0 means use all available threads
+    nThreads = maxThreads;
+    if (nThreads == 0) {
+      nThreads = std::thread::hardware_concurrency();
+    }
+    nThreads = std::clamp(nThreads, std::size_t{1}, tasks.size());
+  }
+  SPDLOG_INFO("Compiling {} reaction kernels using {} threads", tasks.size(),
+              nThreads);
+  if (nThreads <= 1) {
+    for (const auto &task : tasks) {
+      task();
+    }
+    return;
+  }
+  // each worker takes the next task until there are none left
+  std::atomic<std::size_t> nextTask{0};
+  auto worker{[&tasks, &nextTask]() {
+    for (std::size_t i = nextTask++; i < tasks.size(); i = nextTask++) {
+      tasks[i]();
+    }
+  }};
+  std::vector<std::future<void>> workers;
+  for (std::size_t i = 1; i < nThreads; ++i) {
+    workers.push_back(std::async(std::launch::async, worker));
+  }
+  worker();
+  // rethrows any exception from a worker
+  for (auto &w : workers) {
+    w.get();
+  }
+}
+
+template <typename Real> void PixelSim::applySimulationData() {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  const auto &data{doc.getSimulationData()};
+  if (data.concentration.size() > 1 && !data.concentration.back().empty() &&
+      (data.concentration.back().size() == simCompartments.size())) {
+    SPDLOG_INFO("Applying supplied initial concentrations");
+    currentTime = data.timePoints.back();
+    // data from older versions may include padding after the species
+    const std::size_t padding{data.concPadding.back()};
+    for (std::size_t i = 0; i < simCompartments.size(); ++i) {
+      const auto &c{data.concentration.back()[i]};
+      if (padding == 0) {
+        simCompartments[i]->setConcentrations(c);
+        continue;
+      }
+      const std::size_t nSpecies{simCompartments[i]->getSpeciesIds().size()};
+      std::vector<double> unpadded;
+      unpadded.reserve(c.size() / (nSpecies + padding) * nSpecies);
+      for (std::size_t j = 0; j < c.size(); j += nSpecies + padding) {
+        unpadded.insert(unpadded.end(), c.cbegin() + j,
+                        c.cbegin() + j + nSpecies);
+      }
+      simCompartments[i]->setConcentrations(unpadded);
+    }
+  }
+}
+
+template <typename Real> void PixelSim::updateStateLayout() {
+  const auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  stateOffsets = {0};
+  for (const auto &sim : simCompartments) {
+    stateOffsets.push_back(stateOffsets.back() +
+                           sim->getStateConcentrations().size());
+  }
+  // uniform compartments have no diffusion stability limit: only known once
+  // membranes & initial concentrations have been applied
+  maxStableTimestep = std::numeric_limits<double>::max();
+  for (const auto &sim : simCompartments) {
+    maxStableTimestep =
+        std::min(maxStableTimestep, sim->getMaxStableTimestep());
+    if (sim->isUniform()) {
+      SPDLOG_INFO("Compartment '{}' is spatially uniform: integrating a "
+                  "single pixel",
+                  sim->getCompartmentId());
+    }
+  }
+}
+
+template <typename Real> void PixelSim::collapseUniformCompartments() {
+  bool collapsed{false};
+  for (auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    collapsed = sim->collapseIfUniform() || collapsed;
+  }
+  if (!collapsed) {
+    return;
+  }
+  updateStateLayout<Real>();
+  // the stored steps use the previous state layout
+  bdfHistory.clear();
+  bdfTimes.clear();
+  bdfJacobianCurrent = false;
+  stepError.reset();
+}
+
+template <typename Real> void PixelSim::restartSims() {
+  std::vector<double> values;
+  for (const auto &[id, value] : runtimeParameters) {
+    SPDLOG_DEBUG("  - runtime parameter {} = {}", id, value);
+    values.push_back(value);
+  }
+  for (auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    sim->setRuntimeParameters(values);
+  }
+  for (auto &sim : std::get<Sims<Real>>(sims).simMembranes) {
+    sim->setRuntimeParameters(values);
+  }
+  applySimulationData<Real>();
+  // a species event can switch a compartment between uniform & spatial
+  updateStateLayout<Real>();
+  outputTime = currentTime;
+  // the solution is not smooth across the restart: discard any stored steps
+  clearDenseOutput();
+  bdfHistory.clear();
+  bdfTimes.clear();
+  bdfJacobianCurrent = false;
+  stepError.reset();
+  previousErrorNorm = 1.0;
+}
+
+template <typename Real>
+void PixelSim::initSims(
+    const std::vector<std::string> &compartmentIds,
+    const std::vector<std::vector<std::string>> &compartmentSpeciesIds,
+    const std::map<std::string, double, std::less<>> &substitutions,
+    bool timeDependent, bool spaceDependent, std::size_t maxCompileThreads) {
+  auto &simCompartments{std::get<Sims<Real>>(sims).simCompartments};
+  auto &simMembranes{std::get<Sims<Real>>(sims).simMembranes};
+  const auto &options{doc.getSimulationSettings().options};
+  // the analytic reaction Jacobian is only needed by implicit solvers
+  const bool reactionJacobian{options.steadyState.newtonKrylov ||
+                              integrator == PixelIntegratorType::BDF};
+  // add compartments
+  for (std::size_t compIndex = 0; compIndex < compartmentIds.size();
+       ++compIndex) {
+    const auto &speciesIds{compartmentSpeciesIds[compIndex]};
+    const auto *compartment{doc.getCompartments().getCompartment(
+        compartmentIds[compIndex].c_str())};
+    simCompartments.push_back(std::make_unique<SimCompartment<Real>>(
+        doc, compartment, speciesIds, options.pixel, timeDependent,
+        spaceDependent, substitutions, reactionJacobian, runtimeParameters));
+  }
+  // add membranes
+  for (const auto &membrane : doc.getMembranes().getMembranes()) {
+    if (auto reacsInMembrane =
+            doc.getReactions().getIds(membrane.getId().c_str());
+        !reacsInMembrane.isEmpty()) {
+      // look for the two membrane compartments in simCompartments
+      std::string compIdA = membrane.getCompartmentA()->getId();
+      std::string compIdB = membrane.getCompartmentB()->getId();
+      auto iterA =
+          std::find_if(simCompartments.begin(), simCompartments.end(),
+                       [&compIdA](const auto &c) {
+                         return c->getCompartmentId() == compIdA;
+                       });
+      auto iterB =
+          std::find_if(simCompartments.begin(), simCompartments.end(),
+                       [&compIdB](const auto &c) {
+                         return c->getCompartmentId() == compIdB;
+                       });
+      SimCompartment<Real> *compA{nullptr};
+      if (iterA != simCompartments.cend()) {
+        compA = iterA->get();
+      }
+      SimCompartment<Real> *compB{nullptr};
+      if (iterB != simCompartments.cend()) {
+        compB = iterB->get();
+      }
+      simMembranes.push_back(std::make_unique<SimMembrane<Real>>(
+          doc, &membrane, compA, compB,
+          doc.getSimulationSettings().options.pixel.doCSE,
+          doc.getSimulationSettings().options.pixel.optLevel, timeDependent,
+          spaceDependent, substitutions, options.pixel.tieredCompilation,
+          runtimeParameters));
+    }
+  }
+  compileReactions<Real>(maxCompileThreads);
+  tieredCompilationPending = options.pixel.tieredCompilation;
+  applySimulationData<Real>();
+  updateStateLayout<Real>();
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  if (useTBB) {
+    auto &s{std::get<Sims<Real>>(sims)};
+    s.taskGraph = std::make_unique<PixelTaskGraph<Real>>(s);
+  }
+#endif
+}
+
+// global constants that are the variable of an event, with their values
+static std::vector<std::pair<std::string, double>> getEventParameters(
+    const model::Model &doc,
+    const std::map<std::string, double, std::less<>> &substitutions) {
+  std::vector<std::pair<std::string, double>> parameters;
+  const auto &events{doc.getEvents()};
+  const auto constants{doc.getParameters().getGlobalConstants()};
+  for (const auto &eventId : events.getIds()) {
+    if (!events.isParameter(eventId)) {
+      continue;
+    }
+    auto id{events.getVariable(eventId).toStdString()};
+    if (std::find_if(parameters.cbegin(), parameters.cend(),
+                     [&id](const auto &p) { return p.first == id; }) !=
+        parameters.cend()) {
+      continue;
+    }
+    auto iter{std::find_if(constants.cbegin(), constants.cend(),
+                           [&id](const auto &c) { return c.id == id; })};
+    if (iter == constants.cend()) {
+      SPDLOG_WARN("Event variable '{}' is not a constant parameter: events "
+                  "will recompile the reaction terms",
+                  id);
+      continue;
+    }
+    double value{iter->value};
+    if (auto s{substitutions.find(id)}; s != substitutions.cend()) {
+      value = s->second;
+    }
+    parameters.emplace_back(id, value);
+  }
+  return parameters;
+}
+
 PixelSim::PixelSim(
     const model::Model &sbmlDoc, const std::vector<std::string> &compartmentIds,
     const std::vector<std::vector<std::string>> &compartmentSpeciesIds,
@@ -227,79 +1634,46 @@ PixelSim::PixelSim(
     : doc{sbmlDoc},
       integrator{sbmlDoc.getSimulationSettings().options.pixel.integrator},
       errMax{sbmlDoc.getSimulationSettings().options.pixel.maxErr},
+      piController{sbmlDoc.getSimulationSettings().options.pixel.piController},
+      rmsErrorNorm{sbmlDoc.getSimulationSettings().options.pixel.rmsErrorNorm},
       maxTimestep{sbmlDoc.getSimulationSettings().options.pixel.maxTimestep},
+      multirate{sbmlDoc.getSimulationSettings().options.pixel.multirate},
+      singlePrecision{
+          sbmlDoc.getSimulationSettings().options.pixel.singlePrecision},
+      denseOutput{sbmlDoc.getSimulationSettings().options.pixel.denseOutput},
       numMaxThreads{sbmlDoc.getSimulationSettings().options.pixel.maxThreads} {
   try {
+    if (denseOutput &&
+        sbmlDoc.getSimulationSettings().options.steadyState.tolerance > 0) {
+      // dc/dt is evaluated for the current state, so the output must be the
+      // current state, not one interpolated from it
+      SPDLOG_INFO("Dense output is not used when checking for a steady state");
+      denseOutput = false;
+    }
+    if (multirate && integrator != PixelIntegratorType::RK101 &&
+        integrator != PixelIntegratorType::RK212 &&
+        integrator != PixelIntegratorType::RK323 &&
+        integrator != PixelIntegratorType::RK435) {
+      SPDLOG_WARN("Multirate time stepping is only supported by the explicit "
+                  "RK integrators: ignoring");
+      multirate = false;
+    }
+    if (sbmlDoc.getSimulationSettings().options.pixel.runtimeParameters) {
+      useRuntimeParameters = true;
+      runtimeParameters = getEventParameters(doc, substitutions);
+    }
     // check if reactions explicitly depend on time or space
     auto xId{doc.getParameters().getSpatialCoordinates().x.id};
     auto yId{doc.getParameters().getSpatialCoordinates().y.id};
     bool timeDependent{doc.getReactions().dependOnVariable("time")};
-    if (timeDependent) {
-      ++nExtraVars;
-    }
     bool spaceDependent{doc.getReactions().dependOnVariable(xId.c_str()) ||
                         doc.getReactions().dependOnVariable(yId.c_str())};
-    if (spaceDependent) {
-      nExtraVars += 2;
-    }
-    // add compartments
-    for (std::size_t compIndex = 0; compIndex < compartmentIds.size();
-         ++compIndex) {
-      const auto &speciesIds{compartmentSpeciesIds[compIndex]};
-      const auto *compartment{doc.getCompartments().getCompartment(
-          compartmentIds[compIndex].c_str())};
-      simCompartments.push_back(std::make_unique<SimCompartment>(
-          doc, compartment, speciesIds,
-          sbmlDoc.getSimulationSettings().options.pixel.doCSE,
-          sbmlDoc.getSimulationSettings().options.pixel.optLevel, timeDependent,
-          spaceDependent, substitutions));
-      maxStableTimestep = std::min(
-          maxStableTimestep, simCompartments.back()->getMaxStableTimestep());
-    }
-    // add membranes
-    for (const auto &membrane : doc.getMembranes().getMembranes()) {
-      if (auto reacsInMembrane =
-              doc.getReactions().getIds(membrane.getId().c_str());
-          !reacsInMembrane.isEmpty()) {
-        // look for the two membrane compartments in simCompartments
-        std::string compIdA = membrane.getCompartmentA()->getId();
-        std::string compIdB = membrane.getCompartmentB()->getId();
-        auto iterA =
-            std::find_if(simCompartments.begin(), simCompartments.end(),
-                         [&compIdA](const auto &c) {
-                           return c->getCompartmentId() == compIdA;
-                         });
-        auto iterB =
-            std::find_if(simCompartments.begin(), simCompartments.end(),
-                         [&compIdB](const auto &c) {
-                           return c->getCompartmentId() == compIdB;
-                         });
-        SimCompartment *compA{nullptr};
-        if (iterA != simCompartments.cend()) {
-          compA = iterA->get();
-        }
-        SimCompartment *compB{nullptr};
-        if (iterB != simCompartments.cend()) {
-          compB = iterB->get();
-        }
-        simMembranes.push_back(std::make_unique<SimMembrane>(
-            doc, &membrane, compA, compB,
-            sbmlDoc.getSimulationSettings().options.pixel.doCSE,
-            sbmlDoc.getSimulationSettings().options.pixel.optLevel,
-            timeDependent, spaceDependent, substitutions));
-      }
-    }
-    // apply existing simulation concentrations if present
-    const auto &data{sbmlDoc.getSimulationData()};
-    if (data.concentration.size() > 1 && !data.concentration.back().empty() &&
-        (data.concentration.back().size() == simCompartments.size())) {
-      SPDLOG_INFO("Applying supplied initial concentrations");
-      for (std::size_t i = 0; i < simCompartments.size(); ++i) {
-        simCompartments[i]->setConcentrations(data.concentration.back()[i]);
-      }
-    }
+    // resolve the thread limit first: it also limits the number of threads
+    // used to compile the reaction terms
+    bool multiThreading{
+        sbmlDoc.getSimulationSettings().options.pixel.enableMultiThreading};
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-    if (sbmlDoc.getSimulationSettings().options.pixel.enableMultiThreading) {
+    if (multiThreading) {
       useTBB = true;
     }
     if (numMaxThreads == 0) {
@@ -308,7 +1682,7 @@ PixelSim::PixelSim(
           tbb::task_scheduler_init::default_num_threads());
     }
 #elif defined(SPATIAL_MODEL_EDITOR_WITH_OPENMP)
-    if (!sbmlDoc.getSimulationSettings().options.pixel.enableMultiThreading) {
+    if (!multiThreading) {
       numMaxThreads = 1;
     }
     if (auto ompMaxThreads{static_cast<std::size_t>(omp_get_num_procs())};
@@ -318,12 +1692,22 @@ PixelSim::PixelSim(
     }
     omp_set_num_threads(static_cast<int>(numMaxThreads));
 #else
-    if (sbmlDoc.getSimulationSettings().options.pixel.enableMultiThreading) {
+    if (multiThreading) {
       SPDLOG_WARN(
           "Multithreading requested but not compiled with TBB or OpenMP "
           "support: ignoring");
+      multiThreading = false;
     }
 #endif
+    const std::size_t maxCompileThreads{multiThreading ? numMaxThreads : 1};
+    if (singlePrecision) {
+      initSims<float>(compartmentIds, compartmentSpeciesIds, substitutions,
+                      timeDependent, spaceDependent, maxCompileThreads);
+    } else {
+      initSims<double>(compartmentIds, compartmentSpeciesIds, substitutions,
+                       timeDependent, spaceDependent, maxCompileThreads);
+    }
+    outputTime = currentTime;
   } catch (const std::runtime_error &e) {
     SPDLOG_ERROR("runtime_error: {}", e.what());
     currentErrorMessage = e.what();
@@ -332,6 +1716,35 @@ PixelSim::PixelSim(
 
 PixelSim::~PixelSim() = default;
 
+template <typename Real> double PixelSim::doTimestep(double dtMax) {
+  double dt;
+  if (integrator == PixelIntegratorType::RK101 && multirate) {
+    dt = std::min(dtMax, getMultirateTimestep<Real>());
+    doMultirateRK101<Real>(dt);
+  } else if (multirate) {
+    dt = doMultirateRKAdaptive<Real>(dtMax);
+  } else if (integrator == PixelIntegratorType::RK101) {
+    dt = std::min(dtMax, maxStableTimestep);
+    doRK101<Real>(dt);
+  } else if (integrator == PixelIntegratorType::BDF) {
+    // every dcdt evaluation sets the state, which wakes all tiles
+    return doBDF<Real>(dtMax);
+  } else {
+    dt = doRKAdaptive<Real>(dtMax);
+  }
+  // freeze or wake tiles of pixels using the dcdt of the accepted step
+  for (auto &sim : std::get<Sims<Real>>(sims).simCompartments) {
+    if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+      sim->updateActivity_tbb();
+#endif
+    } else {
+      sim->updateActivity();
+    }
+  }
+  return dt;
+}
+
 std::size_t PixelSim::run(double time, double timeout_ms) {
   SPDLOG_TRACE("  - max rel local err {}", errMax.rel);
   SPDLOG_TRACE("  - max abs local err {}", errMax.abs);
@@ -346,21 +1759,53 @@ std::size_t PixelSim::run(double time, double timeout_ms) {
   double tNow = 0;
   std::size_t steps = 0;
   discardedSteps = 0;
+  outputInterval = time;
+  // fixed timestep RK101 & BDF have no stored stages to interpolate from
+  const bool useDenseOutput{denseOutput &&
+                            integrator != PixelIntegratorType::RK101 &&
+                            integrator != PixelIntegratorType::BDF};
+  if (useDenseOutput) {
+    // the last step may already have gone past the previous output time
+    tNow = currentTime - outputTime;
+  }
   // do timesteps until we reach t
   constexpr double relativeTolerance = 1e-12;
   while (tNow + time * relativeTolerance < time) {
-    double maxDt = std::min(maxTimestep, time - tNow);
-    if (integrator == PixelIntegratorType::RK101) {
-      double timestep = std::min(maxDt, maxStableTimestep);
-      doRK101(timestep);
-      tNow += timestep;
-    } else {
-      tNow += doRKAdaptive(maxDt);
-      if (!currentErrorMessage.empty()) {
-        return steps;
+    double maxDt = maxTimestep;
+    if (!useDenseOutput) {
+      maxDt = std::min(maxDt, time - tNow);
+    }
+    if (integrator == PixelIntegratorType::RKL2) {
+      maxDt = std::min(maxDt, getRKL2MaxTimestep());
+    }
+    if (tieredCompilationPending) {
+      // only switch between steps, never within one
+      if (singlePrecision) {
+        updateTieredCompilation<float>();
+      } else {
+        updateTieredCompilation<double>();
+      }
+    }
+    double timestep =
+        singlePrecision ? doTimestep<float>(maxDt) : doTimestep<double>(maxDt);
+    if (!currentErrorMessage.empty()) {
+      if (useDenseOutput) {
+        clearDenseOutput();
+      }
+      return steps;
+    }
+    if (useDenseOutput && tNow + timestep > time) {
+      // this step goes past the output time
+      if (singlePrecision) {
+        storeDenseOutput<float>(currentTime, timestep);
+      } else {
+        storeDenseOutput<double>(currentTime, timestep);
       }
     }
+    tNow += timestep;
+    currentTime += timestep;
     ++steps;
+    ++nAcceptedSteps;
     if (timeout_ms >= 0.0 &&
         static_cast<double>(timer.elapsed()) >= timeout_ms) {
       SPDLOG_DEBUG("Simulation timeout: requesting stop");
@@ -369,9 +1814,27 @@ std::size_t PixelSim::run(double time, double timeout_ms) {
     if (stopRequested.load()) {
       currentErrorMessage = "Simulation stopped early";
       SPDLOG_DEBUG("Simulation timeout or stopped early");
+      if (useDenseOutput) {
+        // output time was not reached: discard any interpolated output
+        clearDenseOutput();
+      }
       return steps;
     }
   }
+  outputTime += time;
+  if (useDenseOutput) {
+    if (singlePrecision) {
+      setDenseOutput<float>(time * relativeTolerance);
+    } else {
+      setDenseOutput<double>(time * relativeTolerance);
+    }
+  } else if (singlePrecision) {
+    // the dense output of a step is interpolated from its stored state, so
+    // compartments are only collapsed without dense output
+    collapseUniformCompartments<float>();
+  } else {
+    collapseUniformCompartments<double>();
+  }
   SPDLOG_DEBUG("t={} integrated using {} steps ({:3.1f}% discarded)", time,
                steps + discardedSteps,
                static_cast<double>(100 * discardedSteps) /
@@ -379,25 +1842,92 @@ std::size_t PixelSim::run(double time, double timeout_ms) {
   return steps;
 }
 
-const std::vector<double> &
+std::vector<double>
 PixelSim::getConcentrations(std::size_t compartmentIndex) const {
-  return simCompartments[compartmentIndex]->getConcentrations();
+  if (singlePrecision) {
+    return std::get<Sims<float>>(sims)
+        .simCompartments[compartmentIndex]
+        ->getConcentrations();
+  }
+  return std::get<Sims<double>>(sims)
+      .simCompartments[compartmentIndex]
+      ->getConcentrations();
 }
 
-std::size_t PixelSim::getConcentrationPadding() const { return nExtraVars; }
+std::size_t PixelSim::getConcentrationPadding() const { return 0; }
 
-const std::vector<double> &
+std::vector<double>
 PixelSim::getDcdt(std::size_t compartmentIndex) const {
-  return simCompartments[compartmentIndex]->getDcdt();
+  if (singlePrecision) {
+    return std::get<Sims<float>>(sims)
+        .simCompartments[compartmentIndex]
+        ->getDcdt();
+  }
+  return std::get<Sims<double>>(sims)
+      .simCompartments[compartmentIndex]
+      ->getDcdt();
 }
 
 double PixelSim::getLowerOrderConcentration(std::size_t compartmentIndex,
                                             std::size_t speciesIndex,
                                             std::size_t pixelIndex) const {
-  return simCompartments[compartmentIndex]->getLowerOrderConcentration(
-      speciesIndex, pixelIndex);
+  if (singlePrecision) {
+    return std::get<Sims<float>>(sims)
+        .simCompartments[compartmentIndex]
+        ->getLowerOrderConcentration(speciesIndex, pixelIndex);
+  }
+  return std::get<Sims<double>>(sims)
+      .simCompartments[compartmentIndex]
+      ->getLowerOrderConcentration(speciesIndex, pixelIndex);
 }
 
+std::size_t PixelSim::getAcceptedSteps() const { return nAcceptedSteps; }
+
+std::size_t PixelSim::getDiscardedSteps() const { return nDiscardedSteps; }
+
+std::size_t PixelSim::getFrozenTiles(std::size_t compartmentIndex) const {
+  if (singlePrecision) {
+    return std::get<Sims<float>>(sims)
+        .simCompartments[compartmentIndex]
+        ->getFrozenTiles();
+  }
+  return std::get<Sims<double>>(sims)
+      .simCompartments[compartmentIndex]
+      ->getFrozenTiles();
+}
+
+bool PixelSim::getIsUniform(std::size_t compartmentIndex) const {
+  if (singlePrecision) {
+    return std::get<Sims<float>>(sims)
+        .simCompartments[compartmentIndex]
+        ->isUniform();
+  }
+  return std::get<Sims<double>>(sims)
+      .simCompartments[compartmentIndex]
+      ->isUniform();
+}
+
+double PixelSim::getDcdtNorm() {
+  if (singlePrecision) {
+    return getDcdtNorm<float>();
+  }
+  return getDcdtNorm<double>();
+}
+
+bool PixelSim::solveSteadyState(double tolerance, std::size_t maxIterations) {
+  if (singlePrecision) {
+    return solveSteadyState<float>(tolerance, maxIterations);
+  }
+  return solveSteadyState<double>(tolerance, maxIterations);
+}
+
+const std::vector<double> &
+PixelSim::getSteadyStateConcentrations(std::size_t compartmentIndex) const {
+  return steadyStateConcentrations[compartmentIndex];
+}
+
+double PixelSim::getSteadyStateDcdtNorm() const { return steadyStateDcdtNorm; }
+
 const std::string &PixelSim::errorMessage() const {
   return currentErrorMessage;
 }
@@ -406,4 +1936,31 @@ const QImage &PixelSim::errorImage() const { return currentErrorImage; }
 
 void PixelSim::setStopRequested(bool stop) { stopRequested.store(stop); }
 
+bool PixelSim::restart(
+    const std::map<std::string, double, std::less<>> &substitutions) {
+  if (!useRuntimeParameters || !currentErrorMessage.empty()) {
+    return false;
+  }
+  for (const auto &[id, value] : substitutions) {
+    if (std::find_if(runtimeParameters.cbegin(), runtimeParameters.cend(),
+                     [&id = id](const auto &p) { return p.first == id; }) ==
+        runtimeParameters.cend()) {
+      SPDLOG_INFO("'{}' is not a runtime parameter: cannot restart", id);
+      return false;
+    }
+  }
+  for (auto &[id, value] : runtimeParameters) {
+    if (auto iter{substitutions.find(id)}; iter != substitutions.cend()) {
+      value = iter->second;
+    }
+  }
+  SPDLOG_DEBUG("Restarting with new parameter values");
+  if (singlePrecision) {
+    restartSims<float>();
+  } else {
+    restartSims<double>();
+  }
+  return true;
+}
+
 } // namespace sme::simulate
@@ -7,10 +7,15 @@
 #include <QImage>
 #include <atomic>
 #include <cstddef>
+#include <deque>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <map>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace sme {
@@ -21,28 +26,177 @@ class Model;
 
 namespace simulate {
 
-class SimCompartment;
-class SimMembrane;
+template <typename Real> class SimCompartment;
+template <typename Real> class SimMembrane;
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real> class PixelTaskGraph;
+#endif
+
+// error estimate of a step, accumulated over the state of the compartments
+struct PixelStepError {
+  // largest absolute & relative error
+  PixelIntegratorError max{0.0, 0.0};
+  // sum of the squared errors, each weighted by 1 / (abs + rel |c|), and the
+  // number of terms in the sum
+  double sumSquares{0.0};
+  std::size_t n{0};
+};
+
+template <typename Real> struct Sims {
+  std::vector<std::unique_ptr<SimCompartment<Real>>> simCompartments;
+  std::vector<std::unique_ptr<SimMembrane<Real>>> simMembranes;
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  // built once the compartments & membranes have been created
+  std::unique_ptr<PixelTaskGraph<Real>> taskGraph;
+#endif
+};
 
 class PixelSim : public BaseSim {
 private:
-  std::vector<std::unique_ptr<SimCompartment>> simCompartments;
-  std::vector<std::unique_ptr<SimMembrane>> simMembranes;
+  // only the Sims matching the chosen precision are used
+  std::tuple<Sims<double>, Sims<float>> sims;
   const model::Model &doc;
   double maxStableTimestep{std::numeric_limits<double>::max()};
-  void calculateDcdt();
-  void doRK101(double dt);
-  void doRK212(double dt);
-  void doRK323(double dt);
-  void doRK435(double dt);
+  // simulation time at the start of the current timestep
+  double currentTime{0};
+  // time of the last output: with dense output this can be before currentTime
+  double outputTime{0};
+  // start time & length of the step stored for dense output
+  double denseT0{0};
+  double denseDt{0};
+  // length of the current output interval
+  double outputInterval{std::numeric_limits<double>::max()};
+  template <typename Real> void storeDenseOutput(double t0, double dt);
+  // interpolate concentrations at outputTime if the last step went past it
+  template <typename Real> void setDenseOutput(double tolerance);
+  void clearDenseOutput();
+  template <typename Real>
+  void initSims(
+      const std::vector<std::string> &compartmentIds,
+      const std::vector<std::vector<std::string>> &compartmentSpeciesIds,
+      const std::map<std::string, double, std::less<>> &substitutions,
+      bool timeDependent, bool spaceDependent, std::size_t maxCompileThreads);
+  // compile the reaction terms of all compartments & membranes concurrently,
+  // using at most maxThreads threads (0 means use all available threads)
+  template <typename Real> void compileReactions(std::size_t maxThreads);
+  // set concentrations & time from the last time point of the simulation data
+  template <typename Real> void applySimulationData();
+  // parameters changed by events that are inputs to the reaction terms, with
+  // their current values, see PixelOptions::runtimeParameters
+  bool useRuntimeParameters{false};
+  std::vector<std::pair<std::string, double>> runtimeParameters;
+  template <typename Real> void restartSims();
+  // state offsets & stable timestep: depend on which compartments are uniform
+  template <typename Real> void updateStateLayout();
+  // integrate any compartments that have become uniform as a single pixel
+  template <typename Real> void collapseUniformCompartments();
+  template <typename Real> void setStageTime(double t);
+  template <typename Real> void calculateDcdt(bool includeDiffusion = true);
+  template <typename Real> double getDcdtNorm();
+  // reaction terms are still being compiled in the background
+  bool tieredCompilationPending{false};
+  // switch any sims whose compiled reaction terms are ready to use them
+  template <typename Real> void updateTieredCompilation();
+  // offsets of each compartment in the combined state vector: each
+  // compartment is a contiguous block ordered as its internal state arrays
+  std::vector<std::size_t> stateOffsets{0};
+  template <typename Real> void getState(std::vector<double> &u) const;
+  template <typename Real> void setState(const std::vector<double> &u);
+  // set the state to u and evaluate f = dc/dt at time t, returns the dc/dt
+  // norm
+  template <typename Real>
+  double evaluateState(const std::vector<double> &u, std::vector<double> &f,
+                       double t);
+  // block diagonal preconditioner for implicit solves, see SimCompartment
+  template <typename Real> bool updateJacobian();
+  template <typename Real> void factoriseJacobian(double shift);
+  template <typename Real>
+  void applyPreconditioner(std::vector<double> &v) const;
+  template <typename Real>
+  PixelStepError getStateError(const std::vector<double> &c,
+                               const std::vector<double> &cOld,
+                               const std::vector<double> &err) const;
+  template <typename Real>
+  bool solveSteadyState(double tolerance, std::size_t maxIterations);
+  // concentrations of each compartment & dc/dt norm of the last steady state
+  // found by solveSteadyState
+  std::vector<std::vector<double>> steadyStateConcentrations;
+  double steadyStateDcdtNorm{std::numeric_limits<double>::max()};
+  template <typename Real> void doRK101(double dt);
+  // multirate: evaluate the membrane fluxes at currentTime and store them in
+  // each compartment, to be held constant over the step
+  template <typename Real> void storeMembraneFluxes();
+  // dcdt of a single compartment at time t, using its stored membrane flux
+  template <typename Real>
+  void calculateCompartmentDcdt(SimCompartment<Real> &sim, double t);
+  template <typename Real> void doMultirateRK101(double dt);
+  template <typename Real> double getMultirateTimestep() const;
+  // multirate adaptive RK: each compartment takes its own adaptive steps to
+  // the end of the step, which is the longest of these timesteps
+  std::vector<double> compartmentNextTimestep;
+  std::vector<double> compartmentErrorNorm;
+  template <typename Real>
+  PixelStepError doCompartmentRKStep(SimCompartment<Real> &sim, double t0,
+                                     double dt);
+  template <typename Real> double doMultirateRKAdaptive(double dtMax);
+  template <typename Real> void doRK212(double dt);
+  // RK323 or RK435
+  template <typename Real> void doLowStorageRK(double dt);
+  template <typename Real> void doIMEX(double dt);
+  template <typename Real> void doRKL2(double dt);
+  double getRKL2MaxTimestep() const;
+  // BDF: previous solutions & their times, most recent first
+  std::deque<std::vector<double>> bdfHistory;
+  std::deque<double> bdfTimes;
+  std::size_t bdfOrder{1};
+  std::size_t bdfStepsAtOrder{0};
+  // the Jacobian is reused across steps: the number of steps since it was
+  // evaluated, and the shift used in the current factorisation
+  bool bdfJacobianCurrent{false};
+  bool bdfPreconditioner{false};
+  std::size_t bdfJacobianAge{0};
+  double bdfShift{0};
+  // do a single adaptive BDF step of at most dtMax, returns the timestep taken
+  template <typename Real> double doBDF(double dtMax);
+  template <typename Real>
   void doRKSubstep(double dt, double g1, double g2, double g3, double beta,
                    double delta);
-  double doRKAdaptive(double dtMax);
-  double doTimestep(double dt, double dtMax);
+  // error estimate of the last step, if the integrator calculated it while
+  // finalising the step
+  std::optional<PixelStepError> stepError;
+  // normalised error of a step: the step is accepted if this is at most 1
+  double getErrorNorm(const PixelStepError &err) const;
+  // factor to multiply the timestep by after a step with normalised error
+  // errNorm, given that of the previous accepted step
+  double getStepSizeFactor(double errNorm, double previousErrNorm,
+                           bool rejected) const;
+  // set the error message & image when a step can't reach the required
+  // accuracy, showing only simCompartment if it is not null
+  template <typename Real>
+  void setAccuracyError(double maxRelErr,
+                        const SimCompartment<Real> *simCompartment = nullptr);
+  template <typename Real>
+  void doRKFinalise(double cFactor, double s2Factor, double s3Factor);
+  template <typename Real> double doRKAdaptive(double dtMax);
+  // do a single timestep of at most dtMax, returns the timestep taken
+  template <typename Real> double doTimestep(double dtMax);
   std::size_t discardedSteps{0};
+  // totals over all calls to run
+  std::size_t nAcceptedSteps{0};
+  std::size_t nDiscardedSteps{0};
   PixelIntegratorType integrator;
   PixelIntegratorError errMax;
+  bool piController{false};
+  bool rmsErrorNorm{false};
+  // normalised error of the previous accepted step, used by the PI controller
+  double previousErrorNorm{1.0};
   double maxTimestep{std::numeric_limits<double>::max()};
+  bool multirate{false};
+  // store concentrations in single precision
+  bool singlePrecision{false};
+  // steps are not shortened to end at output times, instead the output is
+  // interpolated from the step that includes it
+  bool denseOutput{false};
   double nextTimestep{1e-7};
   double epsilon{1e-14};
   bool useTBB{false};
@@ -50,7 +204,6 @@ private:
   std::string currentErrorMessage{};
   QImage currentErrorImage{};
   std::atomic<bool> stopRequested{false};
-  std::size_t nExtraVars{0};
 
 public:
   explicit PixelSim(
@@ -60,16 +213,39 @@ public:
       const std::map<std::string, double, std::less<>> &substitutions = {});
   ~PixelSim() override;
   std::size_t run(double time, double timeout_ms) override;
-  const std::vector<double> &
+  std::vector<double>
   getConcentrations(std::size_t compartmentIndex) const override;
   std::size_t getConcentrationPadding() const override;
-  const std::vector<double> &getDcdt(std::size_t compartmentIndex) const;
+  std::vector<double> getDcdt(std::size_t compartmentIndex) const;
   double getLowerOrderConcentration(std::size_t compartmentIndex,
                                     std::size_t speciesIndex,
                                     std::size_t pixelIndex) const;
+  std::size_t getAcceptedSteps() const;
+  std::size_t getDiscardedSteps() const;
+  // number of tiles of pixels skipped as inactive, see
+  // PixelOptions::activityTolerance
+  std::size_t getFrozenTiles(std::size_t compartmentIndex) const;
+  // true if the compartment is spatially uniform, and integrated as a single
+  // pixel
+  bool getIsUniform(std::size_t compartmentIndex) const;
+  // evaluate dc/dt at the current concentrations, and return the largest
+  // max|dc/dt| / max|c| of any species
+  double getDcdtNorm();
+  // pseudo-transient Newton-Krylov solve for dc/dt = 0 from the current
+  // concentrations, requires SteadyStateOptions::newtonKrylov: returns true
+  // if the dc/dt norm is below tolerance. The concentrations are left
+  // unchanged, the steady state is given by getSteadyStateConcentrations
+  bool solveSteadyState(double tolerance, std::size_t maxIterations);
+  const std::vector<double> &
+  getSteadyStateConcentrations(std::size_t compartmentIndex) const;
+  double getSteadyStateDcdtNorm() const;
   const std::string &errorMessage() const override;
   const QImage &errorImage() const override;
   void setStopRequested(bool stop) override;
+  // only supported with PixelOptions::runtimeParameters, if all substitutions
+  // are runtime parameters
+  bool restart(const std::map<std::string, double, std::less<>>
+                   &substitutions) override;
 };
 
 } // namespace simulate
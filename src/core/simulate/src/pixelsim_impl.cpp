@@ -10,7 +10,10 @@
 #include <array>
 #include <cmath>
 #include <cstdlib>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <type_traits>
 #include <utility>
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
 #include <tbb/global_control.h>
@@ -21,11 +24,69 @@
 
 namespace sme::simulate {
 
+// number of pixels processed together by the reaction & diffusion kernels
+constexpr std::size_t pixelTileSize{256};
+
+// reductions split [0, n) into fixed chunks of this size: the partial result
+// of each chunk is combined in order, so the result of a floating point sum
+// does not depend on the number of threads
+constexpr std::size_t reductionChunkSize{4096};
+
+template <typename T, typename ChunkFunc, typename CombineFunc>
+static T reduceChunks(std::size_t n, T init, const ChunkFunc &chunkFunc,
+                      const CombineFunc &combineFunc) {
+  const std::size_t nChunks{(n + reductionChunkSize - 1) / reductionChunkSize};
+  std::vector<T> partial(nChunks, init);
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
+  for (std::size_t c = 0; c < nChunks; ++c) {
+    partial[c] = chunkFunc(c * reductionChunkSize,
+                           std::min((c + 1) * reductionChunkSize, n));
+  }
+  for (const auto &p : partial) {
+    init = combineFunc(init, p);
+  }
+  return init;
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename T, typename ChunkFunc, typename CombineFunc>
+static T reduceChunks_tbb(std::size_t n, T init, const ChunkFunc &chunkFunc,
+                          const CombineFunc &combineFunc) {
+  const std::size_t nChunks{(n + reductionChunkSize - 1) / reductionChunkSize};
+  std::vector<T> partial(nChunks, init);
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nChunks),
+                    [&](const tbb::blocked_range<std::size_t> &r) {
+                      for (std::size_t c = r.begin(); c < r.end(); ++c) {
+                        partial[c] = chunkFunc(
+                            c * reductionChunkSize,
+                            std::min((c + 1) * reductionChunkSize, n));
+                      }
+                    });
+  for (const auto &p : partial) {
+    init = combineFunc(init, p);
+  }
+  return init;
+}
+#endif
+
+static PixelStepError combineErrors(const PixelStepError &a,
+                                    const PixelStepError &b) {
+  return {{std::max(a.max.abs, b.max.abs), std::max(a.max.rel, b.max.rel)},
+          a.sumSquares + b.sumSquares,
+          a.n + b.n};
+}
+
 ReacEval::ReacEval(
     const model::Model &doc, const std::vector<std::string> &speciesIDs,
     const std::vector<std::string> &reactionIDs, double reactionScaleFactor,
     bool doCSE, unsigned optLevel, bool timeDependent, bool spaceDependent,
-    const std::map<std::string, double, std::less<>> &substitutions) {
+    const std::map<std::string, double, std::less<>> &substitutions,
+    bool singlePrecision, bool jacobian, bool tieredCompilation,
+    const std::vector<std::string> &runtimeParameters)
+    : doCSE{doCSE}, optLevel{optLevel}, singlePrecision{singlePrecision},
+      tieredCompilation{tieredCompilation} {
   // construct reaction expressions and stoich matrix
   PdeScaleFactors pdeScaleFactors;
   pdeScaleFactors.reaction = reactionScaleFactor;
@@ -39,49 +100,163 @@ ReacEval::ReacEval(
     extraVars.push_back(doc.getParameters().getSpatialCoordinates().x.id);
     extraVars.push_back(doc.getParameters().getSpatialCoordinates().y.id);
   }
+  // t,x,y then any runtime parameters are additional inputs after the species
   Pde pde(&doc, speciesIDs, reactionIDs, {}, pdeScaleFactors, extraVars, {},
-          substitutions);
-  // add dt/dt = 1 reaction term, and t,x,y "species"
-  auto sIds{speciesIDs};
-  sIds.insert(sIds.end(), extraVars.cbegin(), extraVars.cend());
-  auto rhs{pde.getRHS()};
-  if (timeDependent) {
-    rhs.push_back("1"); // dt/dt = 1
+          substitutions, runtimeParameters);
+  // use the expressions directly, without converting them to strings
+  if (jacobian) {
+    sym = std::move(pde).takeSymbolicJacobian();
+    // only evaluated for the preconditioner, not worth a batch kernel
+    batch = false;
+    return;
   }
-  if (spaceDependent) {
-    rhs.push_back("0"); // dx/dt = 0
-    rhs.push_back("0"); // dy/dt = 0
+  sym = std::move(pde).takeSymbolicRHS();
+}
+
+void ReacEval::compile() {
+  if (!sym.isValid()) {
+    return;
+  }
+  if (tieredCompilation) {
+    // interpret the expressions while they are compiled in the background
+    sym.compileTiered(doCSE, optLevel, singlePrecision, batch);
+  } else if (singlePrecision) {
+    sym.compileSinglePrecision(doCSE, optLevel, batch);
+  } else {
+    sym.compile(doCSE, optLevel, batch);
   }
-  // compile all expressions with symengine
-  sym = utils::Symbolic(rhs, sIds, {}, {}, true, doCSE, optLevel);
 }
 
 void ReacEval::evaluate(double *output, const double *input) const {
   sym.eval(output, input);
 }
 
-void SimCompartment::spatiallyAverageDcdt() {
+void ReacEval::evaluate(double *output, const double *input, std::size_t n,
+                        std::size_t outputStride,
+                        std::size_t inputStride) const {
+  sym.eval(output, input, n, outputStride, inputStride);
+}
+
+void ReacEval::evaluate(float *output, const float *input) const {
+  sym.eval(output, input);
+}
+
+void ReacEval::evaluate(float *output, const float *input, std::size_t n,
+                        std::size_t outputStride,
+                        std::size_t inputStride) const {
+  sym.eval(output, input, n, outputStride, inputStride);
+}
+
+bool ReacEval::updateTieredCompilation() {
+  return sym.updateTieredCompilation();
+}
+
+template <typename Real> void SimCompartment<Real>::clearDcdt() {
+  std::fill(dcdt.begin(), dcdt.end(), Real{0});
+}
+
+template <typename Real>
+void SimCompartment<Real>::storeMembraneFlux() { membraneFlux = dcdt; }
+
+template <typename Real> void SimCompartment<Real>::addMembraneFlux() {
+  if (uniform) {
+    // membranes add their spatially averaged flux to the single state pixel
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      dcdt[index(0, is)] += membraneFlux[index(0, is)];
+    }
+    return;
+  }
+  for (std::size_t ix : membranePixels) {
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      std::size_t i{index(ix, is)};
+      dcdt[i] += membraneFlux[i];
+    }
+  }
+}
+
+template <typename Real>
+double SimCompartment<Real>::sumDcdt(std::size_t is, std::size_t begin,
+                                     std::size_t end) const {
+  double sum{0};
+  for (std::size_t ix = begin; ix < end; ++ix) {
+    sum += dcdt[index(ix, is)];
+  }
+  return sum;
+}
+
+template <typename Real>
+void SimCompartment<Real>::setDcdt(std::size_t is, double value,
+                                   std::size_t begin, std::size_t end) {
+  const auto v{static_cast<Real>(value)};
+  for (std::size_t ix = begin; ix < end; ++ix) {
+    dcdt[index(ix, is)] = v;
+  }
+}
+
+template <typename Real> void SimCompartment<Real>::spatiallyAverageDcdt() {
+  if (uniform) {
+    return;
+  }
   // for any non-spatial species: spatially average dc/dt:
   // roughly equivalent to infinite rate of diffusion
   for (std::size_t is : nonSpatialSpeciesIndices) {
-    double av = 0;
-    for (std::size_t ix = 0; ix < nPixels; ++ix) {
-      av += dcdt[ix * nSpecies + is];
-    }
+    double av{reduceChunks(
+        nPixels, 0.0,
+        [this, is](std::size_t begin, std::size_t end) {
+          return sumDcdt(is, begin, end);
+        },
+        std::plus<double>())};
     av /= static_cast<double>(nPixels);
+    const auto avReal{static_cast<Real>(av)};
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
     for (std::size_t ix = 0; ix < nPixels; ++ix) {
-      dcdt[ix * nSpecies + is] = av;
+      dcdt[index(ix, is)] = avReal;
     }
   }
 }
 
-SimCompartment::SimCompartment(
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real> void SimCompartment<Real>::spatiallyAverageDcdt_tbb() {
+  if (uniform) {
+    return;
+  }
+  for (std::size_t is : nonSpatialSpeciesIndices) {
+    double av{reduceChunks_tbb(
+        nPixels, 0.0,
+        [this, is](std::size_t begin, std::size_t end) {
+          return sumDcdt(is, begin, end);
+        },
+        std::plus<double>())};
+    av /= static_cast<double>(nPixels);
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nPixels),
+                      [this, is, av](const tbb::blocked_range<std::size_t> &r) {
+                        setDcdt(is, av, r.begin(), r.end());
+                      });
+  }
+}
+#endif
+
+template <typename Real>
+SimCompartment<Real>::SimCompartment(
     const model::Model &doc, const geometry::Compartment *compartment,
-    std::vector<std::string> sIds, bool doCSE, unsigned optLevel,
+    std::vector<std::string> sIds, const PixelOptions &options,
     bool timeDependent, bool spaceDependent,
-    const std::map<std::string, double, std::less<>> &substitutions)
+    const std::map<std::string, double, std::less<>> &substitutions,
+    bool reactionJacobian,
+    const std::vector<std::pair<std::string, double>> &runtimeParameters)
     : comp{compartment}, nPixels{compartment->nPixels()}, nSpecies{sIds.size()},
-      compartmentId{compartment->getId()}, speciesIds{std::move(sIds)} {
+      nStatePixels{compartment->nPixels()},
+      compartmentId{compartment->getId()}, speciesIds{std::move(sIds)},
+      timeDependent{timeDependent}, spaceDependent{spaceDependent},
+      speciesMajor{options.speciesMajorLayout} {
+  // an absolute error of max() means no absolute error tolerance
+  if (options.maxErr.abs < std::numeric_limits<double>::max()) {
+    errAbs = options.maxErr.abs;
+  }
+  errRel = options.maxErr.rel;
+  uniformTolerance = options.uniformTolerance;
   // get species in compartment
   speciesNames.reserve(nSpecies);
   SPDLOG_DEBUG("compartment: {}", compartmentId);
@@ -89,11 +264,10 @@ SimCompartment::SimCompartment(
   const double pixelWidth{doc.getGeometry().getPixelWidth()};
   for (const auto &s : speciesIds) {
     const auto *field = doc.getSpecies().getField(s.c_str());
-    diffConstants.push_back(field->getDiffusionConstant() / pixelWidth /
-                            pixelWidth);
+    const double d{field->getDiffusionConstant() / pixelWidth / pixelWidth};
+    diffConstants.push_back(static_cast<Real>(d));
     // forwards euler stability bound: dt < a^2/4D
-    maxStableTimestep =
-        std::min(maxStableTimestep, 1.0 / (4.0 * diffConstants.back()));
+    maxStableTimestep = std::min(maxStableTimestep, 1.0 / (4.0 * d));
     fields.push_back(field);
     speciesNames.push_back(doc.getSpecies().getName(s.c_str()).toStdString());
     if (!field->getIsSpatial()) {
@@ -101,7 +275,13 @@ SimCompartment::SimCompartment(
     }
     SPDLOG_DEBUG("  - adding species: {}, diff constant {}", s,
                  diffConstants.back());
+    if (d > 0) {
+      diffusingSpeciesIndices.push_back(diffConstants.size() - 1);
+      diffusingSpeciesConstants.push_back(diffConstants.back());
+    }
   }
+  SPDLOG_DEBUG("  - {} of {} species diffuse", diffusingSpeciesIndices.size(),
+               nSpecies);
   // get reactions in compartment
   std::vector<std::string> reactionIDs;
   if (auto reacsInCompartment =
@@ -109,73 +289,563 @@ SimCompartment::SimCompartment(
       !reacsInCompartment.isEmpty()) {
     reactionIDs = utils::toStdString(reacsInCompartment);
   }
-  reacEval = ReacEval(doc, speciesIds, reactionIDs, 1.0, doCSE, optLevel,
-                      timeDependent, spaceDependent, substitutions);
+  std::vector<std::string> parameterIds;
+  for (const auto &[id, value] : runtimeParameters) {
+    SPDLOG_DEBUG("  - runtime parameter {} = {}", id, value);
+    parameterIds.push_back(id);
+    parameterValues.push_back(value);
+  }
+  reacEval = ReacEval(doc, speciesIds, reactionIDs, 1.0, options.doCSE,
+                      options.optLevel, timeDependent, spaceDependent,
+                      substitutions, std::is_same_v<Real, float>, false,
+                      options.tieredCompilation, parameterIds);
+  if (reactionJacobian) {
+    SPDLOG_DEBUG("  - compiling reaction Jacobian");
+    jacEval = ReacEval(doc, speciesIds, reactionIDs, 1.0, options.doCSE,
+                       options.optLevel, timeDependent, spaceDependent,
+                       substitutions, false, true, false, parameterIds);
+    hasJacobian = true;
+  }
   if (timeDependent) {
-    speciesIds.push_back("time");
-    diffConstants.push_back(0);
-    ++nSpecies;
+    ++nExtraVars;
   }
   if (spaceDependent) {
-    speciesIds.push_back(doc.getParameters().getSpatialCoordinates().x.id);
-    diffConstants.push_back(0);
-    speciesIds.push_back(doc.getParameters().getSpatialCoordinates().y.id);
-    diffConstants.push_back(0);
-    nSpecies += 2;
+    nExtraVars += 2;
+  }
+  nExtraVars += parameterValues.size();
+  if (speciesMajor) {
+    SPDLOG_DEBUG("  - using species-major concentration layout");
+  }
+  setStrides();
+  neighbours = compartment->getNeighbourIndices().data();
+  if (options.mortonOrdering) {
+    SPDLOG_DEBUG("  - using Morton pixel ordering");
+    pixelOrder = compartment->getMortonOrdering();
+    pixelOrderInverse.resize(nPixels);
+    for (std::size_t ix = 0; ix < nPixels; ++ix) {
+      pixelOrderInverse[pixelOrder[ix]] = ix;
+    }
+    const auto &nn{compartment->getNeighbourIndices()};
+    reorderedNeighbours.reserve(nn.size());
+    for (std::size_t ix : pixelOrder) {
+      for (std::size_t i = 4 * ix; i < 4 * ix + 4; ++i) {
+        reorderedNeighbours.push_back(
+            static_cast<std::uint32_t>(pixelOrderInverse[nn[i]]));
+      }
+    }
+    neighbours = reorderedNeighbours.data();
+  }
+  findStencilRuns();
+  // initial concentrations with ordering: compartment pixel, species
+  std::vector<double> initialConc(nSpecies * nPixels);
+  for (std::size_t iCompPixel = 0; iCompPixel < nPixels; ++iCompPixel) {
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      initialConc[iCompPixel * nSpecies + is] =
+          fields[is]->getConcentration()[iCompPixel];
+    }
+  }
+  // without a spatial source a uniform state stays uniform: membranes are a
+  // spatial source, and revoke this when they are added, unless all species
+  // are non-spatial
+  canBeUniform = !spaceDependent && nPixels > 1;
+  if (canBeUniform && isUniformConcentration(initialConc)) {
+    setUniform(true);
+  }
+  // reactions that depend on time or non-spatial species can change dcdt
+  // everywhere, and IMEX diffusion is global, so are not tracked. Set up
+  // even if the state is currently uniform: membranes or events can make it
+  // spatial, and tracking is skipped while it is uniform
+  if (options.activityTolerance > 0 && !timeDependent &&
+      nonSpatialSpeciesIndices.empty() &&
+      options.integrator != PixelIntegratorType::IMEX) {
+    SPDLOG_DEBUG("  - skipping inactive tiles, tolerance {}",
+                 options.activityTolerance);
+    activityTolerance = options.activityTolerance;
+    const std::size_t nTiles{(nPixels + pixelTileSize - 1) / pixelTileSize};
+    tileFrozen.assign(nTiles, 0);
+    tileCanFreeze.assign(nTiles, 1);
+    tileHaloConc.resize(nTiles);
+    findTileHalos();
   }
   // setup concentrations vector with initial values
-  conc.resize(nSpecies * nPixels);
-  dcdt.resize(conc.size(), 0.0);
-  auto origin{doc.getGeometry().getPhysicalOrigin()};
-  auto concIter = conc.begin();
-  for (std::size_t ix = 0; ix < compartment->nPixels(); ++ix) {
-    for (const auto *field : fields) {
-      *concIter = field->getConcentration()[ix];
-      ++concIter;
-    }
-    if (timeDependent) {
-      *concIter = 0; // t
-      ++concIter;
-    }
-    if (spaceDependent) {
-      auto pixel{compartment->getPixel(ix)};
+  conc.resize(nSpecies * nStatePixels);
+  dcdt.resize(conc.size(), Real{0});
+  setConcentrations(initialConc);
+  if (spaceDependent) {
+    auto origin{doc.getGeometry().getPhysicalOrigin()};
+    pixelCoordinates.reserve(2 * nPixels);
+    for (std::size_t ix = 0; ix < nPixels; ++ix) {
+      auto pixel{compartment->getPixel(compartmentPixel(ix))};
       // pixels have y=0 in top-left, convert to bottom-left:
       pixel.ry() = compartment->getCompartmentImage().height() - 1 - pixel.y();
-      *concIter = origin.x() + static_cast<double>(pixel.x()) * pixelWidth; // x
-      ++concIter;
-      *concIter = origin.y() + static_cast<double>(pixel.y()) * pixelWidth; // y
-      ++concIter;
+      pixelCoordinates.push_back(origin.x() +
+                                 static_cast<double>(pixel.x()) * pixelWidth);
+      pixelCoordinates.push_back(origin.y() +
+                                 static_cast<double>(pixel.y()) * pixelWidth);
+    }
+  }
+}
+
+template <typename Real> void SimCompartment<Real>::setStrides() {
+  if (speciesMajor) {
+    pixelStride = 1;
+    speciesStride = nStatePixels;
+  } else {
+    pixelStride = nSpecies;
+    speciesStride = 1;
+  }
+}
+
+template <typename Real>
+bool SimCompartment<Real>::isUniformConcentration(
+    const std::vector<double> &concentrations) const {
+  if (concentrations.size() != nSpecies * nPixels) {
+    return false;
+  }
+  for (std::size_t i = nSpecies; i < concentrations.size(); ++i) {
+    if (concentrations[i] != concentrations[i % nSpecies]) {
+      return false;
     }
   }
-  assert(concIter == conc.end());
+  return true;
 }
 
-void SimCompartment::evaluateDiffusionOperator(std::size_t begin,
-                                               std::size_t end) {
+template <typename Real> bool SimCompartment<Real>::collapseIfUniform() {
+  if (!canBeUniform || uniform) {
+    return false;
+  }
+  const std::size_t n{nSpecies * nPixels};
+  const auto c{toPixelMajor(conc)};
+  const auto d{toPixelMajor(dcdt)};
+  std::vector<double> cAv(nSpecies, 0.0);
+  std::vector<double> dAv(nSpecies, 0.0);
+  if (uniformTolerance == 0) {
+    // only exactly uniform: keep the common value rather than an average of
+    // it, which can differ from it by rounding errors
+    if (!isUniformConcentration(c)) {
+      return false;
+    }
+    std::copy_n(c.cbegin(), nSpecies, cAv.begin());
+  } else {
+    std::vector<double> cMax(nSpecies, 0.0);
+    for (std::size_t i = 0; i < n; ++i) {
+      cAv[i % nSpecies] += c[i];
+      cMax[i % nSpecies] = std::max(cMax[i % nSpecies], std::abs(c[i]));
+    }
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      cAv[is] /= static_cast<double>(nPixels);
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      const double tolerance{uniformTolerance * cMax[i % nSpecies]};
+      // a nan concentration is never uniform
+      if (!(std::abs(c[i] - cAv[i % nSpecies]) <= tolerance)) {
+        return false;
+      }
+    }
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    dAv[i % nSpecies] += d[i];
+  }
+  for (std::size_t is = 0; is < nSpecies; ++is) {
+    dAv[is] /= static_cast<double>(nPixels);
+  }
+  setUniform(true);
+  for (std::size_t is = 0; is < nSpecies; ++is) {
+    conc[index(0, is)] = static_cast<Real>(cAv[is]);
+    dcdt[index(0, is)] = static_cast<Real>(dAv[is]);
+  }
+  return true;
+}
+
+template <typename Real>
+void SimCompartment<Real>::setUniform(bool uniformState) {
+  if (uniformState == uniform) {
+    return;
+  }
+  uniform = uniformState;
+  nStatePixels = uniform ? 1 : nPixels;
+  setStrides();
+  conc.assign(nSpecies * nStatePixels, Real{0});
+  dcdt.assign(conc.size(), Real{0});
+  // integrator work arrays are resized at the start of the next step
+  s2.clear();
+  s3.clear();
+  concNext.clear();
+  dcdt0.clear();
+  membraneFlux.clear();
+  denseOutputActive = false;
+  denseC0.clear();
+  denseF0.clear();
+  denseF1.clear();
+  denseConc.clear();
+  // a uniform state has no inactive tiles
+  std::fill(tileFrozen.begin(), tileFrozen.end(), 0);
+  nFrozenTiles = 0;
+  SPDLOG_DEBUG("{}: {} pixels integrated as {}", compartmentId, nPixels,
+               uniform ? "a single uniform pixel" : "separate pixels");
+}
+
+template <typename Real>
+std::vector<double>
+SimCompartment<Real>::toPixelMajor(const std::vector<Real> &src) const {
+  std::vector<double> dst(nSpecies * nPixels);
+  for (std::size_t ix = 0; ix < nPixels; ++ix) {
+    std::size_t iCompPixel{compartmentPixel(ix)};
+    // a uniform state is broadcast to all pixels
+    std::size_t iStatePixel{uniform ? 0 : ix};
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      dst[iCompPixel * nSpecies + is] = src[index(iStatePixel, is)];
+    }
+  }
+  return dst;
+}
+
+template <typename Real> void SimCompartment<Real>::findStencilRuns() {
+  // shorter runs of interior pixels are not worth treating separately
+  constexpr std::size_t minStructuredRunLength{8};
+  auto interiorOffsets{[this](std::size_t i)
+                           -> std::optional<std::pair<std::size_t, std::size_t>> {
+    if (up_y(i) == i + 1 && dn_y(i) + 1 == i && up_x(i) > i && dn_x(i) < i) {
+      return std::pair{up_x(i) - i, i - dn_x(i)};
+    }
+    return {};
+  }};
+  stencilRuns.clear();
+  std::size_t begin{0};
+  while (begin < nPixels) {
+    auto offsets{interiorOffsets(begin)};
+    std::size_t end{begin + 1};
+    while (end < nPixels && interiorOffsets(end) == offsets) {
+      ++end;
+    }
+    bool structured{offsets.has_value() &&
+                    end - begin >= minStructuredRunLength};
+    if (!structured && !stencilRuns.empty() && !stencilRuns.back().structured) {
+      stencilRuns.back().end = end;
+    } else if (structured) {
+      stencilRuns.push_back({begin, end, offsets->first, offsets->second, true});
+    } else {
+      stencilRuns.push_back({begin, end, 0, 0, false});
+    }
+    begin = end;
+  }
+  std::size_t nStructured{0};
+  for (const auto &run : stencilRuns) {
+    if (run.structured) {
+      nStructured += run.end - run.begin;
+    }
+  }
+  SPDLOG_DEBUG("  - {}/{} pixels in {} stencil runs use direct offsets",
+               nStructured, nPixels, stencilRuns.size());
+}
+
+template <typename Real> void SimCompartment<Real>::findTileHalos() {
+  tileHalo.resize(tileFrozen.size());
+  for (std::size_t tile = 0; tile < tileHalo.size(); ++tile) {
+    const std::size_t begin{tile * pixelTileSize};
+    const std::size_t end{std::min(begin + pixelTileSize, nPixels)};
+    auto &halo{tileHalo[tile]};
+    for (std::size_t i = begin; i < end; ++i) {
+      for (std::size_t n : {up_x(i), dn_x(i), up_y(i), dn_y(i)}) {
+        if (n < begin || n >= end) {
+          halo.push_back(n);
+        }
+      }
+    }
+    std::sort(halo.begin(), halo.end());
+    halo.erase(std::unique(halo.begin(), halo.end()), halo.end());
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::updateTileActivity(std::size_t tile) {
+  const std::size_t begin{tile * pixelTileSize};
+  const std::size_t end{std::min(begin + pixelTileSize, nPixels)};
+  const auto &halo{tileHalo[tile]};
+  auto &haloConc{tileHaloConc[tile]};
+  if (tileFrozen[tile] != 0) {
+    // wake if a change in a neighbour would change dcdt by more than the
+    // tolerance
+    for (std::size_t j = 0; j < halo.size(); ++j) {
+      for (std::size_t is = 0; is < nSpecies; ++is) {
+        double dc{static_cast<double>(conc[index(halo[j], is)]) -
+                  static_cast<double>(haloConc[j * nSpecies + is])};
+        if (diffConstants[is] * std::abs(dc) > activityTolerance) {
+          tileFrozen[tile] = 0;
+          return;
+        }
+      }
+    }
+    return;
+  }
+  if (tileCanFreeze[tile] == 0) {
+    return;
+  }
+  for (std::size_t ix = begin; ix < end; ++ix) {
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      if (std::abs(dcdt[index(ix, is)]) >= activityTolerance) {
+        return;
+      }
+    }
+  }
+  tileFrozen[tile] = 1;
+  for (std::size_t ix = begin; ix < end; ++ix) {
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      dcdt[index(ix, is)] = 0;
+    }
+  }
+  haloConc.resize(halo.size() * nSpecies);
+  for (std::size_t j = 0; j < halo.size(); ++j) {
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      haloConc[j * nSpecies + is] = conc[index(halo[j], is)];
+    }
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::updateActivity(std::size_t beginTile,
+                                          std::size_t endTile) {
 #ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
 #pragma omp parallel for
 #endif
+  for (std::size_t tile = beginTile; tile < endTile; ++tile) {
+    updateTileActivity(tile);
+  }
+}
+
+template <typename Real> void SimCompartment<Real>::updateActivity() {
+  if (activityTolerance <= 0 || uniform) {
+    return;
+  }
+  updateActivity(0, tileFrozen.size());
+  nFrozenTiles = static_cast<std::size_t>(
+      std::count(tileFrozen.cbegin(), tileFrozen.cend(), 1));
+  SPDLOG_TRACE("{}: {}/{} tiles frozen", compartmentId, nFrozenTiles,
+               tileFrozen.size());
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real> void SimCompartment<Real>::updateActivity_tbb() {
+  if (activityTolerance <= 0 || uniform) {
+    return;
+  }
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, tileFrozen.size()),
+                    [this](const tbb::blocked_range<std::size_t> &r) {
+                      updateActivity(r.begin(), r.end());
+                    });
+  nFrozenTiles = static_cast<std::size_t>(
+      std::count(tileFrozen.cbegin(), tileFrozen.cend(), 1));
+  SPDLOG_TRACE("{}: {}/{} tiles frozen", compartmentId, nFrozenTiles,
+               tileFrozen.size());
+}
+#endif
+
+template <typename Real>
+template <typename Func>
+void SimCompartment<Real>::forEachActiveRange(std::size_t begin,
+                                              std::size_t end,
+                                              const Func &func) const {
+  if (nFrozenTiles == 0) {
+    func(begin, end);
+    return;
+  }
+  while (begin < end) {
+    const std::size_t tile{begin / pixelTileSize};
+    const std::size_t e{std::min(end, (tile + 1) * pixelTileSize)};
+    if (tileFrozen[tile] == 0) {
+      func(begin, e);
+    }
+    begin = e;
+  }
+}
+
+template <typename Real>
+template <typename Func>
+void SimCompartment<Real>::forEachInteriorRange(std::size_t begin,
+                                                std::size_t end,
+                                                const Func &func) const {
+  forEachActiveRange(begin, end, [this, &func](std::size_t b, std::size_t e) {
+    auto m{std::lower_bound(membranePixels.cbegin(), membranePixels.cend(),
+                            b)};
+    while (b < e) {
+      std::size_t mEnd{e};
+      if (m != membranePixels.cend() && *m < e) {
+        mEnd = *m;
+        ++m;
+      }
+      if (b < mEnd) {
+        func(b, mEnd);
+      }
+      b = mEnd + 1;
+    }
+  });
+}
+
+// the species used by a diffusion kernel: for a compile-time number N of
+// species the species loop is fully unrolled, with the indices & diffusion
+// constants held in local arrays
+template <typename Real, std::size_t N> struct DiffusingSpecies {
+  std::array<std::size_t, N> index{};
+  std::array<Real, N> d{};
+  DiffusingSpecies(const std::vector<std::size_t> &indices,
+                   const std::vector<Real> &constants) {
+    std::copy_n(indices.cbegin(), N, index.begin());
+    std::copy_n(constants.cbegin(), N, d.begin());
+  }
+  static constexpr std::size_t size() { return N; }
+};
+
+// any number of species, given at runtime
+template <typename Real> struct DiffusingSpecies<Real, 0> {
+  const std::size_t *index;
+  const Real *d;
+  std::size_t n;
+  DiffusingSpecies(const std::vector<std::size_t> &indices,
+                   const std::vector<Real> &constants)
+      : index{indices.data()}, d{constants.data()}, n{indices.size()} {}
+  std::size_t size() const { return n; }
+};
+
+template <typename Real>
+void SimCompartment<Real>::diffusionKernel(std::size_t begin,
+                                           std::size_t end) {
+  const auto &i{diffusingSpeciesIndices};
+  const auto &d{diffusingSpeciesConstants};
+  switch (i.size()) {
+  case 0:
+    return;
+  case 1:
+    diffusionKernel(DiffusingSpecies<Real, 1>(i, d), begin, end);
+    return;
+  case 2:
+    diffusionKernel(DiffusingSpecies<Real, 2>(i, d), begin, end);
+    return;
+  case 3:
+    diffusionKernel(DiffusingSpecies<Real, 3>(i, d), begin, end);
+    return;
+  case 4:
+    diffusionKernel(DiffusingSpecies<Real, 4>(i, d), begin, end);
+    return;
+  default:
+    diffusionKernel(DiffusingSpecies<Real, 0>(i, d), begin, end);
+  }
+}
+
+template <typename Real>
+template <typename Species>
+void SimCompartment<Real>::diffusionKernel(const Species &species,
+                                           std::size_t begin,
+                                           std::size_t end) {
+  // first run that ends after `begin`
+  auto run{std::upper_bound(
+      stencilRuns.cbegin(), stencilRuns.cend(), begin,
+      [](std::size_t i, const StencilRun &r) { return i < r.end; })};
+  for (; run != stencilRuns.cend() && run->begin < end; ++run) {
+    std::size_t b{std::max(begin, run->begin)};
+    std::size_t e{std::min(end, run->end)};
+    if (run->structured) {
+      diffusionKernelStructured(species, b, e, run->upOffset, run->dnOffset);
+    } else {
+      diffusionKernelGather(species, b, e);
+    }
+  }
+}
+
+template <typename Real>
+template <typename Species>
+void SimCompartment<Real>::diffusionKernelStructured(const Species &species,
+                                                     std::size_t begin,
+                                                     std::size_t end,
+                                                     std::size_t upOffset,
+                                                     std::size_t dnOffset) {
+  if (speciesMajor) {
+    for (std::size_t k = 0; k < species.size(); ++k) {
+      const Real d{species.d[k]};
+      const Real *c{conc.data() + species.index[k] * nPixels};
+      Real *dc{dcdt.data() + species.index[k] * nPixels};
+      for (std::size_t i = begin; i < end; ++i) {
+        dc[i] += d * (c[i + upOffset] + c[i - dnOffset] + c[i + 1] + c[i - 1] -
+                      4 * c[i]);
+      }
+    }
+    return;
+  }
+  const std::size_t up{upOffset * nSpecies};
+  const std::size_t dn{dnOffset * nSpecies};
+  for (std::size_t ix = begin * nSpecies; ix < end * nSpecies;
+       ix += nSpecies) {
+    for (std::size_t k = 0; k < species.size(); ++k) {
+      std::size_t i{ix + species.index[k]};
+      dcdt[i] += species.d[k] * (conc[i + up] + conc[i - dn] +
+                                 conc[i + nSpecies] + conc[i - nSpecies] -
+                                 4 * conc[i]);
+    }
+  }
+}
+
+template <typename Real>
+template <typename Species>
+void SimCompartment<Real>::diffusionKernelGather(const Species &species,
+                                                 std::size_t begin,
+                                                 std::size_t end) {
+  if (speciesMajor) {
+    // one contiguous array per species: inner loop over pixels
+    for (std::size_t k = 0; k < species.size(); ++k) {
+      const Real d{species.d[k]};
+      const Real *c{conc.data() + species.index[k] * nPixels};
+      Real *dc{dcdt.data() + species.index[k] * nPixels};
+      for (std::size_t i = begin; i < end; ++i) {
+        dc[i] += d * (c[up_x(i)] + c[dn_x(i)] + c[up_y(i)] + c[dn_y(i)] -
+                      4 * c[i]);
+      }
+    }
+    return;
+  }
   for (std::size_t i = begin; i < end; ++i) {
     std::size_t ix = i * nSpecies;
-    std::size_t ix_upx = comp->up_x(i) * nSpecies;
-    std::size_t ix_dnx = comp->dn_x(i) * nSpecies;
-    std::size_t ix_upy = comp->up_y(i) * nSpecies;
-    std::size_t ix_dny = comp->dn_y(i) * nSpecies;
-    for (std::size_t is = 0; is < nSpecies; ++is) {
+    std::size_t ix_upx = up_x(i) * nSpecies;
+    std::size_t ix_dnx = dn_x(i) * nSpecies;
+    std::size_t ix_upy = up_y(i) * nSpecies;
+    std::size_t ix_dny = dn_y(i) * nSpecies;
+    for (std::size_t k = 0; k < species.size(); ++k) {
+      const std::size_t is{species.index[k]};
       dcdt[ix + is] +=
-          diffConstants[is] *
+          species.d[k] *
           (conc[ix_upx + is] + conc[ix_dnx + is] + conc[ix_upy + is] +
-           conc[ix_dny + is] - 4.0 * conc[ix + is]);
+           conc[ix_dny + is] - 4 * conc[ix + is]);
     }
   }
 }
 
-void SimCompartment::evaluateDiffusionOperator() {
+template <typename Real>
+void SimCompartment<Real>::evaluateDiffusionOperator(std::size_t begin,
+                                                     std::size_t end) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
+  for (std::size_t t = begin; t < end; t += pixelTileSize) {
+    forEachActiveRange(t, std::min(t + pixelTileSize, end),
+                       [this](std::size_t b, std::size_t e) {
+                         diffusionKernel(b, e);
+                       });
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::evaluateDiffusionOperator() {
+  // diffusion of a uniform state is zero
+  if (uniform || diffusingSpeciesIndices.empty()) {
+    return;
+  }
   evaluateDiffusionOperator(0, nPixels);
 }
 
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-void SimCompartment::evaluateDiffusionOperator_tbb() {
+template <typename Real>
+void SimCompartment<Real>::evaluateDiffusionOperator_tbb() {
+  if (uniform || diffusingSpeciesIndices.empty()) {
+    return;
+  }
   tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nPixels),
                     [this](const tbb::blocked_range<std::size_t> &r) {
                       evaluateDiffusionOperator(r.begin(), r.end());
@@ -183,42 +853,152 @@ void SimCompartment::evaluateDiffusionOperator_tbb() {
 }
 #endif
 
-void SimCompartment::evaluateReactions(std::size_t begin, std::size_t end) {
+template <typename Real>
+template <typename T>
+void SimCompartment<Real>::setExtraInputs(std::size_t ix, T *extra) const {
+  if (timeDependent) {
+    *extra++ = static_cast<T>(time);
+  }
+  if (spaceDependent) {
+    *extra++ = static_cast<T>(pixelCoordinates[2 * ix]);
+    *extra++ = static_cast<T>(pixelCoordinates[2 * ix + 1]);
+  }
+  for (double value : parameterValues) {
+    *extra++ = static_cast<T>(value);
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::reactionKernel(std::size_t begin, std::size_t end) {
+  if (!speciesMajor && nExtraVars == 0) {
+    reacEval.evaluate(dcdt.data() + begin * nSpecies,
+                      conc.data() + begin * nSpecies, end - begin, nSpecies,
+                      nSpecies);
+    return;
+  }
+  // copy the tile of pixels to pixel-major ordering, followed by any t,x,y
+  // inputs for each pixel
+  thread_local std::vector<Real> cTile;
+  thread_local std::vector<Real> dTile;
+  const std::size_t n{end - begin};
+  const std::size_t nInputs{nSpecies + nExtraVars};
+  cTile.resize(n * nInputs);
+  for (std::size_t is = 0; is < nSpecies; ++is) {
+    for (std::size_t j = 0; j < n; ++j) {
+      cTile[j * nInputs + is] = conc[index(begin + j, is)];
+    }
+  }
+  for (std::size_t j = 0; j < n; ++j) {
+    setExtraInputs(begin + j, cTile.data() + j * nInputs + nSpecies);
+  }
+  if (!speciesMajor) {
+    reacEval.evaluate(dcdt.data() + begin * nSpecies, cTile.data(), n,
+                      nSpecies, nInputs);
+    return;
+  }
+  // evaluate reactions, then transpose the results back
+  dTile.resize(n * nSpecies);
+  reacEval.evaluate(dTile.data(), cTile.data(), n, nSpecies, nInputs);
+  for (std::size_t is = 0; is < nSpecies; ++is) {
+    Real *dc{dcdt.data() + index(begin, is)};
+    for (std::size_t j = 0; j < n; ++j) {
+      dc[j] = dTile[j * nSpecies + is];
+    }
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::evaluateReactions(std::size_t begin,
+                                             std::size_t end) {
 #ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
 #pragma omp parallel for
 #endif
-  for (std::size_t i = begin; i < end; ++i) {
-    reacEval.evaluate(dcdt.data() + i * nSpecies, conc.data() + i * nSpecies);
+  for (std::size_t t = begin; t < end; t += pixelTileSize) {
+    forEachActiveRange(t, std::min(t + pixelTileSize, end),
+                       [this](std::size_t b, std::size_t e) {
+                         reactionKernel(b, e);
+                       });
   }
 }
 
-void SimCompartment::evaluateReactions() { evaluateReactions(0, nPixels); }
+template <typename Real> void SimCompartment<Real>::evaluateReactions() {
+  evaluateReactions(0, nStatePixels);
+}
 
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-void SimCompartment::evaluateReactions_tbb() {
-  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nPixels),
+template <typename Real> void SimCompartment<Real>::evaluateReactions_tbb() {
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nStatePixels),
                     [this](const tbb::blocked_range<std::size_t> &r) {
                       evaluateReactions(r.begin(), r.end());
                     });
 }
 #endif
 
-void SimCompartment::doForwardsEulerTimestep(double dt, std::size_t begin,
-                                             std::size_t end) {
+template <typename Real>
+void SimCompartment<Real>::evaluateMembranePixels(bool includeDiffusion) {
+  if (uniform) {
+    if (!membranePixels.empty()) {
+      evaluateReactions(0, nStatePixels);
+    }
+    return;
+  }
+  // each run of consecutive membrane pixels
+  auto m{membranePixels.cbegin()};
+  while (m != membranePixels.cend()) {
+    const std::size_t b{*m};
+    std::size_t e{b + 1};
+    while (++m != membranePixels.cend() && *m == e) {
+      ++e;
+    }
+    reactionKernel(b, e);
+    if (includeDiffusion) {
+      diffusionKernel(b, e);
+    }
+  }
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real>
+void SimCompartment<Real>::evaluateInteriorPixels_tbb(bool includeDiffusion) {
+  if (uniform && !membranePixels.empty()) {
+    return;
+  }
+  const bool diffusion{includeDiffusion && !uniform};
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, nStatePixels, pixelTileSize),
+      [this, diffusion](const tbb::blocked_range<std::size_t> &r) {
+        forEachInteriorRange(r.begin(), r.end(),
+                             [this, diffusion](std::size_t b, std::size_t e) {
+                               reactionKernel(b, e);
+                               if (diffusion) {
+                                 diffusionKernel(b, e);
+                               }
+                             });
+      });
+}
+#endif
+
+template <typename Real>
+void SimCompartment<Real>::doForwardsEulerTimestep(double dt,
+                                                   std::size_t begin,
+                                                   std::size_t end) {
+  const auto h{static_cast<Real>(dt)};
 #ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
 #pragma omp parallel for
 #endif
   for (std::size_t i = begin; i < end; ++i) {
-    conc[i] += dt * dcdt[i];
+    conc[i] += h * dcdt[i];
   }
 }
 
-void SimCompartment::doForwardsEulerTimestep(double dt) {
+template <typename Real>
+void SimCompartment<Real>::doForwardsEulerTimestep(double dt) {
   doForwardsEulerTimestep(dt, 0, conc.size());
 }
 
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-void SimCompartment::doForwardsEulerTimestep_tbb(double dt) {
+template <typename Real>
+void SimCompartment<Real>::doForwardsEulerTimestep_tbb(double dt) {
   tbb::parallel_for(tbb::blocked_range<std::size_t>(0, conc.size()),
                     [this, dt](const tbb::blocked_range<std::size_t> &r) {
                       doForwardsEulerTimestep(dt, r.begin(), r.end());
@@ -226,30 +1006,36 @@ void SimCompartment::doForwardsEulerTimestep_tbb(double dt) {
 }
 #endif
 
-void SimCompartment::doRKInit() {
-  s2.assign(conc.size(), 0.0);
+template <typename Real> void SimCompartment<Real>::doRKInit() {
+  s2.assign(conc.size(), Real{0});
   s3 = conc;
+  if (canFuseRKSubstep()) {
+    concNext.resize(conc.size());
+  }
 }
 
-void SimCompartment::doRK212Substep1(double dt, std::size_t begin,
-                                     std::size_t end) {
+template <typename Real>
+void SimCompartment<Real>::doRK212Substep1(double dt, std::size_t begin,
+                                           std::size_t end) {
+  const auto h{static_cast<Real>(dt)};
 #ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
 #pragma omp parallel for
 #endif
   for (std::size_t i = begin; i < end; ++i) {
     s3[i] = conc[i];
-    conc[i] += dt * dcdt[i];
+    conc[i] += h * dcdt[i];
   }
 }
 
-void SimCompartment::doRK212Substep1(double dt) {
+template <typename Real> void SimCompartment<Real>::doRK212Substep1(double dt) {
   s2.resize(conc.size());
   s3.resize(conc.size());
   doRK212Substep1(dt, 0, conc.size());
 }
 
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-void SimCompartment::doRK212Substep1_tbb(double dt) {
+template <typename Real>
+void SimCompartment<Real>::doRK212Substep1_tbb(double dt) {
   s2.resize(conc.size());
   s3.resize(conc.size());
   tbb::parallel_for(tbb::blocked_range<std::size_t>(0, conc.size()),
@@ -259,23 +1045,27 @@ void SimCompartment::doRK212Substep1_tbb(double dt) {
 }
 #endif
 
-void SimCompartment::doRK212Substep2(double dt, std::size_t begin,
-                                     std::size_t end) {
+template <typename Real>
+void SimCompartment<Real>::doRK212Substep2(double dt, std::size_t begin,
+                                           std::size_t end) {
+  const auto h{static_cast<Real>(0.5 * dt)};
+  constexpr Real half{0.5};
 #ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
 #pragma omp parallel for
 #endif
   for (std::size_t i = begin; i < end; ++i) {
     s2[i] = conc[i];
-    conc[i] = 0.5 * s3[i] + 0.5 * conc[i] + 0.5 * dt * dcdt[i];
+    conc[i] = half * s3[i] + half * conc[i] + h * dcdt[i];
   }
 }
 
-void SimCompartment::doRK212Substep2(double dt) {
+template <typename Real> void SimCompartment<Real>::doRK212Substep2(double dt) {
   doRK212Substep2(dt, 0, conc.size());
 }
 
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-void SimCompartment::doRK212Substep2_tbb(double dt) {
+template <typename Real>
+void SimCompartment<Real>::doRK212Substep2_tbb(double dt) {
   tbb::parallel_for(tbb::blocked_range<std::size_t>(0, conc.size()),
                     [this, dt](const tbb::blocked_range<std::size_t> &r) {
                       doRK212Substep2(dt, r.begin(), r.end());
@@ -283,26 +1073,35 @@ void SimCompartment::doRK212Substep2_tbb(double dt) {
 }
 #endif
 
-void SimCompartment::doRKSubstep(double dt, double g1, double g2, double g3,
-                                 double beta, double delta, std::size_t begin,
-                                 std::size_t end) {
+template <typename Real>
+void SimCompartment<Real>::doRKSubstep(double dt, double g1, double g2,
+                                       double g3, double beta, double delta,
+                                       std::size_t begin, std::size_t end) {
+  const auto c1{static_cast<Real>(g1)};
+  const auto c2{static_cast<Real>(g2)};
+  const auto c3{static_cast<Real>(g3)};
+  const auto h{static_cast<Real>(beta * dt)};
+  const auto d{static_cast<Real>(delta)};
 #ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
 #pragma omp parallel for
 #endif
   for (std::size_t i = begin; i < end; ++i) {
-    s2[i] += delta * conc[i];
-    conc[i] = g1 * conc[i] + g2 * s2[i] + g3 * s3[i] + beta * dt * dcdt[i];
+    s2[i] += d * conc[i];
+    conc[i] = c1 * conc[i] + c2 * s2[i] + c3 * s3[i] + h * dcdt[i];
   }
 }
 
-void SimCompartment::doRKSubstep(double dt, double g1, double g2, double g3,
-                                 double beta, double delta) {
+template <typename Real>
+void SimCompartment<Real>::doRKSubstep(double dt, double g1, double g2,
+                                       double g3, double beta, double delta) {
   doRKSubstep(dt, g1, g2, g3, beta, delta, 0, conc.size());
 }
 
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-void SimCompartment::doRKSubstep_tbb(double dt, double g1, double g2, double g3,
-                                     double beta, double delta) {
+template <typename Real>
+void SimCompartment<Real>::doRKSubstep_tbb(double dt, double g1, double g2,
+                                           double g3, double beta,
+                                           double delta) {
   tbb::parallel_for(tbb::blocked_range<std::size_t>(0, conc.size()),
                     [this, dt, g1, g2, g3, beta,
                      delta](const tbb::blocked_range<std::size_t> &r) {
@@ -312,35 +1111,450 @@ void SimCompartment::doRKSubstep_tbb(double dt, double g1, double g2, double g3,
 }
 #endif
 
-void SimCompartment::doRKFinalise(double cFactor, double s2Factor,
-                                  double s3Factor, std::size_t begin,
-                                  std::size_t end) {
+template <typename Real> bool SimCompartment<Real>::canFuseRKSubstep() const {
+  // spatially averaging dcdt requires all pixels to have been evaluated
+  return nonSpatialSpeciesIndices.empty();
+}
+
+template <typename Real>
+void SimCompartment<Real>::addMembranePixels(
+    const std::vector<std::size_t> &pixelIndices) {
+  if (canBeUniform && !pixelIndices.empty() &&
+      nonSpatialSpeciesIndices.size() != nSpecies) {
+    // membrane flux only goes into some pixels: switch to separate pixels.
+    // If all species are non-spatial, dcdt is spatially averaged, so the
+    // state remains uniform and the membranes add their averaged flux to it
+    std::vector<double> c{getConcentrations()};
+    canBeUniform = false;
+    setUniform(false);
+    setConcentrations(c);
+  }
+  membranePixels.insert(membranePixels.end(), pixelIndices.cbegin(),
+                        pixelIndices.cend());
+  for (std::size_t ix : pixelIndices) {
+    if (!tileCanFreeze.empty()) {
+      tileCanFreeze[ix / pixelTileSize] = 0;
+    }
+  }
+  std::sort(membranePixels.begin(), membranePixels.end());
+  membranePixels.erase(
+      std::unique(membranePixels.begin(), membranePixels.end()),
+      membranePixels.end());
+}
+
+template <typename Real>
+void SimCompartment<Real>::fusedRKUpdate(double dt, double g1, double g2,
+                                         double g3, double beta, double delta,
+                                         std::size_t begin, std::size_t end) {
+  const auto c1{static_cast<Real>(g1)};
+  const auto c2{static_cast<Real>(g2)};
+  const auto c3{static_cast<Real>(g3)};
+  const auto h{static_cast<Real>(beta * dt)};
+  const auto d{static_cast<Real>(delta)};
+  for (std::size_t i = begin; i < end; ++i) {
+    s2[i] += d * conc[i];
+    concNext[i] = c1 * conc[i] + c2 * s2[i] + c3 * s3[i] + h * dcdt[i];
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::doFusedRKSubstep(double dt, double g1, double g2,
+                                            double g3, double beta,
+                                            double delta, std::size_t begin,
+                                            std::size_t end,
+                                            bool skipMembranePixels) {
+  const auto kernels{[this](std::size_t b, std::size_t e) {
+    reactionKernel(b, e);
+    if (!uniform) {
+      diffusionKernel(b, e);
+    }
+  }};
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
+  for (std::size_t t = begin; t < end; t += pixelTileSize) {
+    std::size_t tEnd{std::min(t + pixelTileSize, end)};
+    if (skipMembranePixels) {
+      forEachInteriorRange(t, tEnd, kernels);
+    } else {
+      forEachActiveRange(t, tEnd, kernels);
+    }
+    // update each run of pixels between membrane pixels while dcdt is still
+    // in cache: membrane pixels are updated later in finaliseFusedRKSubstep.
+    // frozen pixels have dcdt = 0 but are still updated, so the RK stages
+    // remain consistent
+    auto m{std::lower_bound(membranePixels.cbegin(), membranePixels.cend(),
+                            t)};
+    std::size_t a{t};
+    while (a < tEnd) {
+      std::size_t b{tEnd};
+      if (m != membranePixels.cend() && *m < tEnd) {
+        b = *m;
+        ++m;
+      }
+      if (speciesMajor) {
+        for (std::size_t is = 0; is < nSpecies; ++is) {
+          fusedRKUpdate(dt, g1, g2, g3, beta, delta, index(a, is),
+                        index(b, is));
+        }
+      } else {
+        fusedRKUpdate(dt, g1, g2, g3, beta, delta, index(a, 0), index(b, 0));
+      }
+      a = b + 1;
+    }
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::doFusedRKSubstep(double dt, double g1, double g2,
+                                            double g3, double beta,
+                                            double delta) {
+  doFusedRKSubstep(dt, g1, g2, g3, beta, delta, 0, nStatePixels, false);
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real>
+void SimCompartment<Real>::doFusedRKSubstep_tbb(double dt, double g1,
+                                                double g2, double g3,
+                                                double beta, double delta,
+                                                bool skipMembranePixels) {
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nStatePixels,
+                                                    pixelTileSize),
+                    [this, dt, g1, g2, g3, beta, delta,
+                     skipMembranePixels](const tbb::blocked_range<std::size_t>
+                                             &r) {
+                      doFusedRKSubstep(dt, g1, g2, g3, beta, delta, r.begin(),
+                                       r.end(), skipMembranePixels);
+                    });
+}
+#endif
+
+template <typename Real>
+void SimCompartment<Real>::finaliseFusedRKSubstep(double dt, double g1,
+                                                  double g2, double g3,
+                                                  double beta, double delta) {
+  for (std::size_t ix : membranePixels) {
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      std::size_t i{index(ix, is)};
+      fusedRKUpdate(dt, g1, g2, g3, beta, delta, i, i + 1);
+    }
+  }
+  std::swap(conc, concNext);
+}
+
+template <typename Real>
+void SimCompartment<Real>::solveImplicitDiffusion(double dt,
+                                                  std::vector<Real> &c,
+                                                  bool useTBB) {
+  if (uniform) {
+    return;
+  }
+  constexpr double relativeTolerance{1e-10};
+  const std::size_t maxIterations{std::max(nPixels, std::size_t{100})};
+  cgX.resize(nPixels);
+  cgR.resize(nPixels);
+  cgP.resize(nPixels);
+  cgAp.resize(nPixels);
+  // fixed partition of the pixels: results do not depend on the number of
+  // threads
+  auto dot{[n = nPixels, useTBB](const std::vector<double> &u,
+                                 const std::vector<double> &v) {
+    auto partialDot{[&u, &v](std::size_t begin, std::size_t end) {
+      double sum{0};
+      for (std::size_t i = begin; i < end; ++i) {
+        sum += u[i] * v[i];
+      }
+      return sum;
+    }};
+    if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+      return reduceChunks_tbb(n, 0.0, partialDot, std::plus<double>{});
+#endif
+    }
+    return reduceChunks(n, 0.0, partialDot, std::plus<double>{});
+  }};
+  for (std::size_t is = 0; is < nSpecies; ++is) {
+    const double a{dt * diffConstants[is]};
+    if (a == 0.0) {
+      continue;
+    }
+    // y = (1 - dt D) x: symmetric positive definite
+    auto applyMatrix{[a, useTBB, this](const std::vector<double> &x,
+                                       std::vector<double> &y) {
+      auto apply{[a, &x, &y, this](std::size_t begin, std::size_t end) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
+        for (std::size_t i = begin; i < end; ++i) {
+          y[i] = (1.0 + 4.0 * a) * x[i] -
+                 a * (x[up_x(i)] + x[dn_x(i)] + x[up_y(i)] + x[dn_y(i)]);
+        }
+      }};
+      if (useTBB) {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nPixels),
+                          [&apply](const tbb::blocked_range<std::size_t> &r) {
+                            apply(r.begin(), r.end());
+                          });
+        return;
+#endif
+      }
+      apply(0, nPixels);
+    }};
+    // initial guess x = b
+    for (std::size_t i = 0; i < nPixels; ++i) {
+      cgX[i] = c[index(i, is)];
+    }
+    double tolerance2{relativeTolerance * relativeTolerance *
+                      dot(cgX, cgX)};
+    applyMatrix(cgX, cgAp);
+    for (std::size_t i = 0; i < nPixels; ++i) {
+      cgR[i] = c[index(i, is)] - cgAp[i];
+    }
+    cgP = cgR;
+    double rr{dot(cgR, cgR)};
+    std::size_t iter{0};
+    while (rr > tolerance2 && iter < maxIterations) {
+      applyMatrix(cgP, cgAp);
+      const double alpha{rr / dot(cgP, cgAp)};
+      for (std::size_t i = 0; i < nPixels; ++i) {
+        cgX[i] += alpha * cgP[i];
+        cgR[i] -= alpha * cgAp[i];
+      }
+      const double rrNew{dot(cgR, cgR)};
+      const double beta{rrNew / rr};
+      for (std::size_t i = 0; i < nPixels; ++i) {
+        cgP[i] = cgR[i] + beta * cgP[i];
+      }
+      rr = rrNew;
+      ++iter;
+    }
+    if (rr > tolerance2) {
+      SPDLOG_WARN("CG did not converge for species {}: |r|^2 = {}",
+                  speciesIds[is], rr);
+    }
+    SPDLOG_TRACE("species {}: {} CG iterations", speciesIds[is], iter);
+    for (std::size_t i = 0; i < nPixels; ++i) {
+      c[index(i, is)] = static_cast<Real>(cgX[i]);
+    }
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::doIMEXSubstep1(double dt, bool useTBB) {
+  const auto h{static_cast<Real>(dt)};
+  const auto hHalf{static_cast<Real>(0.5 * dt)};
+  const std::size_t n{conc.size()};
+  for (std::size_t i = 0; i < n; ++i) {
+    s2[i] = s3[i] + h * dcdt[i];
+    conc[i] = s3[i] + hHalf * dcdt[i];
+  }
+  solveImplicitDiffusion(dt, s2, useTBB);
+  solveImplicitDiffusion(0.5 * dt, conc, useTBB);
+}
+
+template <typename Real> void SimCompartment<Real>::doIMEXSubstep1(double dt) {
+  doIMEXSubstep1(dt, false);
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real>
+void SimCompartment<Real>::doIMEXSubstep1_tbb(double dt) {
+  doIMEXSubstep1(dt, true);
+}
+#endif
+
+template <typename Real>
+void SimCompartment<Real>::doIMEXSubstep2(double dt, bool useTBB) {
+  const auto hHalf{static_cast<Real>(0.5 * dt)};
+  const std::size_t n{conc.size()};
+  for (std::size_t i = 0; i < n; ++i) {
+    conc[i] += hHalf * dcdt[i];
+  }
+  solveImplicitDiffusion(0.5 * dt, conc, useTBB);
+}
+
+template <typename Real> void SimCompartment<Real>::doIMEXSubstep2(double dt) {
+  doIMEXSubstep2(dt, false);
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real>
+void SimCompartment<Real>::doIMEXSubstep2_tbb(double dt) {
+  doIMEXSubstep2(dt, true);
+}
+#endif
+
+template <typename Real>
+void SimCompartment<Real>::doRKLStage1(double dt, double muTilde) {
+  dcdt0 = dcdt;
+  s2 = conc;
+  const auto h{static_cast<Real>(muTilde * dt)};
+  const std::size_t n{conc.size()};
+  for (std::size_t i = 0; i < n; ++i) {
+    conc[i] += h * dcdt[i];
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::doRKLStage(double dt, double mu, double nu,
+                                      double muTilde, double gammaTilde,
+                                      std::size_t begin, std::size_t end) {
+  const auto cFactor{static_cast<Real>(mu)};
+  const auto s2Factor{static_cast<Real>(nu)};
+  const auto s3Factor{static_cast<Real>(1.0 - mu - nu)};
+  const auto h{static_cast<Real>(muTilde * dt)};
+  const auto h0{static_cast<Real>(gammaTilde * dt)};
 #ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
 #pragma omp parallel for
 #endif
   for (std::size_t i = begin; i < end; ++i) {
-    s2[i] = cFactor * conc[i] + s2Factor * s2[i] + s3Factor * s3[i];
+    Real c{cFactor * conc[i] + s2Factor * s2[i] + s3Factor * s3[i] +
+           h * dcdt[i] + h0 * dcdt0[i]};
+    s2[i] = conc[i];
+    conc[i] = c;
   }
 }
 
-void SimCompartment::doRKFinalise(double cFactor, double s2Factor,
-                                  double s3Factor) {
-  doRKFinalise(cFactor, s2Factor, s3Factor, 0, conc.size());
+template <typename Real>
+void SimCompartment<Real>::doRKLStage(double dt, double mu, double nu,
+                                      double muTilde, double gammaTilde) {
+  doRKLStage(dt, mu, nu, muTilde, gammaTilde, 0, conc.size());
 }
 
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-void SimCompartment::doRKFinalise_tbb(double cFactor, double s2Factor,
-                                      double s3Factor) {
+template <typename Real>
+void SimCompartment<Real>::doRKLStage_tbb(double dt, double mu, double nu,
+                                          double muTilde, double gammaTilde) {
   tbb::parallel_for(tbb::blocked_range<std::size_t>(0, conc.size()),
-                    [this, cFactor, s2Factor,
-                     s3Factor](const tbb::blocked_range<std::size_t> &r) {
-                      doRKFinalise(cFactor, s2Factor, s3Factor, r.begin(),
-                                   r.end());
+                    [this, dt, mu, nu, muTilde,
+                     gammaTilde](const tbb::blocked_range<std::size_t> &r) {
+                      doRKLStage(dt, mu, nu, muTilde, gammaTilde, r.begin(),
+                                 r.end());
                     });
 }
 #endif
 
-void SimCompartment::undoRKStep(std::size_t begin, std::size_t end) {
+template <typename Real> void SimCompartment<Real>::doRKLFinalise(double dt) {
+  // local error estimate for a 2nd order method from y_n, y_n+1 and the
+  // derivatives at both ends, as used in RKC, see
+  // https://doi.org/10.1016/S0377-0427(97)00219-7
+  const std::size_t n{conc.size()};
+  for (std::size_t i = 0; i < n; ++i) {
+    double err{(12.0 * (s3[i] - conc[i]) + 6.0 * dt * (dcdt0[i] + dcdt[i])) /
+               15.0};
+    s2[i] = static_cast<Real>(conc[i] - err);
+  }
+}
+
+template <typename Real> void SimCompartment<Real>::beginDenseOutput() {
+  denseC0 = s3;
+  std::swap(conc, denseC0);
+}
+
+template <typename Real> void SimCompartment<Real>::storeDenseOutputStart() {
+  denseF0 = dcdt;
+  std::swap(conc, denseC0);
+}
+
+template <typename Real> void SimCompartment<Real>::storeDenseOutputEnd() {
+  denseF1 = dcdt;
+}
+
+template <typename Real>
+void SimCompartment<Real>::interpolateDenseOutput(double theta, double dt) {
+  // cubic Hermite basis functions
+  const double t2{theta * theta};
+  const double t3{t2 * theta};
+  const auto h00{static_cast<Real>(2.0 * t3 - 3.0 * t2 + 1.0)};
+  const auto h10{static_cast<Real>(dt * (t3 - 2.0 * t2 + theta))};
+  const auto h01{static_cast<Real>(-2.0 * t3 + 3.0 * t2)};
+  const auto h11{static_cast<Real>(dt * (t3 - t2))};
+  denseConc.resize(conc.size());
+  const std::size_t n{conc.size()};
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
+  for (std::size_t i = 0; i < n; ++i) {
+    denseConc[i] = h00 * denseC0[i] + h10 * denseF0[i] + h01 * conc[i] +
+                   h11 * denseF1[i];
+  }
+  denseOutputActive = true;
+}
+
+template <typename Real> void SimCompartment<Real>::clearDenseOutput() {
+  denseOutputActive = false;
+}
+
+template <typename Real>
+const std::vector<Real> &SimCompartment<Real>::outputConcentrations() const {
+  return denseOutputActive ? denseConc : conc;
+}
+
+template <typename Real>
+PixelStepError SimCompartment<Real>::stepError(double c, double cOld,
+                                               double cLower,
+                                               double epsilon) const {
+  PixelStepError err;
+  double localErr = std::abs(c - cLower);
+  err.max.abs = localErr;
+  // average current and previous concentrations and add a (hopefully) small
+  // constant term to avoid dividing by c=0 issues
+  double localNorm = 0.5 * (c + cOld + epsilon);
+  err.max.rel = localErr / localNorm;
+  // Hairer-style weight for the RMS norm
+  double scale{errAbs +
+               errRel * (std::max(std::abs(c), std::abs(cOld)) + epsilon)};
+  // a uniform state represents every pixel in the compartment
+  err.n = uniform ? nPixels : 1;
+  err.sumSquares =
+      static_cast<double>(err.n) * (localErr / scale) * (localErr / scale);
+  return err;
+}
+
+template <typename Real>
+PixelStepError SimCompartment<Real>::doRKFinalise(
+    double cFactor, double s2Factor, double s3Factor, double epsilon,
+    std::size_t begin, std::size_t end) {
+  PixelStepError err;
+  for (std::size_t i = begin; i < end; ++i) {
+    s2[i] = static_cast<Real>(cFactor * conc[i] + s2Factor * s2[i] +
+                              s3Factor * s3[i]);
+    err = combineErrors(err, stepError(conc[i], s3[i], s2[i], epsilon));
+  }
+  return err;
+}
+
+template <typename Real>
+PixelStepError SimCompartment<Real>::doRKFinalise(double cFactor,
+                                                  double s2Factor,
+                                                  double s3Factor,
+                                                  double epsilon) {
+  return reduceChunks(
+      conc.size(), PixelStepError{},
+      [=](std::size_t begin, std::size_t end) {
+        return doRKFinalise(cFactor, s2Factor, s3Factor, epsilon, begin, end);
+      },
+      combineErrors);
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real>
+PixelStepError SimCompartment<Real>::doRKFinalise_tbb(double cFactor,
+                                                      double s2Factor,
+                                                      double s3Factor,
+                                                      double epsilon) {
+  return reduceChunks_tbb(
+      conc.size(), PixelStepError{},
+      [=](std::size_t begin, std::size_t end) {
+        return doRKFinalise(cFactor, s2Factor, s3Factor, epsilon, begin, end);
+      },
+      combineErrors);
+}
+#endif
+
+template <typename Real>
+void SimCompartment<Real>::undoRKStep(std::size_t begin, std::size_t end) {
 #ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
 #pragma omp parallel for
 #endif
@@ -349,10 +1563,12 @@ void SimCompartment::undoRKStep(std::size_t begin, std::size_t end) {
   }
 }
 
-void SimCompartment::undoRKStep() { undoRKStep(0, conc.size()); }
+template <typename Real> void SimCompartment<Real>::undoRKStep() {
+  undoRKStep(0, conc.size());
+}
 
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-void SimCompartment::undoRKStep_tbb() {
+template <typename Real> void SimCompartment<Real>::undoRKStep_tbb() {
   tbb::parallel_for(tbb::blocked_range<std::size_t>(0, conc.size()),
                     [this](const tbb::blocked_range<std::size_t> &r) {
                       undoRKStep(r.begin(), r.end());
@@ -360,39 +1576,80 @@ void SimCompartment::undoRKStep_tbb() {
 }
 #endif
 
-PixelIntegratorError SimCompartment::calculateRKError(double epsilon) const {
-  PixelIntegratorError err{0.0, 0.0};
-  std::size_t n{conc.size()};
-  for (std::size_t i = 0; i < n; ++i) {
-    double localErr = std::abs(conc[i] - s2[i]);
-    err.abs = std::max(err.abs, localErr);
-    // average current and previous concentrations and add a (hopefully) small
-    // constant term to avoid dividing by c=0 issues
-    double localNorm = 0.5 * (conc[i] + s3[i] + epsilon);
-    err.rel = std::max(err.rel, localErr / localNorm);
+template <typename Real>
+PixelStepError SimCompartment<Real>::calculateRKError(double epsilon,
+                                                      std::size_t begin,
+                                                      std::size_t end) const {
+  PixelStepError err;
+  for (std::size_t i = begin; i < end; ++i) {
+    err = combineErrors(err, stepError(conc[i], s3[i], s2[i], epsilon));
   }
   return err;
 }
 
-std::string SimCompartment::plotRKError(QImage &image, double epsilon,
-                                        double max) const {
+template <typename Real>
+PixelStepError SimCompartment<Real>::calculateRKError(double epsilon) const {
+  return reduceChunks(
+      conc.size(), PixelStepError{},
+      [this, epsilon](std::size_t begin, std::size_t end) {
+        return calculateRKError(epsilon, begin, end);
+      },
+      combineErrors);
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real>
+PixelStepError
+SimCompartment<Real>::calculateRKError_tbb(double epsilon) const {
+  return reduceChunks_tbb(
+      conc.size(), PixelStepError{},
+      [this, epsilon](std::size_t begin, std::size_t end) {
+        return calculateRKError(epsilon, begin, end);
+      },
+      combineErrors);
+}
+#endif
+
+template <typename Real>
+PixelStepError SimCompartment<Real>::calculateStateError(
+    const double *c, const double *cOld, const double *err,
+    double epsilon) const {
+  return reduceChunks(
+      conc.size(), PixelStepError{},
+      [this, c, cOld, err, epsilon](std::size_t begin, std::size_t end) {
+        PixelStepError e;
+        for (std::size_t i = begin; i < end; ++i) {
+          e = combineErrors(
+              e, stepError(c[i], cOld[i], c[i] - err[i], epsilon));
+        }
+        return e;
+      },
+      combineErrors);
+}
+
+template <typename Real>
+std::string SimCompartment<Real>::plotRKError(QImage &image, double epsilon,
+                                              double max) const {
   if (image.isNull()) {
     image = QImage(comp->getCompartmentImage().size(), QImage::Format_RGB32);
     image.fill(qRgb(0, 0, 0));
   }
   std::size_t iSpecies{nSpecies + 1};
-  for (std::size_t i = 0; i < conc.size(); ++i) {
-    double localErr = std::abs(conc[i] - s2[i]);
-    double localNorm = 0.5 * (conc[i] + s3[i] + epsilon);
-    double pixelIntensity{localErr / localNorm / max};
-    auto red{static_cast<int>(255.0 * pixelIntensity)};
-    auto point{comp->getPixel(i / nSpecies)};
-    auto oldRed{qRed(image.pixel(point))};
-    if (red > oldRed) {
-      image.setPixel(point, qRgb(red, 0, 0));
-      if (red > 254) {
-        // update index of species with largest error
-        iSpecies = i % nSpecies;
+  for (std::size_t ix = 0; ix < nPixels; ++ix) {
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      std::size_t i{index(uniform ? 0 : ix, is)};
+      double localErr = std::abs(conc[i] - s2[i]);
+      double localNorm = 0.5 * (conc[i] + s3[i] + epsilon);
+      double pixelIntensity{localErr / localNorm / max};
+      auto red{static_cast<int>(255.0 * pixelIntensity)};
+      auto point{comp->getPixel(compartmentPixel(ix))};
+      auto oldRed{qRed(image.pixel(point))};
+      if (red > oldRed) {
+        image.setPixel(point, qRgb(red, 0, 0));
+        if (red > 254) {
+          // update index of species with largest error
+          iSpecies = is;
+        }
       }
     }
   }
@@ -402,54 +1659,338 @@ std::string SimCompartment::plotRKError(QImage &image, double epsilon,
   return {};
 }
 
-const std::string &SimCompartment::getCompartmentId() const {
+template <typename Real>
+const std::string &SimCompartment<Real>::getCompartmentId() const {
   return compartmentId;
 }
 
-const std::vector<std::string> &SimCompartment::getSpeciesIds() const {
+template <typename Real>
+const std::vector<std::string> &SimCompartment<Real>::getSpeciesIds() const {
   return speciesIds;
 }
 
-const std::vector<double> &SimCompartment::getConcentrations() const {
+template <typename Real> void SimCompartment<Real>::compileReactions() {
+  reacEval.compile();
+  if (hasJacobian) {
+    jacEval.compile();
+  }
+}
+
+template <typename Real>
+bool SimCompartment<Real>::updateTieredCompilation() {
+  return reacEval.updateTieredCompilation();
+}
+
+template <typename Real>
+void SimCompartment<Real>::setRuntimeParameters(
+    const std::vector<double> &values) {
+  parameterValues = values;
+  // the reaction terms may have changed anywhere
+  std::fill(tileFrozen.begin(), tileFrozen.end(), 0);
+  nFrozenTiles = 0;
+}
+
+template <typename Real> void SimCompartment<Real>::setTime(double t) {
+  time = t;
+}
+
+template <typename Real> double SimCompartment<Real>::getTime() const {
+  return time;
+}
+
+template <typename Real>
+const double *SimCompartment<Real>::getPixelCoordinates(std::size_t ix) const {
+  return pixelCoordinates.data() + 2 * ix;
+}
+
+template <typename Real>
+const std::vector<Real> &SimCompartment<Real>::getStateConcentrations() const {
   return conc;
 }
 
-void SimCompartment::setConcentrations(
+template <typename Real>
+std::vector<Real> &SimCompartment<Real>::getStateDcdt() {
+  return dcdt;
+}
+
+template <typename Real> bool SimCompartment<Real>::isUniform() const {
+  return uniform;
+}
+
+template <typename Real>
+std::size_t SimCompartment<Real>::getFrozenTiles() const {
+  return nFrozenTiles;
+}
+
+template <typename Real>
+void SimCompartment<Real>::setStateConcentrations(const double *stateConc) {
+  denseOutputActive = false;
+  for (std::size_t i = 0; i < conc.size(); ++i) {
+    conc[i] = static_cast<Real>(stateConc[i]);
+  }
+  // the new state may differ anywhere
+  std::fill(tileFrozen.begin(), tileFrozen.end(), 0);
+  nFrozenTiles = 0;
+}
+
+template <typename Real> double SimCompartment<Real>::getDcdtNorm() const {
+  double norm{0};
+  for (std::size_t is = 0; is < nSpecies; ++is) {
+    double maxDcdt{0};
+    double maxConc{0};
+    for (std::size_t ix = 0; ix < nStatePixels; ++ix) {
+      std::size_t i{index(ix, is)};
+      maxDcdt = std::max(maxDcdt, std::abs(static_cast<double>(dcdt[i])));
+      maxConc = std::max(maxConc, std::abs(static_cast<double>(conc[i])));
+    }
+    if (maxConc > 0) {
+      maxDcdt /= maxConc;
+    }
+    // a nan dcdt is never small
+    if (!(maxDcdt <= std::numeric_limits<double>::max())) {
+      return std::numeric_limits<double>::infinity();
+    }
+    norm = std::max(norm, maxDcdt);
+  }
+  return norm;
+}
+
+// in-place LU factorisation with partial pivoting of the n x n row-major
+// matrix a: a zero pivot is replaced with one, which only weakens the
+// preconditioner
+static void factoriseLU(double *a, std::size_t n, std::size_t *pivots) {
+  for (std::size_t k = 0; k < n; ++k) {
+    std::size_t p{k};
+    for (std::size_t i = k + 1; i < n; ++i) {
+      if (std::abs(a[i * n + k]) > std::abs(a[p * n + k])) {
+        p = i;
+      }
+    }
+    pivots[k] = p;
+    if (p != k) {
+      for (std::size_t j = 0; j < n; ++j) {
+        std::swap(a[k * n + j], a[p * n + j]);
+      }
+    }
+    if (a[k * n + k] == 0.0) {
+      a[k * n + k] = 1.0;
+    }
+    for (std::size_t i = k + 1; i < n; ++i) {
+      a[i * n + k] /= a[k * n + k];
+      for (std::size_t j = k + 1; j < n; ++j) {
+        a[i * n + j] -= a[i * n + k] * a[k * n + j];
+      }
+    }
+  }
+}
+
+// solve (LU) x = b in place, using the output of factoriseLU
+static void solveLU(const double *lu, std::size_t n, const std::size_t *pivots,
+                    double *x) {
+  for (std::size_t k = 0; k < n; ++k) {
+    std::swap(x[k], x[pivots[k]]);
+  }
+  for (std::size_t i = 1; i < n; ++i) {
+    for (std::size_t j = 0; j < i; ++j) {
+      x[i] -= lu[i * n + j] * x[j];
+    }
+  }
+  for (std::size_t i = n; i-- > 0;) {
+    for (std::size_t j = i + 1; j < n; ++j) {
+      x[i] -= lu[i * n + j] * x[j];
+    }
+    x[i] /= lu[i * n + i];
+  }
+}
+
+template <typename Real> bool SimCompartment<Real>::updateJacobian() {
+  if (!hasJacobian) {
+    return false;
+  }
+  const std::size_t n2{nSpecies * nSpecies};
+  const std::size_t nInputs{nSpecies + nExtraVars};
+  std::vector<double> inputs(nStatePixels * nInputs);
+  for (std::size_t ix = 0; ix < nStatePixels; ++ix) {
+    double *input{inputs.data() + ix * nInputs};
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      input[is] = static_cast<double>(conc[index(ix, is)]);
+    }
+    setExtraInputs(ix, input + nSpecies);
+  }
+  jacobianBlocks.resize(nStatePixels * n2);
+  jacEval.evaluate(jacobianBlocks.data(), inputs.data(), nStatePixels, n2,
+                   nInputs);
+  if (uniform) {
+    // diffusion of a uniform state is zero
+    return true;
+  }
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
+  for (std::size_t ix = 0; ix < nStatePixels; ++ix) {
+    // diagonal of the diffusion operator: -D for each neighbour
+    std::size_t nNeighbours{0};
+    for (std::size_t i = 4 * ix; i < 4 * ix + 4; ++i) {
+      if (neighbours[i] != ix) {
+        ++nNeighbours;
+      }
+    }
+    double *a{jacobianBlocks.data() + ix * n2};
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      a[is * nSpecies + is] -= static_cast<double>(diffConstants[is]) *
+                               static_cast<double>(nNeighbours);
+    }
+  }
+  return true;
+}
+
+template <typename Real>
+void SimCompartment<Real>::factoriseJacobian(double shift) {
+  const std::size_t n2{nSpecies * nSpecies};
+  precondLU.resize(jacobianBlocks.size());
+  precondPivots.resize(nStatePixels * nSpecies);
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
+  for (std::size_t ix = 0; ix < nStatePixels; ++ix) {
+    double *a{precondLU.data() + ix * n2};
+    const double *jac{jacobianBlocks.data() + ix * n2};
+    for (std::size_t i = 0; i < n2; ++i) {
+      a[i] = -jac[i];
+    }
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      a[is * nSpecies + is] += shift;
+    }
+    factoriseLU(a, nSpecies, precondPivots.data() + ix * nSpecies);
+  }
+}
+
+template <typename Real>
+void SimCompartment<Real>::applyPreconditioner(double *x) const {
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for
+#endif
+  for (std::size_t ix = 0; ix < nStatePixels; ++ix) {
+    thread_local std::vector<double> b;
+    b.resize(nSpecies);
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      b[is] = x[index(ix, is)];
+    }
+    solveLU(precondLU.data() + ix * nSpecies * nSpecies, nSpecies,
+            precondPivots.data() + ix * nSpecies, b.data());
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      x[index(ix, is)] = b[is];
+    }
+  }
+}
+
+template <typename Real>
+std::vector<double> SimCompartment<Real>::getConcentrations() const {
+  if constexpr (std::is_same_v<Real, double>) {
+    if (!speciesMajor && pixelOrder.empty() && !uniform) {
+      return outputConcentrations();
+    }
+  }
+  return toPixelMajor(outputConcentrations());
+}
+
+template <typename Real>
+void SimCompartment<Real>::setConcentrations(
     const std::vector<double> &concentrations) {
-  conc = concentrations;
+  denseOutputActive = false;
+  // the new state may differ anywhere
+  std::fill(tileFrozen.begin(), tileFrozen.end(), 0);
+  nFrozenTiles = 0;
+  if (canBeUniform) {
+    setUniform(isUniformConcentration(concentrations));
+  }
+  if constexpr (std::is_same_v<Real, double>) {
+    if (!speciesMajor && pixelOrder.empty() && !uniform) {
+      conc = concentrations;
+      return;
+    }
+  }
+  for (std::size_t ix = 0; ix < nStatePixels; ++ix) {
+    std::size_t iCompPixel{compartmentPixel(ix)};
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      conc[index(ix, is)] =
+          static_cast<Real>(concentrations[iCompPixel * nSpecies + is]);
+    }
+  }
 }
 
+template <typename Real>
 double
-SimCompartment::getLowerOrderConcentration(std::size_t speciesIndex,
-                                           std::size_t pixelIndex) const {
+SimCompartment<Real>::getLowerOrderConcentration(std::size_t speciesIndex,
+                                                 std::size_t pixelIndex) const {
   if (s2.empty()) {
     return 0;
   }
-  return s2[pixelIndex * nSpecies + speciesIndex];
+  if (uniform) {
+    return s2[index(0, speciesIndex)];
+  }
+  return s2[index(getPixelIndex(pixelIndex), speciesIndex)];
 }
 
-const std::vector<QPoint> &SimCompartment::getPixels() const {
+template <typename Real>
+const std::vector<QPoint> &SimCompartment<Real>::getPixels() const {
   return comp->getPixels();
 }
 
-std::vector<double> &SimCompartment::getDcdt() { return dcdt; }
+template <typename Real>
+std::vector<double> SimCompartment<Real>::getDcdt() const {
+  if constexpr (std::is_same_v<Real, double>) {
+    if (!speciesMajor && pixelOrder.empty() && !uniform) {
+      return dcdt;
+    }
+  }
+  return toPixelMajor(dcdt);
+}
 
-double SimCompartment::getMaxStableTimestep() const {
+template <typename Real>
+double SimCompartment<Real>::getMaxStableTimestep() const {
+  if (uniform) {
+    return std::numeric_limits<double>::max();
+  }
   return maxStableTimestep;
 }
 
-SimMembrane::SimMembrane(
+template <typename Real>
+SimMembrane<Real>::SimMembrane(
     const model::Model &doc, const geometry::Membrane *membrane_ptr,
-    SimCompartment *simCompA, SimCompartment *simCompB, bool doCSE,
-    unsigned optLevel, bool timeDependent, bool spaceDependent,
-    const std::map<std::string, double, std::less<>> &substitutions)
-    : membrane(membrane_ptr), compA(simCompA), compB(simCompB) {
+    SimCompartment<Real> *simCompA, SimCompartment<Real> *simCompB,
+    bool doCSE, unsigned optLevel, bool timeDependent, bool spaceDependent,
+    const std::map<std::string, double, std::less<>> &substitutions,
+    bool tieredCompilation,
+    const std::vector<std::pair<std::string, double>> &runtimeParameters)
+    : membrane(membrane_ptr), compA(simCompA), compB(simCompB),
+      timeDependent{timeDependent}, spaceDependent{spaceDependent} {
+  // convert compartment pixel indices to simulation pixel indices
+  std::vector<std::size_t> pixelsA;
+  std::vector<std::size_t> pixelsB;
+  indexPairs.reserve(membrane->getIndexPairs().size());
+  pixelsA.reserve(membrane->getIndexPairs().size());
+  pixelsB.reserve(membrane->getIndexPairs().size());
+  for (const auto &[iA, iB] : membrane->getIndexPairs()) {
+    std::size_t ixA{compA != nullptr ? compA->getPixelIndex(iA) : iA};
+    std::size_t ixB{compB != nullptr ? compB->getPixelIndex(iB) : iB};
+    indexPairs.emplace_back(ixA, ixB);
+    pixelsA.push_back(ixA);
+    pixelsB.push_back(ixB);
+  }
+  colourIndexPairs();
   if (timeDependent) {
     ++nExtraVars;
   }
   if (spaceDependent) {
     nExtraVars += 2;
   }
+  std::vector<std::string> parameterIds;
+  for (const auto &[id, value] : runtimeParameters) {
+    parameterIds.push_back(id);
+    parameterValues.push_back(value);
+  }
+  nExtraVars += parameterValues.size();
   if (compA != nullptr &&
       membrane->getCompartmentA()->getId() != compA->getCompartmentId()) {
     SPDLOG_ERROR("compA '{}' doesn't match simCompA '{}'",
@@ -462,6 +2003,13 @@ SimMembrane::SimMembrane(
                  membrane->getCompartmentB()->getId(),
                  compB->getCompartmentId());
   }
+  // flux into these pixels is added after the compartment dcdt is evaluated
+  if (compA != nullptr) {
+    compA->addMembranePixels(pixelsA);
+  }
+  if (compB != nullptr) {
+    compB->addMembranePixels(pixelsB);
+  }
   SPDLOG_DEBUG("membrane: {}", membrane->getId());
   SPDLOG_DEBUG("  - compA: {}",
                compA != nullptr ? compA->getCompartmentId() : "");
@@ -471,16 +2019,11 @@ SimMembrane::SimMembrane(
   // make vector of species from compartments A and B
   std::vector<std::string> speciesIds;
   if (compA != nullptr) {
-    for (std::size_t i = 0; i < compA->getSpeciesIds().size() - nExtraVars;
-         ++i) {
-      speciesIds.push_back(compA->getSpeciesIds()[i]);
-    }
+    speciesIds = compA->getSpeciesIds();
   }
   if (compB != nullptr) {
-    for (std::size_t i = 0; i < compB->getSpeciesIds().size() - nExtraVars;
-         ++i) {
-      speciesIds.push_back(compB->getSpeciesIds()[i]);
-    }
+    speciesIds.insert(speciesIds.end(), compB->getSpeciesIds().cbegin(),
+                      compB->getSpeciesIds().cend());
   }
 
   // get rescaling factor to convert flux to amount/length^3,
@@ -495,55 +2038,207 @@ SimMembrane::SimMembrane(
   // make vector of reaction IDs from membrane
   std::vector<std::string> reactionID =
       utils::toStdString(doc.getReactions().getIds(membrane->getId().c_str()));
-  reacEval =
-      ReacEval(doc, speciesIds, reactionID, volOverL3 / pixelWidth, doCSE,
-               optLevel, timeDependent, spaceDependent, substitutions);
+  reacEval = ReacEval(doc, speciesIds, reactionID, volOverL3 / pixelWidth,
+                      doCSE, optLevel, timeDependent, spaceDependent,
+                      substitutions, std::is_same_v<Real, float>, false,
+                      tieredCompilation, parameterIds);
 }
 
-void SimMembrane::evaluateReactions() {
+template <typename Real> void SimMembrane<Real>::colourIndexPairs() {
+  // sort for locality, then greedily assign each pair the lowest colour not
+  // yet used by either of its pixels
+  std::sort(indexPairs.begin(), indexPairs.end());
+  std::vector<std::uint8_t> usedA(membrane->getCompartmentA()->nPixels(), 0);
+  std::vector<std::uint8_t> usedB(membrane->getCompartmentB()->nPixels(), 0);
+  std::vector<std::vector<std::pair<std::size_t, std::size_t>>> colours;
+  for (const auto &pair : indexPairs) {
+    auto &uA{usedA[pair.first]};
+    auto &uB{usedB[pair.second]};
+    // each pixel has at most 4 neighbours, so at most 7 colours are needed
+    std::size_t colour{0};
+    while (((uA | uB) & (1u << colour)) != 0) {
+      ++colour;
+    }
+    uA = static_cast<std::uint8_t>(uA | (1u << colour));
+    uB = static_cast<std::uint8_t>(uB | (1u << colour));
+    if (colour >= colours.size()) {
+      colours.resize(colour + 1);
+    }
+    colours[colour].push_back(pair);
+  }
+  indexPairs.clear();
+  colourOffsets = {0};
+  for (const auto &pairs : colours) {
+    indexPairs.insert(indexPairs.end(), pairs.cbegin(), pairs.cend());
+    colourOffsets.push_back(indexPairs.size());
+  }
+  SPDLOG_DEBUG("  - {} index pairs in {} colours", indexPairs.size(),
+               colours.size());
+}
+
+template <typename Real>
+void SimMembrane<Real>::evaluateReactions(std::size_t begin, std::size_t end) {
   std::size_t nSpeciesA{0};
-  const std::vector<double> *concA{nullptr};
-  std::vector<double> *dcdtA{nullptr};
+  const std::vector<Real> *concA{nullptr};
+  std::vector<Real> *dcdtA{nullptr};
+  // a uniform compartment is a single pixel, and receives the flux averaged
+  // over all of its pixels
+  bool uniformA{false};
+  Real scaleA{1};
   if (compA != nullptr) {
-    nSpeciesA = compA->getSpeciesIds().size() - nExtraVars;
-    concA = &compA->getConcentrations();
-    dcdtA = &compA->getDcdt();
+    nSpeciesA = compA->getSpeciesIds().size();
+    concA = &compA->getStateConcentrations();
+    dcdtA = &compA->getStateDcdt();
+    uniformA = compA->isUniform();
+    if (uniformA) {
+      scaleA = static_cast<Real>(
+          1.0 / static_cast<double>(compA->getPixels().size()));
+    }
   }
   std::size_t nSpeciesB{0};
-  const std::vector<double> *concB{nullptr};
-  std::vector<double> *dcdtB{nullptr};
+  const std::vector<Real> *concB{nullptr};
+  std::vector<Real> *dcdtB{nullptr};
+  bool uniformB{false};
+  Real scaleB{1};
   if (compB != nullptr) {
-    nSpeciesB = compB->getSpeciesIds().size() - nExtraVars;
-    concB = &compB->getConcentrations();
-    dcdtB = &compB->getDcdt();
+    nSpeciesB = compB->getSpeciesIds().size();
+    concB = &compB->getStateConcentrations();
+    dcdtB = &compB->getStateDcdt();
+    uniformB = compB->isUniform();
+    if (uniformB) {
+      scaleB = static_cast<Real>(
+          1.0 / static_cast<double>(compB->getPixels().size()));
+    }
   }
-  std::vector<double> species(nSpeciesA + nSpeciesB + nExtraVars, 0);
-  std::vector<double> result(nSpeciesA + nSpeciesB + nExtraVars, 0);
-  for (const auto &[ixA, ixB] : membrane->getIndexPairs()) {
+  const std::size_t nInputs{nSpeciesA + nSpeciesB + nExtraVars};
+  const std::size_t nOutputs{nSpeciesA + nSpeciesB};
+  // t,x,y are taken from compartment B if present, otherwise A
+  const SimCompartment<Real> *compXY{compB != nullptr ? compB : compA};
+  // every pair adds to the same pixel of a uniform compartment
+  [[maybe_unused]] const bool parallel{!uniformA && !uniformB};
+#ifdef SPATIAL_MODEL_EDITOR_WITH_OPENMP
+#pragma omp parallel for if (parallel)
+#endif
+  for (std::size_t t = begin; t < end; t += pixelTileSize) {
+    const std::size_t tEnd{std::min(t + pixelTileSize, end)};
+    const std::size_t n{tEnd - t};
+    thread_local std::vector<Real> species;
+    thread_local std::vector<Real> result;
+    species.resize(n * nInputs);
+    result.resize(n * nOutputs);
     // populate species concentrations: first A, then B, then t,x,y
-    if (concA != nullptr) {
-      std::copy_n(&((*concA)[ixA * (nSpeciesA + nExtraVars)]), nSpeciesA,
-                  &species[0]);
-    }
-    if (concB != nullptr) {
-      std::copy_n(&((*concB)[ixB * (nSpeciesB + nExtraVars)]),
-                  nSpeciesB + nExtraVars, &species[nSpeciesA]);
-    } else if (concA != nullptr) {
-      std::copy_n(&((*concA)[ixA * (nSpeciesA + nExtraVars) + nSpeciesA]),
-                  nExtraVars, &species[nSpeciesA]);
+    for (std::size_t j = 0; j < n; ++j) {
+      const auto &[ixA, ixB] = indexPairs[t + j];
+      Real *in{species.data() + j * nInputs};
+      if (concA != nullptr) {
+        const std::size_t iA{uniformA ? 0 : ixA};
+        for (std::size_t is = 0; is < nSpeciesA; ++is) {
+          in[is] = (*concA)[compA->index(iA, is)];
+        }
+      }
+      if (concB != nullptr) {
+        const std::size_t iB{uniformB ? 0 : ixB};
+        for (std::size_t is = 0; is < nSpeciesB; ++is) {
+          in[nSpeciesA + is] = (*concB)[compB->index(iB, is)];
+        }
+      }
+      std::size_t iExtra{nSpeciesA + nSpeciesB};
+      if (timeDependent) {
+        in[iExtra++] = static_cast<Real>(compXY->getTime());
+      }
+      if (spaceDependent) {
+        const double *xy{
+            compXY->getPixelCoordinates(compB != nullptr ? ixB : ixA)};
+        in[iExtra++] = static_cast<Real>(xy[0]);
+        in[iExtra++] = static_cast<Real>(xy[1]);
+      }
+      for (double value : parameterValues) {
+        in[iExtra++] = static_cast<Real>(value);
+      }
     }
 
     // evaluate reaction terms
-    reacEval.evaluate(result.data(), species.data());
+    reacEval.evaluate(result.data(), species.data(), n, nOutputs, nInputs);
 
     // add results to dc/dt: first A, then B
-    for (std::size_t is = 0; is < nSpeciesA; ++is) {
-      (*dcdtA)[ixA * (nSpeciesA + nExtraVars) + is] += result[is];
-    }
-    for (std::size_t is = 0; is < nSpeciesB; ++is) {
-      (*dcdtB)[ixB * (nSpeciesB + nExtraVars) + is] += result[is + nSpeciesA];
+    for (std::size_t j = 0; j < n; ++j) {
+      const auto &[ixA, ixB] = indexPairs[t + j];
+      const Real *out{result.data() + j * nOutputs};
+      const std::size_t iA{uniformA ? 0 : ixA};
+      for (std::size_t is = 0; is < nSpeciesA; ++is) {
+        (*dcdtA)[compA->index(iA, is)] += scaleA * out[is];
+      }
+      const std::size_t iB{uniformB ? 0 : ixB};
+      for (std::size_t is = 0; is < nSpeciesB; ++is) {
+        (*dcdtB)[compB->index(iB, is)] += scaleB * out[is + nSpeciesA];
+      }
     }
   }
 }
 
+template <typename Real>
+const SimCompartment<Real> *SimMembrane<Real>::getCompartmentA() const {
+  return compA;
+}
+
+template <typename Real>
+const SimCompartment<Real> *SimMembrane<Real>::getCompartmentB() const {
+  return compB;
+}
+
+template <typename Real>
+const std::vector<std::pair<std::size_t, std::size_t>> &
+SimMembrane<Real>::getIndexPairs() const {
+  return indexPairs;
+}
+
+template <typename Real>
+const std::vector<std::size_t> &SimMembrane<Real>::getColourOffsets() const {
+  return colourOffsets;
+}
+
+template <typename Real> void SimMembrane<Real>::compileReactions() {
+  reacEval.compile();
+}
+
+template <typename Real>
+void SimMembrane<Real>::setRuntimeParameters(
+    const std::vector<double> &values) {
+  parameterValues = values;
+}
+
+template <typename Real> bool SimMembrane<Real>::updateTieredCompilation() {
+  return reacEval.updateTieredCompilation();
+}
+
+template <typename Real> void SimMembrane<Real>::evaluateReactions() {
+  for (std::size_t c = 0; c + 1 < colourOffsets.size(); ++c) {
+    evaluateReactions(colourOffsets[c], colourOffsets[c + 1]);
+  }
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+template <typename Real> void SimMembrane<Real>::evaluateReactions_tbb() {
+  if ((compA != nullptr && compA->isUniform()) ||
+      (compB != nullptr && compB->isUniform())) {
+    // every pair adds to the same pixel of a uniform compartment
+    evaluateReactions();
+    return;
+  }
+  for (std::size_t c = 0; c + 1 < colourOffsets.size(); ++c) {
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(colourOffsets[c],
+                                                      colourOffsets[c + 1],
+                                                      pixelTileSize),
+                      [this](const tbb::blocked_range<std::size_t> &r) {
+                        evaluateReactions(r.begin(), r.end());
+                      });
+  }
+}
+#endif
+
+template class SimCompartment<double>;
+template class SimCompartment<float>;
+template class SimMembrane<double>;
+template class SimMembrane<float>;
+
 } // namespace sme::simulate
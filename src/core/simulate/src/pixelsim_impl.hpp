@@ -2,17 +2,22 @@
 //  - ReacEval: evaluates reaction terms at a single location
 //  - SimCompartment: evaluates reactions in a compartment
 //  - SimMembrane: evaluates reactions in a membrane
+// concentrations are stored as Real: either double or float
 
 #pragma once
 
 #include "pde.hpp"
+#include "pixelsim.hpp"
 #include "simulate_options.hpp"
 #include "symbolic.hpp"
 #include <QImage>
 #include <QPoint>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace sme {
@@ -32,49 +37,220 @@ class ReacEval {
 private:
   // symengine reaction expression
   utils::Symbolic sym;
+  bool doCSE{true};
+  unsigned optLevel{3};
+  bool singlePrecision{false};
+  bool tieredCompilation{false};
+  // the reaction terms are evaluated for all pixels in one batch call
+  bool batch{true};
 
 public:
+  // the expressions are parsed here, but only compiled by compile(): this
+  // can be called concurrently for different ReacEval objects
   ReacEval() = default;
   ReacEval(const model::Model &doc, const std::vector<std::string> &speciesID,
            const std::vector<std::string> &reactionID,
            double reactionScaleFactor = 1.0, bool doCSE = true,
            unsigned optLevel = 3, bool timeDependent = false,
            bool spaceDependent = false,
-           const std::map<std::string, double, std::less<>> &substitutions = {});
+           const std::map<std::string, double, std::less<>> &substitutions = {},
+           bool singlePrecision = false, bool jacobian = false,
+           bool tieredCompilation = false,
+           const std::vector<std::string> &runtimeParameters = {});
   ReacEval(ReacEval &&) noexcept = default;
   ReacEval(const ReacEval &) = delete;
   ReacEval &operator=(ReacEval &&) noexcept = default;
   ReacEval &operator=(const ReacEval &) = delete;
   ~ReacEval() = default;
+  void compile();
   void evaluate(double *output, const double *input) const;
+  // evaluate at n locations with interleaved input and output arrays
+  void evaluate(double *output, const double *input, std::size_t n,
+                std::size_t outputStride, std::size_t inputStride) const;
+  // single precision versions: require singlePrecision
+  void evaluate(float *output, const float *input) const;
+  void evaluate(float *output, const float *input, std::size_t n,
+                std::size_t outputStride, std::size_t inputStride) const;
+  // switch to the compiled reaction terms if they are ready (see
+  // tieredCompilation): returns true if they are in use
+  bool updateTieredCompilation();
 };
 
-class SimCompartment {
+template <typename Real> class SimCompartment {
 private:
   ReacEval reacEval;
+  // reaction Jacobian d(dcdt_i)/dc_j, row-major, always in double precision:
+  // only compiled for the BDF integrator & steady state solver
+  ReacEval jacEval;
+  bool hasJacobian{false};
+  // block diagonal approximation to the Jacobian of dcdt, and the LU factors
+  // & pivots of shift - J: one nSpecies x nSpecies block for each state pixel
+  std::vector<double> jacobianBlocks;
+  std::vector<double> precondLU;
+  std::vector<std::size_t> precondPivots;
   // species concentrations & corresponding dcdt values
-  // ordering: ix, species
-  std::vector<double> conc;
-  std::vector<double> dcdt;
-  std::vector<double> s2;
-  std::vector<double> s3;
+  // ordering: ix, species (or species, ix if speciesMajor)
+  std::vector<Real> conc;
+  std::vector<Real> dcdt;
+  std::vector<Real> s2;
+  std::vector<Real> s3;
+  // new concentrations from a fused RK substep
+  std::vector<Real> concNext;
+  // dcdt at the start of an RKL step
+  std::vector<Real> dcdt0;
+  // membrane contribution to dcdt, held constant in multirate steps
+  std::vector<Real> membraneFlux;
+  // dense output: concentrations & dcdt at the start of the last step, dcdt
+  // at the end of the step, and the interpolated concentrations
+  std::vector<Real> denseC0;
+  std::vector<Real> denseF0;
+  std::vector<Real> denseF1;
+  std::vector<Real> denseConc;
+  bool denseOutputActive{false};
+  // concentrations to be returned by getConcentrations
+  const std::vector<Real> &outputConcentrations() const;
   // dimensionless diffusion constants for each species
-  std::vector<double> diffConstants;
+  std::vector<Real> diffConstants;
+  // indices & diffusion constants of the species that diffuse: the diffusion
+  // kernels skip all other species
+  std::vector<std::size_t> diffusingSpeciesIndices;
+  std::vector<Real> diffusingSpeciesConstants;
   const geometry::Compartment *comp;
   std::size_t nPixels;
   std::size_t nSpecies;
+  // spatially uniform: every pixel has the same state, so only a single
+  // representative pixel is stored & integrated, and it is broadcast to all
+  // pixels when the concentrations are read. Checked when the concentrations
+  // are set, and by collapseIfUniform while the state is integrated
+  bool uniform{false};
+  // uniform states remain uniform: no spatial dependence, and either no
+  // membrane fluxes or only non-spatial species
+  bool canBeUniform{false};
+  // number of pixels in the internal state arrays: 1 if uniform
+  std::size_t nStatePixels;
+  bool isUniformConcentration(const std::vector<double> &concentrations) const;
+  void setUniform(bool uniformState);
   std::string compartmentId;
   std::vector<std::string> speciesIds;
   std::vector<std::string> speciesNames;
   std::vector<std::size_t> nonSpatialSpeciesIndices;
   double maxStableTimestep = std::numeric_limits<double>::max();
+  // weights for the RMS error norm: 1 / (errAbs + errRel |c|)
+  double errAbs{0};
+  double errRel{1};
+  // see PixelOptions::uniformTolerance
+  double uniformTolerance{0};
+  PixelStepError stepError(double c, double cOld, double cLower,
+                           double epsilon) const;
+  // time & spatial coordinates are passed to the reactions as extra inputs
+  bool timeDependent{false};
+  bool spaceDependent{false};
+  std::size_t nExtraVars{0};
+  double time{0};
+  // physical x, y coordinates of each pixel, only used if spaceDependent
+  std::vector<double> pixelCoordinates;
+  // values of the runtime parameters: extra inputs after t,x,y
+  std::vector<double> parameterValues;
+  // write t,x,y & runtime parameters for pixel ix to extra
+  template <typename T> void setExtraInputs(std::size_t ix, T *extra) const;
+  bool speciesMajor{false};
+  std::size_t pixelStride{0};
+  std::size_t speciesStride{1};
+  void setStrides();
+  // neighbours of each pixel in the order +x, -x, +y, -y
+  const std::uint32_t *neighbours{nullptr};
+  inline std::size_t up_x(std::size_t i) const { return neighbours[4 * i]; }
+  inline std::size_t dn_x(std::size_t i) const {
+    return neighbours[4 * i + 1];
+  }
+  inline std::size_t up_y(std::size_t i) const {
+    return neighbours[4 * i + 2];
+  }
+  inline std::size_t dn_y(std::size_t i) const {
+    return neighbours[4 * i + 3];
+  }
+  // if pixels are renumbered: compartment pixel index of each pixel
+  std::vector<std::size_t> pixelOrder;
+  std::vector<std::size_t> pixelOrderInverse;
+  std::vector<std::uint32_t> reorderedNeighbours;
+  // contiguous range of pixels: if `structured`, every pixel i in the range
+  // is an interior pixel with neighbours i+upOffset, i-dnOffset, i+1, i-1
+  struct StencilRun {
+    std::size_t begin;
+    std::size_t end;
+    std::size_t upOffset;
+    std::size_t dnOffset;
+    bool structured;
+  };
+  std::vector<StencilRun> stencilRuns;
+  void findStencilRuns();
+  inline std::size_t compartmentPixel(std::size_t ix) const {
+    return pixelOrder.empty() ? ix : pixelOrder[ix];
+  }
+  // sorted indices of pixels that receive a flux from a membrane
+  std::vector<std::size_t> membranePixels;
+  // activity tracking: a tile of pixels where all |dcdt| are below
+  // activityTolerance is frozen, i.e. has dcdt = 0 and is not evaluated,
+  // until a neighbouring pixel changes enough to change its dcdt
+  double activityTolerance{0};
+  std::vector<char> tileFrozen;
+  // tiles containing membrane pixels are never frozen
+  std::vector<char> tileCanFreeze;
+  std::size_t nFrozenTiles{0};
+  // pixels outside each tile that are neighbours of a pixel in the tile
+  std::vector<std::vector<std::size_t>> tileHalo;
+  // concentrations of the tile halo pixels when the tile was frozen
+  std::vector<std::vector<Real>> tileHaloConc;
+  void findTileHalos();
+  void updateTileActivity(std::size_t tile);
+  // call func(b, e) for each part [b, e) of [begin, end) in an active tile
+  template <typename Func>
+  void forEachActiveRange(std::size_t begin, std::size_t end,
+                          const Func &func) const;
+  // as forEachActiveRange, but skipping any membrane pixels
+  template <typename Func>
+  void forEachInteriorRange(std::size_t begin, std::size_t end,
+                            const Func &func) const;
+  double sumDcdt(std::size_t is, std::size_t begin, std::size_t end) const;
+  void setDcdt(std::size_t is, double value, std::size_t begin,
+               std::size_t end);
+  // double precision copy of src with ordering: compartment pixel, species
+  std::vector<double> toPixelMajor(const std::vector<Real> &src) const;
+  void reactionKernel(std::size_t begin, std::size_t end);
+  void diffusionKernel(std::size_t begin, std::size_t end);
+  // kernels specialised for the diffusing species, see DiffusingSpecies
+  template <typename Species>
+  void diffusionKernel(const Species &species, std::size_t begin,
+                       std::size_t end);
+  template <typename Species>
+  void diffusionKernelStructured(const Species &species, std::size_t begin,
+                                 std::size_t end, std::size_t upOffset,
+                                 std::size_t dnOffset);
+  template <typename Species>
+  void diffusionKernelGather(const Species &species, std::size_t begin,
+                             std::size_t end);
+  void fusedRKUpdate(double dt, double g1, double g2, double g3, double beta,
+                     double delta, std::size_t begin, std::size_t end);
+  // conjugate gradient work arrays for the implicit diffusion solve: always
+  // double precision
+  std::vector<double> cgX;
+  std::vector<double> cgR;
+  std::vector<double> cgP;
+  std::vector<double> cgAp;
+  // c = (1 - dt D)^{-1} c, where D is the diffusion operator
+  void solveImplicitDiffusion(double dt, std::vector<Real> &c, bool useTBB);
+  void doIMEXSubstep1(double dt, bool useTBB);
+  void doIMEXSubstep2(double dt, bool useTBB);
 
 public:
   explicit SimCompartment(
       const model::Model &doc, const geometry::Compartment *compartment,
-      std::vector<std::string> sIds, bool doCSE = true, unsigned optLevel = 3,
+      std::vector<std::string> sIds, const PixelOptions &options = {},
       bool timeDependent = false, bool spaceDependent = false,
-      const std::map<std::string, double, std::less<>> &substitutions = {});
+      const std::map<std::string, double, std::less<>> &substitutions = {},
+      bool reactionJacobian = false,
+      const std::vector<std::pair<std::string, double>> &runtimeParameters =
+          {});
   SimCompartment(SimCompartment &&) noexcept = default;
   SimCompartment(const SimCompartment &) = delete;
   SimCompartment &operator=(SimCompartment &&) noexcept = default;
@@ -93,7 +269,25 @@ public:
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
   void evaluateReactions_tbb();
 #endif
+  // dcdt from reactions (and diffusion) split into the membrane pixels and
+  // all other pixels, which write to disjoint parts of dcdt: membrane fluxes
+  // can then be added while the interior is still being evaluated. The state
+  // pixel of a uniform compartment with membranes counts as a membrane pixel
+  void evaluateMembranePixels(bool includeDiffusion);
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  void evaluateInteriorPixels_tbb(bool includeDiffusion);
+#endif
+  // reductions use a fixed partition of the pixels, so results do not
+  // depend on the number of threads, and are accumulated in double precision
   void spatiallyAverageDcdt();
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  void spatiallyAverageDcdt_tbb();
+#endif
+  // multirate: store membrane contribution to dcdt from a zero dcdt,
+  // then add it to dcdt in each substep of this compartment
+  void clearDcdt();
+  void storeMembraneFlux();
+  void addMembraneFlux();
   void doForwardsEulerTimestep(double dt, std::size_t begin, std::size_t end);
   void doForwardsEulerTimestep(double dt);
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
@@ -118,50 +312,203 @@ public:
   void doRKSubstep_tbb(double dt, double g1, double g2, double g3, double beta,
                        double delta);
 #endif
-  void doRKFinalise(double cFactor, double s2Factor, double s3Factor,
-                    std::size_t begin, std::size_t end);
-  void doRKFinalise(double cFactor, double s2Factor, double s3Factor);
+  bool canFuseRKSubstep() const;
+  // freeze tiles where dcdt is below the activity tolerance & wake frozen
+  // tiles with changed neighbours: called after each accepted step
+  void updateActivity(std::size_t beginTile, std::size_t endTile);
+  void updateActivity();
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  void updateActivity_tbb();
+#endif
+  void addMembranePixels(const std::vector<std::size_t> &pixelIndices);
+  // reactions + diffusion + RK substep in a single pass over the pixels,
+  // for all pixels except membrane pixels: new concentrations are only
+  // applied in finaliseFusedRKSubstep, after the membrane contributions.
+  // If skipMembranePixels, dcdt of the membrane pixels is not evaluated
+  // either, see evaluateMembranePixels
+  void doFusedRKSubstep(double dt, double g1, double g2, double g3,
+                        double beta, double delta, std::size_t begin,
+                        std::size_t end, bool skipMembranePixels);
+  void doFusedRKSubstep(double dt, double g1, double g2, double g3,
+                        double beta, double delta);
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  void doFusedRKSubstep_tbb(double dt, double g1, double g2, double g3,
+                            double beta, double delta,
+                            bool skipMembranePixels);
+#endif
+  void finaliseFusedRKSubstep(double dt, double g1, double g2, double g3,
+                              double beta, double delta);
+  // IMEX Euler step with implicit diffusion & explicit reactions, using
+  // step doubling for the error estimate: dcdt must not include diffusion
+  // substep1: s2 = full step, conc = first half step from s3
+  void doIMEXSubstep1(double dt);
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  void doIMEXSubstep1_tbb(double dt);
+#endif
+  // substep2: conc = second half step
+  void doIMEXSubstep2(double dt);
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
-  void doRKFinalise_tbb(double cFactor, double s2Factor, double s3Factor);
+  void doIMEXSubstep2_tbb(double dt);
+#endif
+  // RKL2 super-time-stepping: s2 = previous stage, s3 = initial conc
+  // first stage: conc += muTilde dt dcdt
+  void doRKLStage1(double dt, double muTilde);
+  // later stages: conc = mu conc + nu s2 + (1 - mu - nu) s3
+  //                      + muTilde dt dcdt + gammaTilde dt dcdt0
+  void doRKLStage(double dt, double mu, double nu, double muTilde,
+                  double gammaTilde, std::size_t begin, std::size_t end);
+  void doRKLStage(double dt, double mu, double nu, double muTilde,
+                  double gammaTilde);
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  void doRKLStage_tbb(double dt, double mu, double nu, double muTilde,
+                      double gammaTilde);
+#endif
+  // store conc - error estimate in s2, using dcdt at the end of the step
+  void doRKLFinalise(double dt);
+  // dense output over the last step, from c0 = s3 & c1 = conc, using cubic
+  // Hermite interpolation: the dcdt at each end are evaluated by the caller
+  // begin: conc = c0
+  void beginDenseOutput();
+  // store dcdt at c0, then restore conc = c1
+  void storeDenseOutputStart();
+  // store dcdt at c1
+  void storeDenseOutputEnd();
+  // getConcentrations returns the interpolated concentrations at
+  // t0 + theta dt until the next step
+  void interpolateDenseOutput(double theta, double dt);
+  void clearDenseOutput();
+  // s2 = lower order solution, returns the error estimate from
+  // calculateRKError without an extra pass over the arrays
+  PixelStepError doRKFinalise(double cFactor, double s2Factor,
+                              double s3Factor, double epsilon,
+                              std::size_t begin, std::size_t end);
+  PixelStepError doRKFinalise(double cFactor, double s2Factor,
+                              double s3Factor, double epsilon);
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  PixelStepError doRKFinalise_tbb(double cFactor, double s2Factor,
+                                  double s3Factor, double epsilon);
 #endif
   void undoRKStep(std::size_t begin, std::size_t end);
   void undoRKStep();
 #ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
   void undoRKStep_tbb();
 #endif
-  PixelIntegratorError calculateRKError(double epsilon) const;
+  PixelStepError calculateRKError(double epsilon, std::size_t begin,
+                                  std::size_t end) const;
+  PixelStepError calculateRKError(double epsilon) const;
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  PixelStepError calculateRKError_tbb(double epsilon) const;
+#endif
+  // error of an implicit step from c = cOld, where err is an estimate of
+  // the local error of each element of the state, ordered as given by index()
+  PixelStepError calculateStateError(const double *c, const double *cOld,
+                                     const double *err, double epsilon) const;
   std::string plotRKError(QImage &image, double epsilon, double max) const;
   const std::string &getCompartmentId() const;
   const std::vector<std::string> &getSpeciesIds() const;
-  const std::vector<double> &getConcentrations() const;
+  // compile the reaction terms: must be called before evaluating them, and
+  // can be called concurrently for different compartments & membranes
+  void compileReactions();
+  // returns true if the compiled reaction terms are in use
+  bool updateTieredCompilation();
+  // new values of the runtime parameters, in the order given to the
+  // constructor
+  void setRuntimeParameters(const std::vector<double> &values);
+  // set time used when evaluating time-dependent reactions
+  void setTime(double t);
+  double getTime() const;
+  // physical x, y coordinates of pixel `ix`
+  const double *getPixelCoordinates(std::size_t ix) const;
+  // index of the pixel used internally for compartment pixel `i`
+  inline std::size_t getPixelIndex(std::size_t i) const {
+    return pixelOrderInverse.empty() ? i : pixelOrderInverse[i];
+  }
+  // index of species `is` at pixel `ix` in the internal state arrays
+  inline std::size_t index(std::size_t ix, std::size_t is) const {
+    return ix * pixelStride + is * speciesStride;
+  }
+  // internal state arrays, ordered as given by index()
+  const std::vector<Real> &getStateConcentrations() const;
+  std::vector<Real> &getStateDcdt();
+  // true if a single pixel is integrated on behalf of all pixels
+  bool isUniform() const;
+  // switch to a single uniform pixel if every pixel is within
+  // PixelOptions::uniformTolerance of the spatial average: returns true if
+  // it did, in which case any integrator state must be discarded
+  bool collapseIfUniform();
+  // number of tiles currently skipped by activity tracking
+  std::size_t getFrozenTiles() const;
+  // set the internal state arrays, ordered as given by index()
+  void setStateConcentrations(const double *stateConc);
+  // largest max|dcdt| / max|c| of any species, using the current dcdt
+  double getDcdtNorm() const;
+  // evaluate the block diagonal Jacobian J at the current concentrations:
+  // the reaction Jacobian plus the diagonal of the diffusion operator at each
+  // pixel, returns false if the reaction Jacobian was not compiled
+  bool updateJacobian();
+  // factorise shift - J at each pixel, using the last evaluated J
+  void factoriseJacobian(double shift);
+  // preconditioner for implicit solves: x = (shift - J)^{-1} x, with x
+  // ordered as given by index()
+  void applyPreconditioner(double *x) const;
+  // concentrations & dcdt with ordering: ix, species. These are returned by
+  // value, so no double precision copy of the state is kept
+  std::vector<double> getConcentrations() const;
   void setConcentrations(const std::vector<double> &);
   double getLowerOrderConcentration(std::size_t speciesIndex,
                                     std::size_t pixelIndex) const;
   const std::vector<QPoint> &getPixels() const;
-  std::vector<double> &getDcdt();
+  std::vector<double> getDcdt() const;
   double getMaxStableTimestep() const;
 };
 
-class SimMembrane {
+template <typename Real> class SimMembrane {
 private:
   ReacEval reacEval;
   const geometry::Membrane *membrane;
-  SimCompartment *compA;
-  SimCompartment *compB;
+  SimCompartment<Real> *compA;
+  SimCompartment<Real> *compB;
+  // pairs of pixel indices in compA, compB, grouped by colour: within a
+  // colour no pixel appears in more than one pair, so the pairs in
+  // [colourOffsets[i], colourOffsets[i+1]) can be evaluated in parallel
+  std::vector<std::pair<std::size_t, std::size_t>> indexPairs;
+  std::vector<std::size_t> colourOffsets;
+  void colourIndexPairs();
+  bool timeDependent{false};
+  bool spaceDependent{false};
   std::size_t nExtraVars{0};
+  std::vector<double> parameterValues;
 
 public:
   SimMembrane(const model::Model &doc, const geometry::Membrane *membrane_ptr,
-              SimCompartment *simCompA, SimCompartment *simCompB,
+              SimCompartment<Real> *simCompA, SimCompartment<Real> *simCompB,
               bool doCSE = true, unsigned optLevel = 3,
               bool timeDependent = false, bool spaceDependent = false,
-              const std::map<std::string, double, std::less<>> &substitutions = {});
+              const std::map<std::string, double, std::less<>> &substitutions = {},
+              bool tieredCompilation = false,
+              const std::vector<std::pair<std::string, double>>
+                  &runtimeParameters = {});
   SimMembrane(SimMembrane &&) noexcept = default;
   SimMembrane(const SimMembrane &) = delete;
   SimMembrane &operator=(SimMembrane &&) noexcept = default;
   SimMembrane &operator=(const SimMembrane &) = delete;
   ~SimMembrane() = default;
+  void evaluateReactions(std::size_t begin, std::size_t end);
   void evaluateReactions();
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  void evaluateReactions_tbb();
+#endif
+  const SimCompartment<Real> *getCompartmentA() const;
+  const SimCompartment<Real> *getCompartmentB() const;
+  const std::vector<std::pair<std::size_t, std::size_t>> &
+  getIndexPairs() const;
+  const std::vector<std::size_t> &getColourOffsets() const;
+  // compile the reaction terms, see SimCompartment::compileReactions
+  void compileReactions();
+  // see SimCompartment::setRuntimeParameters
+  void setRuntimeParameters(const std::vector<double> &values);
+  // returns true if the compiled reaction terms are in use
+  bool updateTieredCompilation();
 };
 
 } // namespace simulate
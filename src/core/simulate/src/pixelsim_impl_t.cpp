@@ -0,0 +1,185 @@
+#include "catch_wrapper.hpp"
+#include "geometry.hpp"
+#include "model.hpp"
+#include "pixelsim_impl.hpp"
+#include <QFile>
+#include <algorithm>
+#include <array>
+#include <set>
+
+using namespace sme;
+
+static model::Model getVerySimpleModel() {
+  model::Model m;
+  QFile f(":/models/very-simple-model.xml");
+  f.open(QIODevice::ReadOnly);
+  m.importSBMLString(f.readAll().toStdString());
+  return m;
+}
+
+static const geometry::Membrane *getMembrane(const model::Model &m,
+                                             const std::string &id) {
+  const auto &membranes{m.getMembranes().getMembranes()};
+  auto iter{std::find_if(membranes.cbegin(), membranes.cend(),
+                         [&id](const auto &mem) { return mem.getId() == id; })};
+  REQUIRE(iter != membranes.cend());
+  return &(*iter);
+}
+
+SCENARIO("Pixel simulator: SimMembrane",
+         "[core/simulate/pixelsim_impl][core/simulate][core][pixel]") {
+  auto m{getVerySimpleModel()};
+  const auto &options{m.getSimulationSettings().options.pixel};
+  simulate::SimCompartment<double> c2(
+      m, m.getCompartments().getCompartment("c2"), {"A_c2", "B_c2"}, options);
+  simulate::SimCompartment<double> c3(
+      m, m.getCompartments().getCompartment("c3"), {"A_c3", "B_c3"}, options);
+  simulate::SimMembrane<double> membrane(
+      m, getMembrane(m, "c2_c3_membrane"), &c2, &c3, options.doCSE,
+      options.optLevel);
+  c2.compileReactions();
+  c3.compileReactions();
+  membrane.compileReactions();
+  // initial concentrations are zero: use non-uniform concentrations instead
+  for (auto *c : {&c2, &c3}) {
+    auto conc{c->getConcentrations()};
+    for (std::size_t i = 0; i < conc.size(); ++i) {
+      conc[i] = 1.0 + 0.1 * static_cast<double>(i % 7);
+    }
+    c->setConcentrations(conc);
+  }
+  const auto &indexPairs{membrane.getIndexPairs()};
+  const auto &colourOffsets{membrane.getColourOffsets()};
+  // pixels at a corner of the membrane are in more than one pair
+  REQUIRE(colourOffsets.size() > 2);
+  REQUIRE(colourOffsets.front() == 0);
+  REQUIRE(colourOffsets.back() == indexPairs.size());
+  WHEN("index pairs are coloured") {
+    THEN("no pixel of A or B appears twice within a colour") {
+      for (std::size_t c = 0; c + 1 < colourOffsets.size(); ++c) {
+        CAPTURE(c);
+        REQUIRE(colourOffsets[c] < colourOffsets[c + 1]);
+        std::set<std::size_t> pixelsA;
+        std::set<std::size_t> pixelsB;
+        for (std::size_t i = colourOffsets[c]; i < colourOffsets[c + 1];
+             ++i) {
+          const auto &[ixA, ixB]{indexPairs[i]};
+          REQUIRE(pixelsA.insert(ixA).second);
+          REQUIRE(pixelsB.insert(ixB).second);
+        }
+      }
+    }
+  }
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+  WHEN("membrane fluxes are evaluated in parallel") {
+    THEN("they are the same as the serial membrane fluxes") {
+      c2.clearDcdt();
+      c3.clearDcdt();
+      membrane.evaluateReactions();
+      auto dcdt2{c2.getDcdt()};
+      auto dcdt3{c3.getDcdt()};
+      REQUIRE(std::any_of(dcdt2.cbegin(), dcdt2.cend(),
+                          [](double d) { return d != 0.0; }));
+      c2.clearDcdt();
+      c3.clearDcdt();
+      membrane.evaluateReactions_tbb();
+      // each pixel gets at most one flux per colour, added in colour order
+      REQUIRE(c2.getDcdt() == dcdt2);
+      REQUIRE(c3.getDcdt() == dcdt3);
+    }
+  }
+#endif
+}
+
+struct RKCoefficients {
+  std::vector<double> g1;
+  std::vector<double> g2;
+  std::vector<double> g3;
+  std::vector<double> beta;
+  std::vector<double> delta;
+};
+
+// concentrations of c2 & c3 after the RK substeps of a step of length dt,
+// using the same sequence of calls as PixelSim::doRKSubstep
+static std::array<std::vector<double>, 2>
+doRKSubsteps(const model::Model &m, const RKCoefficients &rk, double dt,
+             bool fused) {
+  const auto &options{m.getSimulationSettings().options.pixel};
+  simulate::SimCompartment<double> c2(
+      m, m.getCompartments().getCompartment("c2"), {"A_c2", "B_c2"}, options);
+  simulate::SimCompartment<double> c3(
+      m, m.getCompartments().getCompartment("c3"), {"A_c3", "B_c3"}, options);
+  simulate::SimMembrane<double> membrane(
+      m, getMembrane(m, "c2_c3_membrane"), &c2, &c3, options.doCSE,
+      options.optLevel);
+  std::array<simulate::SimCompartment<double> *, 2> comps{&c2, &c3};
+  for (auto *c : comps) {
+    c->compileReactions();
+    REQUIRE(c->canFuseRKSubstep());
+    auto conc{c->getConcentrations()};
+    for (std::size_t i = 0; i < conc.size(); ++i) {
+      conc[i] = 1.0 + 0.1 * static_cast<double>(i % 7);
+    }
+    c->setConcentrations(conc);
+    c->doRKInit();
+  }
+  membrane.compileReactions();
+  for (std::size_t i = 0; i < rk.g1.size(); ++i) {
+    const double g1{rk.g1[i]};
+    const double g2{rk.g2[i]};
+    const double g3{rk.g3[i]};
+    const double beta{rk.beta[i]};
+    const double delta{rk.delta[i]};
+    for (auto *c : comps) {
+      if (fused) {
+        c->doFusedRKSubstep(dt, g1, g2, g3, beta, delta);
+      } else {
+        c->evaluateReactions();
+        c->evaluateDiffusionOperator();
+      }
+    }
+    membrane.evaluateReactions();
+    for (auto *c : comps) {
+      if (fused) {
+        c->finaliseFusedRKSubstep(dt, g1, g2, g3, beta, delta);
+      } else {
+        c->spatiallyAverageDcdt();
+        c->doRKSubstep(dt, g1, g2, g3, beta, delta);
+      }
+    }
+  }
+  return {c2.getConcentrations(), c3.getConcentrations()};
+}
+
+SCENARIO("Pixel simulator: fused RK substeps",
+         "[core/simulate/pixelsim_impl][core/simulate][core][pixel]") {
+  auto m{getVerySimpleModel()};
+  // same coefficients as getRK323 and getRK435 in pixelsim.cpp
+  const RKCoefficients rk323{{1.0, 0.25, 0.666666666666666666666},
+                             {0.0, 0.0, 0.0},
+                             {0.0, 0.75, 0.333333333333333333333},
+                             {1.0, 0.25, 0.6666666666666666666},
+                             {0.0, 0.0, 1.0}};
+  const RKCoefficients rk435{
+      {0.0, -0.497531095840104, 1.010070514199942, -3.196559004608766,
+       1.717835630267259},
+      {1.0, 1.384996869124138, 3.878155713328178, -2.324512951813145,
+       -0.514633322274467},
+      {0.0, 0.0, 0.0, 1.642598936063715, 0.188295940828347},
+      {0.075152045700771, 0.211361016946069, 1.100713347634329,
+       0.728537814675568, 0.393172889823198},
+      {1.0, 0.081252332929194, -1.083849060586449, -1.096110881845602,
+       2.859440022030827}};
+  for (const auto *rk : {&rk323, &rk435}) {
+    CAPTURE(rk->g1.size());
+    // membrane pixels are updated after the membrane fluxes are added, all
+    // other pixels while their dcdt is being evaluated: same arithmetic as
+    // evaluating all of dcdt first, so the results are identical
+    auto unfused{doRKSubsteps(m, *rk, 0.01, false)};
+    auto fused{doRKSubsteps(m, *rk, 0.01, true)};
+    REQUIRE(fused[0] == unfused[0]);
+    REQUIRE(fused[1] == unfused[1]);
+    // no substeps: initial concentrations
+    REQUIRE(fused[0] != doRKSubsteps(m, RKCoefficients{}, 0.01, true)[0]);
+  }
+}
@@ -9,6 +9,7 @@
 #include "utils.hpp"
 #include <QElapsedTimer>
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <numeric>
 #include <utility>
@@ -119,7 +120,7 @@ void Simulation::applyNextEvent() {
           utils::element_index(compartmentSpeciesIds[compIndex], sId)};
       SPDLOG_INFO("    species[{}] = {}", speciesIndex, sId);
       auto &c{data->concentration.back()[compIndex]};
-      const std::size_t stride{simulator->getConcentrationPadding() +
+      const std::size_t stride{data->concPadding.back() +
                                compartmentSpeciesIds[compIndex].size()};
       SPDLOG_INFO("    stride = {}", stride);
       for (std::size_t iPixel = 0; iPixel < tempConc.size(); ++iPixel) {
@@ -127,7 +128,18 @@ void Simulation::applyNextEvent() {
       }
     }
   }
+  // continue with the existing simulator if it can apply the new parameters
+  if (simulator->restart(eventSubstitutions)) {
+    ++nSimulatorRestarts;
+    simEvents.pop();
+    return;
+  }
   // re-init simulator
+  if (const auto *s = dynamic_cast<PixelSim *>(simulator.get());
+      s != nullptr) {
+    nPreviousAcceptedSteps += s->getAcceptedSteps();
+    nPreviousDiscardedSteps += s->getDiscardedSteps();
+  }
   simulator.reset();
   if (settings->simulatorType == SimulatorType::DUNE &&
       model.getGeometry().getMesh() != nullptr &&
@@ -182,8 +194,9 @@ void Simulation::updateConcentrations(double t) {
   for (std::size_t compIndex = 0; compIndex < compartments.size();
        ++compIndex) {
     std::size_t nSpecies{compartmentSpeciesIds[compIndex].size()};
-    const auto &compConcs{simulator->getConcentrations(compIndex)};
-    c.push_back(compConcs);
+    // moved straight into the new frame: no other copy is kept
+    const auto &compConcs{
+        c.emplace_back(simulator->getConcentrations(compIndex))};
     a.push_back(
         calculateAvgMinMax(compConcs, nSpecies, data->concPadding.back()));
     auto &maxS{data->concentrationMax.back()[compIndex]};
@@ -193,6 +206,63 @@ void Simulation::updateConcentrations(double t) {
   }
 }
 
+double Simulation::getDifferenceQuotientNorm() const {
+  // dc/dt from the change in concentration since the previous time point
+  const std::size_t n{data->timePoints.size()};
+  if (n < 2) {
+    return std::numeric_limits<double>::max();
+  }
+  const double dt{data->timePoints[n - 1] - data->timePoints[n - 2]};
+  double norm{0};
+  for (std::size_t ci = 0; ci < compartments.size(); ++ci) {
+    const auto &c0{data->concentration[n - 2][ci]};
+    const auto &c1{data->concentration[n - 1][ci]};
+    std::size_t nSpecies{compartmentSpeciesIds[ci].size()};
+    std::size_t stride0{nSpecies + data->concPadding[n - 2]};
+    std::size_t stride1{nSpecies + data->concPadding[n - 1]};
+    std::size_t nPixels{compartments[ci]->nPixels()};
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      double maxDcdt{0};
+      double maxConc{0};
+      for (std::size_t ix = 0; ix < nPixels; ++ix) {
+        double c{c1[ix * stride1 + is]};
+        maxDcdt = std::max(maxDcdt, std::abs(c - c0[ix * stride0 + is]) / dt);
+        maxConc = std::max(maxConc, std::abs(c));
+      }
+      if (maxConc > 0) {
+        maxDcdt /= maxConc;
+      }
+      norm = std::max(norm, maxDcdt);
+    }
+  }
+  return norm;
+}
+
+bool Simulation::checkSteadyState() {
+  const auto &options{settings->options.steadyState};
+  auto *pixelSim{dynamic_cast<PixelSim *>(simulator.get())};
+  if (pixelSim == nullptr) {
+    dcdtNorm = getDifferenceQuotientNorm();
+  } else {
+    dcdtNorm = pixelSim->getDcdtNorm();
+    if (!(dcdtNorm < options.tolerance) && options.newtonKrylov &&
+        pixelSim->solveSteadyState(options.tolerance,
+                                   options.maxNewtonIterations)) {
+      // the steady state is not the state at this time point: store it
+      // separately, the simulation data keeps the concentrations at time t
+      steadyStateConcentration.clear();
+      for (std::size_t compIndex = 0; compIndex < compartments.size();
+           ++compIndex) {
+        steadyStateConcentration.push_back(
+            pixelSim->getSteadyStateConcentrations(compIndex));
+      }
+      dcdtNorm = pixelSim->getSteadyStateDcdtNorm();
+    }
+  }
+  SPDLOG_INFO("t={}, dc/dt norm {}", data->timePoints.back(), dcdtNorm);
+  return dcdtNorm < options.tolerance;
+}
+
 Simulation::Simulation(model::Model &model)
     : model(model), settings(&model.getSimulationSettings()),
       data{&model.getSimulationData()},
@@ -237,6 +307,8 @@ std::size_t Simulation::doMultipleTimesteps(
     double timeout_ms) {
   isRunning.store(true);
   stopRequested.store(false);
+  steadyStateReached = false;
+  steadyStateConcentration.clear();
   if (data->timePoints.empty()) {
     updateConcentrations(0);
     ++nCompletedTimesteps;
@@ -306,6 +378,17 @@ std::size_t Simulation::doMultipleTimesteps(
       }
       updateConcentrations(data->timePoints.back() + time);
       ++nCompletedTimesteps;
+      // a steady state is only final if there are no more events
+      if (settings->options.steadyState.tolerance > 0 &&
+          simEvents.front().time == std::numeric_limits<double>::max() &&
+          checkSteadyState()) {
+        SPDLOG_INFO("steady state reached: stopping simulation");
+        steadyStateReached = true;
+        isRunning.store(false);
+        stopRequested.store(false);
+        simulator->setStopRequested(false);
+        return steps;
+      }
     }
   }
   isRunning.store(false);
@@ -359,16 +442,13 @@ std::vector<double> Simulation::getConc(std::size_t timeIndex,
   return c;
 }
 
-std::vector<double> Simulation::getConcArray(std::size_t timeIndex,
-                                             std::size_t compartmentIndex,
-                                             std::size_t speciesIndex) const {
+static std::vector<double>
+toConcArray(const std::vector<double> &compConc,
+            const geometry::Compartment *comp, std::size_t stride,
+            std::size_t speciesIndex, const QSize &imageSize) {
   std::vector<double> c(
       static_cast<std::size_t>(imageSize.width() * imageSize.height()), 0.0);
-  const auto &compConc = data->concentration[timeIndex][compartmentIndex];
-  const auto &comp = compartments[compartmentIndex];
   std::size_t nPixels = comp->nPixels();
-  std::size_t nSpecies = compartmentSpeciesIds[compartmentIndex].size();
-  std::size_t stride{nSpecies + data->concPadding[timeIndex]};
   for (std::size_t ix = 0; ix < nPixels; ++ix) {
     const auto &point = comp->getPixel(ix);
     auto arrayIndex{static_cast<std::size_t>(
@@ -378,6 +458,16 @@ std::vector<double> Simulation::getConcArray(std::size_t timeIndex,
   return c;
 }
 
+std::vector<double> Simulation::getConcArray(std::size_t timeIndex,
+                                             std::size_t compartmentIndex,
+                                             std::size_t speciesIndex) const {
+  std::size_t nSpecies = compartmentSpeciesIds[compartmentIndex].size();
+  std::size_t stride{nSpecies + data->concPadding[timeIndex]};
+  return toConcArray(data->concentration[timeIndex][compartmentIndex],
+                     compartments[compartmentIndex], stride, speciesIndex,
+                     imageSize);
+}
+
 void Simulation::applyConcsToModel(model::Model &m,
                                    std::size_t timeIndex) const {
   for (std::size_t iCompartment = 0; iCompartment < compartmentIds.size();
@@ -395,7 +485,7 @@ std::vector<double> Simulation::getDcdt(std::size_t compartmentIndex,
                                         std::size_t speciesIndex) const {
   std::vector<double> c;
   if (auto *s = dynamic_cast<PixelSim *>(simulator.get()); s != nullptr) {
-    const auto &compDcdt = s->getDcdt(compartmentIndex);
+    const auto compDcdt{s->getDcdt(compartmentIndex)};
     std::size_t nPixels = compartments[compartmentIndex]->nPixels();
     std::size_t nSpecies = compartmentSpeciesIds[compartmentIndex].size();
     c.reserve(nPixels);
@@ -519,9 +609,9 @@ Simulation::getPyConcs(std::size_t timeIndex) const {
   for (std::size_t ci = 0; ci < compartmentSpeciesIds.size(); ++ci) {
     const auto &pixels = compartments[ci]->getPixels();
     const auto &conc = data->concentration[timeIndex][ci];
-    const std::vector<double> *dcdt{nullptr};
+    std::vector<double> dcdt;
     if (getDcdt) {
-      dcdt = &(pixelSim->getDcdt(ci));
+      dcdt = pixelSim->getDcdt(ci);
     }
     std::size_t nSpecies = compartmentSpeciesIds[ci].size();
     std::size_t stride{nSpecies + data->concPadding[timeIndex]};
@@ -532,7 +622,7 @@ Simulation::getPyConcs(std::size_t timeIndex) const {
       for (std::size_t is : compartmentSpeciesIndices[ci]) {
         vecPyConcs[ci][is][y][x] = conc[ix * stride + is];
         if (getDcdt) {
-          vecPyDcdts[ci][is][y][x] = (*dcdt)[ix * stride + is];
+          vecPyDcdts[ci][is][y][x] = dcdt[ix * stride + is];
         }
       }
     }
@@ -554,6 +644,82 @@ std::size_t Simulation::getNCompletedTimesteps() const {
   return nCompletedTimesteps;
 }
 
+std::size_t Simulation::getAcceptedSteps() const {
+  if (const auto *s = dynamic_cast<PixelSim *>(simulator.get());
+      s != nullptr) {
+    return nPreviousAcceptedSteps + s->getAcceptedSteps();
+  }
+  return nPreviousAcceptedSteps;
+}
+
+std::size_t Simulation::getDiscardedSteps() const {
+  if (const auto *s = dynamic_cast<PixelSim *>(simulator.get());
+      s != nullptr) {
+    return nPreviousDiscardedSteps + s->getDiscardedSteps();
+  }
+  return nPreviousDiscardedSteps;
+}
+
+std::size_t Simulation::getSimulatorRestarts() const {
+  return nSimulatorRestarts;
+}
+
+double Simulation::getDcdtNorm() const { return dcdtNorm; }
+
+bool Simulation::getIsSteadyState() const { return steadyStateReached; }
+
+bool Simulation::getHasSteadyStateConcs() const {
+  return !steadyStateConcentration.empty();
+}
+
+std::vector<double>
+Simulation::getSteadyStateConcArray(std::size_t compartmentIndex,
+                                    std::size_t speciesIndex) const {
+  // the pixel simulator has no concentration padding
+  return toConcArray(steadyStateConcentration[compartmentIndex],
+                     compartments[compartmentIndex],
+                     compartmentSpeciesIds[compartmentIndex].size(),
+                     speciesIndex, imageSize);
+}
+
+void Simulation::applySteadyStateConcsToModel(model::Model &m) const {
+  for (std::size_t iCompartment = 0; iCompartment < compartmentIds.size();
+       ++iCompartment) {
+    const auto &speciesIds{getSpeciesIds(iCompartment)};
+    for (std::size_t iSpecies = 0; iSpecies < speciesIds.size(); ++iSpecies) {
+      m.getSpecies().setSampledFieldConcentration(
+          speciesIds[iSpecies].c_str(),
+          getSteadyStateConcArray(iCompartment, iSpecies));
+    }
+  }
+}
+
+std::map<std::string, std::vector<std::vector<double>>>
+Simulation::getPySteadyStateConcs() const {
+  using PyConc = std::vector<std::vector<double>>;
+  std::map<std::string, PyConc> pyConcs;
+  if (steadyStateConcentration.empty()) {
+    return pyConcs;
+  }
+  PyConc zeros = PyConc(
+      static_cast<std::size_t>(imageSize.height()),
+      std::vector<double>(static_cast<std::size_t>(imageSize.width()), 0.0));
+  for (std::size_t ci = 0; ci < compartmentSpeciesIds.size(); ++ci) {
+    const auto &pixels = compartments[ci]->getPixels();
+    const auto &conc = steadyStateConcentration[ci];
+    std::size_t nSpecies = compartmentSpeciesIds[ci].size();
+    for (std::size_t is : compartmentSpeciesIndices[ci]) {
+      auto &pyConc{pyConcs[compartmentSpeciesNames[ci][is]] = zeros};
+      for (std::size_t ix = 0; ix < pixels.size(); ++ix) {
+        const QPoint &p = pixels[ix];
+        pyConc[static_cast<std::size_t>(p.y())][static_cast<std::size_t>(
+            p.x())] = conc[ix * nSpecies + is];
+      }
+    }
+  }
+  return pyConcs;
+}
+
 const SimulationData &Simulation::getSimulationData() const { return *data; }
 
 bool Simulation::getIsRunning() const { return isRunning.load(); }
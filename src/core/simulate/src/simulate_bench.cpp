@@ -1,6 +1,11 @@
 #include "bench.hpp"
+#include "pde.hpp"
 #include "simulate.hpp"
 #include "simulate_options.hpp"
+#include "symbolic.hpp"
+#include "utils.hpp"
+#include <utility>
+#include <vector>
 
 using namespace sme;
 
@@ -27,6 +32,66 @@ static void simulate_SimulationPIXEL(benchmark::State &state) {
   }
 }
 
+template <typename T>
+static void simulate_Pde(benchmark::State &state) {
+  T data;
+  // reaction terms & Jacobian of the first compartment
+  const auto &compartmentId{data.model.getCompartments().getIds()[0]};
+  auto speciesIds{
+      utils::toStdString(data.model.getSpecies().getIds(compartmentId))};
+  auto reactionIds{
+      utils::toStdString(data.model.getReactions().getIds(compartmentId))};
+  for (auto _ : state) {
+    simulate::Pde pde(&data.model, speciesIds, reactionIds);
+  }
+}
+
+// compiled reaction terms of the first compartment, and inputs for them
+template <typename T> struct ReactionTerms {
+  static constexpr std::size_t nPoints{4096};
+  T data;
+  utils::Symbolic sym;
+  std::size_t nSpecies{0};
+  std::vector<double> vars;
+  std::vector<double> results;
+  ReactionTerms() {
+    const auto &compartmentId{data.model.getCompartments().getIds()[0]};
+    auto speciesIds{
+        utils::toStdString(data.model.getSpecies().getIds(compartmentId))};
+    auto reactionIds{
+        utils::toStdString(data.model.getReactions().getIds(compartmentId))};
+    simulate::Pde pde(&data.model, speciesIds, reactionIds);
+    sym = std::move(pde).takeSymbolicRHS();
+    sym.compile(true, 3, true);
+    nSpecies = speciesIds.size();
+    vars.resize(nSpecies * nPoints);
+    for (std::size_t i = 0; i < vars.size(); ++i) {
+      vars[i] = 1.0 + 0.001 * static_cast<double>(i % 997);
+    }
+    results.resize(nSpecies * nPoints);
+  }
+};
+
+template <typename T>
+static void simulate_ReactionTerms_point(benchmark::State &state) {
+  ReactionTerms<T> r;
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < r.nPoints; ++i) {
+      r.sym.eval(r.results.data() + i * r.nSpecies,
+                 r.vars.data() + i * r.nSpecies);
+    }
+  }
+}
+
+template <typename T>
+static void simulate_ReactionTerms_batch(benchmark::State &state) {
+  ReactionTerms<T> r;
+  for (auto _ : state) {
+    r.sym.eval(r.results.data(), r.vars.data(), r.nPoints, r.nSpecies,
+               r.nSpecies);
+  }
+}
+
 template <typename T>
 static void simulate_Simulation_getConcImage(benchmark::State &state) {
   T data;
@@ -39,4 +104,7 @@ static void simulate_Simulation_getConcImage(benchmark::State &state) {
 
 SME_BENCHMARK(simulate_SimulationDUNE);
 SME_BENCHMARK(simulate_SimulationPIXEL);
+SME_BENCHMARK(simulate_Pde);
+SME_BENCHMARK(simulate_ReactionTerms_point);
+SME_BENCHMARK(simulate_ReactionTerms_batch);
 SME_BENCHMARK(simulate_Simulation_getConcImage);
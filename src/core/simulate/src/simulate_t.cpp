@@ -1,16 +1,21 @@
 #include "catch_wrapper.hpp"
 #include "mesh.hpp"
 #include "model.hpp"
+#include "pixelsim.hpp"
 #include "qt_test_utils.hpp"
 #include "sbml_test_data/very_simple_model.hpp"
 #include "serialization.hpp"
 #include "simulate.hpp"
 #include "simulate_options.hpp"
+#include "symbolic.hpp"
 #include "utils.hpp"
 #include <QFile>
 #include <algorithm>
 #include <cmath>
+#include <functional>
 #include <future>
+#include <memory>
+#include <numeric>
 #include <sbml/SBMLDocument.h>
 #include <sbml/SBMLReader.h>
 #include <sbml/SBMLWriter.h>
@@ -985,6 +990,237 @@ SCENARIO("Pixel simulator: brusselator model, RK2, RK3, RK4",
   }
 }
 
+SCENARIO("Pixel simulator: multithreaded results do not depend on threads",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  model::Model s;
+  if (QFile f(":/models/brusselator-model.xml"); f.open(QIODevice::ReadOnly)) {
+    s.importSBMLString(f.readAll().toStdString());
+  }
+  auto &options{s.getSimulationSettings().options};
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 0.01};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  // IMEX: the conjugate gradient dot products are reductions
+  for (auto integrator : {simulate::PixelIntegratorType::RK435,
+                          simulate::PixelIntegratorType::IMEX}) {
+    CAPTURE(integrator);
+    options.pixel.integrator = integrator;
+    options.pixel.enableMultiThreading = false;
+    s.getSimulationData().clear();
+    simulate::Simulation sim(s);
+    sim.doTimesteps(10.0);
+    REQUIRE(sim.errorMessage().empty());
+    auto c1 = sim.getConc(sim.getTimePoints().size() - 1, 0, 0);
+    for (std::size_t maxThreads : {2, 3}) {
+      options.pixel.enableMultiThreading = true;
+      options.pixel.maxThreads = maxThreads;
+      s.getSimulationData().clear();
+      simulate::Simulation sim2(s);
+      sim2.doTimesteps(10.0);
+      CAPTURE(maxThreads);
+      REQUIRE(sim2.getTimePoints().size() == sim.getTimePoints().size());
+      REQUIRE(sim2.getConc(sim2.getTimePoints().size() - 1, 0, 0) == c1);
+    }
+  }
+}
+
+#ifdef SPATIAL_MODEL_EDITOR_WITH_TBB
+SCENARIO("Pixel simulator: TBB task graph with membranes",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  // the membrane fluxes are evaluated while the interior pixels of their
+  // compartments are still being updated: each pixel must be evaluated
+  // exactly as in the serial version
+  const std::vector<std::string> compartmentIds{"c1", "c2", "c3"};
+  const std::vector<std::vector<std::string>> speciesIds{
+      {"B_c1"}, {"A_c2", "B_c2"}, {"A_c3", "B_c3"}};
+  for (auto integrator : {simulate::PixelIntegratorType::RK323,
+                          simulate::PixelIntegratorType::RK435}) {
+    // with a non-spatial species the RK substep is not fused
+    for (bool fused : {true, false}) {
+      CAPTURE(integrator);
+      CAPTURE(fused);
+      auto s{getVerySimpleModel()};
+      if (!fused) {
+        s.getSpecies().setIsSpatial("B_c2", false);
+      }
+      auto &options{s.getSimulationSettings().options};
+      options.pixel.integrator = integrator;
+      options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-3};
+      options.pixel.enableMultiThreading = false;
+      simulate::PixelSim serial(s, compartmentIds, speciesIds);
+      serial.run(0.2, -1);
+      REQUIRE(serial.errorMessage().empty());
+      options.pixel.enableMultiThreading = true;
+      simulate::PixelSim threaded(s, compartmentIds, speciesIds);
+      threaded.run(0.2, -1);
+      REQUIRE(threaded.errorMessage().empty());
+      for (std::size_t ic = 0; ic < compartmentIds.size(); ++ic) {
+        CAPTURE(ic);
+        REQUIRE(threaded.getConcentrations(ic) == serial.getConcentrations(ic));
+        REQUIRE(threaded.getDcdt(ic) == serial.getDcdt(ic));
+      }
+    }
+  }
+}
+#endif
+
+SCENARIO("Pixel simulator: single precision",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  model::Model s;
+  if (QFile f(":/models/brusselator-model.xml"); f.open(QIODevice::ReadOnly)) {
+    s.importSBMLString(f.readAll().toStdString());
+  }
+  auto &options{s.getSimulationSettings().options};
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-3};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  for (auto integrator : {simulate::PixelIntegratorType::RK212,
+                          simulate::PixelIntegratorType::RK435}) {
+    CAPTURE(integrator);
+    options.pixel.integrator = integrator;
+    options.pixel.singlePrecision = false;
+    s.getSimulationData().clear();
+    simulate::Simulation sim(s);
+    sim.doTimesteps(5.0);
+    REQUIRE(sim.errorMessage().empty());
+    auto c = sim.getConc(sim.getTimePoints().size() - 1, 0, 0);
+    options.pixel.singlePrecision = true;
+    s.getSimulationData().clear();
+    simulate::Simulation sim2(s);
+    sim2.doTimesteps(5.0);
+    REQUIRE(sim2.errorMessage().empty());
+    auto c2 = sim2.getConc(sim2.getTimePoints().size() - 1, 0, 0);
+    REQUIRE(c2.size() == c.size());
+    double cMax{*std::max_element(c.cbegin(), c.cend())};
+    for (std::size_t i = 0; i < c.size(); ++i) {
+      REQUIRE(std::abs(c2[i] - c[i]) / cMax < 1e-2);
+    }
+  }
+}
+
+SCENARIO("Pixel simulator: brusselator model, IMEX, RKL2",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  double eps{1e-20};
+  double time{10.0};
+  double maxAllowedRelErr{0.02};
+  model::Model s;
+  if (QFile f(":/models/brusselator-model.xml"); f.open(QIODevice::ReadOnly)) {
+    s.importSBMLString(f.readAll().toStdString());
+  }
+  auto &options{s.getSimulationSettings().options};
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-6};
+  options.pixel.integrator = simulate::PixelIntegratorType::RK435;
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  simulate::Simulation sim(s);
+  sim.doTimesteps(time);
+  auto c4_accurate = sim.getConc(sim.getTimePoints().size() - 1, 0, 0);
+  for (bool multithreaded : {false, true}) {
+    for (auto integrator : {simulate::PixelIntegratorType::IMEX,
+                            simulate::PixelIntegratorType::RKL2}) {
+      CAPTURE(multithreaded);
+      CAPTURE(integrator);
+      options.pixel.integrator = integrator;
+      options.pixel.enableMultiThreading = multithreaded;
+      options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-3};
+      s.getSimulationData().clear();
+      simulate::Simulation sim2(s);
+      sim2.doTimesteps(time);
+      REQUIRE(sim2.errorMessage().empty());
+      auto conc = sim2.getConc(sim.getTimePoints().size() - 1, 0, 0);
+      double maxRelDiff{0};
+      for (std::size_t i = 0; i < conc.size(); ++i) {
+        maxRelDiff = std::max(maxRelDiff, std::abs(conc[i] - c4_accurate[i]) /
+                                              (c4_accurate[i] + eps));
+      }
+      CAPTURE(maxRelDiff);
+      REQUIRE(maxRelDiff < maxAllowedRelErr);
+    }
+  }
+}
+
+SCENARIO("Pixel simulator: non-diffusing species",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto m{getModel(":/models/ABtoC.xml")};
+  m.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  m.getReactions().setRateExpression("r1", "0");
+  m.getSpecies().setDiffusionConstant("B", 0.0);
+  auto &options{m.getSimulationSettings().options};
+  for (bool speciesMajor : {false, true}) {
+    CAPTURE(speciesMajor);
+    options.pixel.speciesMajorLayout = speciesMajor;
+    m.getSimulationData().clear();
+    simulate::Simulation sim(m);
+    sim.doTimesteps(0.1, 2);
+    REQUIRE(sim.errorMessage().empty());
+    // B does not diffuse: unchanged at every pixel
+    auto b0{sim.getConc(0, 0, 1)};
+    auto b2{sim.getConc(2, 0, 1)};
+    REQUIRE(b0.size() == b2.size());
+    for (std::size_t i = 0; i < b0.size(); ++i) {
+      REQUIRE(b2[i] == dbl_approx(b0[i]));
+    }
+    // A diffuses: changes, but total amount is conserved
+    auto a0{sim.getConc(0, 0, 0)};
+    auto a2{sim.getConc(2, 0, 0)};
+    REQUIRE(a2 != a0);
+    REQUIRE(std::accumulate(a2.cbegin(), a2.cend(), 0.0) ==
+            dbl_approx(std::accumulate(a0.cbegin(), a0.cend(), 0.0)));
+  }
+}
+
+SCENARIO("Pixel simulator: concentration layout and pixel ordering",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  for (const auto &filename :
+       {":/models/very-simple-model.xml", ":/test/models/txy.xml"}) {
+    CAPTURE(filename);
+    auto m{getModel(filename)};
+    auto &options{m.getSimulationSettings().options};
+    m.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+    options.pixel.integrator = simulate::PixelIntegratorType::RK323;
+    options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-3};
+    options.pixel.speciesMajorLayout = false;
+    options.pixel.mortonOrdering = false;
+    simulate::Simulation sim1(m);
+    sim1.doMultipleTimesteps({{2, 0.05}});
+    REQUIRE(sim1.errorMessage().empty());
+    auto data1{m.getSimulationData()};
+    for (auto [speciesMajor, morton] :
+         {std::pair{true, false}, {false, true}, {true, true}}) {
+      CAPTURE(speciesMajor);
+      CAPTURE(morton);
+      m.getSimulationData().clear();
+      options.pixel.speciesMajorLayout = speciesMajor;
+      options.pixel.mortonOrdering = morton;
+      simulate::Simulation sim2(m);
+      sim2.doMultipleTimesteps({{2, 0.05}});
+      REQUIRE(sim2.errorMessage().empty());
+      const auto &data2{m.getSimulationData()};
+      // same results, returned in the same pixel-major compartment ordering
+      REQUIRE(data1.size() == data2.size());
+      for (std::size_t i = 0; i < data1.size(); ++i) {
+        REQUIRE(data1.concentration[i].size() ==
+                data2.concentration[i].size());
+        for (std::size_t ic = 0; ic < data1.concentration[i].size(); ++ic) {
+          const auto &c1{data1.concentration[i][ic]};
+          const auto &c2{data2.concentration[i][ic]};
+          REQUIRE(c1.size() == c2.size());
+          for (std::size_t j = 0; j < c1.size(); ++j) {
+            REQUIRE(c1[j] == dbl_approx(c2[j]));
+          }
+        }
+      }
+      for (std::size_t ic = 0; ic < sim1.getCompartmentIds().size(); ++ic) {
+        for (std::size_t is = 0; is < sim1.getSpeciesIds(ic).size(); ++is) {
+          auto d1{sim1.getDcdt(ic, is)};
+          auto d2{sim2.getDcdt(ic, is)};
+          REQUIRE(d1.size() == d2.size());
+          for (std::size_t j = 0; j < d1.size(); ++j) {
+            REQUIRE(d1[j] == dbl_approx(d2[j]));
+          }
+        }
+      }
+    }
+  }
+}
+
 SCENARIO("DUNE: simulation",
          "[core/simulate/simulate][core/simulate][core][simulate][dune]") {
   GIVEN("ABtoC model") {
@@ -1179,6 +1415,541 @@ static double rel_diff(const std::vector<double> &a,
   return d / n / norm;
 }
 
+// two simulations of a model, without & with some option
+struct OptionComparison {
+  std::unique_ptr<simulate::Simulation> sim1;
+  std::unique_ptr<simulate::Simulation> sim2;
+  // results of sim1: the results of sim2 are in the model
+  simulate::SimulationData data1;
+};
+
+// simulate nSteps of length dt after calling setOption(model, false), then
+// again after calling setOption(model, true), and require the concentrations
+// at each time point to agree to within tolerance
+static OptionComparison
+compareWithOption(model::Model &m,
+                  const std::function<void(model::Model &, bool)> &setOption,
+                  std::size_t nSteps, double dt, double tolerance) {
+  OptionComparison result;
+  setOption(m, false);
+  m.getSimulationData().clear();
+  result.sim1 = std::make_unique<simulate::Simulation>(m);
+  result.sim1->doTimesteps(dt, nSteps);
+  REQUIRE(result.sim1->errorMessage().empty());
+  result.data1 = m.getSimulationData();
+  setOption(m, true);
+  m.getSimulationData().clear();
+  result.sim2 = std::make_unique<simulate::Simulation>(m);
+  result.sim2->doTimesteps(dt, nSteps);
+  REQUIRE(result.sim2->errorMessage().empty());
+  const auto &data1{result.data1};
+  const auto &data2{m.getSimulationData()};
+  REQUIRE(data1.size() == data2.size());
+  for (std::size_t i = 1; i < data1.size(); ++i) {
+    CAPTURE(i);
+    REQUIRE(data2.timePoints[i] == dbl_approx(data1.timePoints[i]));
+    REQUIRE(rel_diff(data1, data2, i, i) < tolerance);
+  }
+  return result;
+}
+
+SCENARIO("Pixel simulator: multirate RK101",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getVerySimpleModel()};
+  // make compartment c3 much stiffer than c1, c2
+  s.getSpecies().setDiffusionConstant("B_c3", 60.0);
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  s.getSimulationSettings().options.pixel.integrator =
+      simulate::PixelIntegratorType::RK101;
+  auto sims{compareWithOption(
+      s,
+      [](model::Model &m, bool enable) {
+        m.getSimulationSettings().options.pixel.multirate = enable;
+      },
+      2, 0.5, 1e-2)};
+  // only c3 is limited to its small stable timestep: the other compartments
+  // take far fewer, longer steps
+  REQUIRE(sims.sim2->getAcceptedSteps() < sims.sim1->getAcceptedSteps());
+}
+
+SCENARIO("Pixel simulator: multirate adaptive RK",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getVerySimpleModel()};
+  // make compartment c3 much stiffer than c1, c2
+  s.getSpecies().setDiffusionConstant("B_c3", 60.0);
+  auto &options{s.getSimulationSettings().options};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-3};
+  for (auto integrator : {simulate::PixelIntegratorType::RK212,
+                          simulate::PixelIntegratorType::RK323,
+                          simulate::PixelIntegratorType::RK435}) {
+    CAPTURE(integrator);
+    options.pixel.integrator = integrator;
+    auto sims{compareWithOption(
+        s,
+        [](model::Model &m, bool enable) {
+          m.getSimulationSettings().options.pixel.multirate = enable;
+        },
+        2, 0.5, 1e-2)};
+    // c3 takes many short error controlled steps within each step of c1, c2
+    REQUIRE(sims.sim2->getAcceptedSteps() < sims.sim1->getAcceptedSteps());
+  }
+}
+
+SCENARIO("Pixel simulator: tiered compilation",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getVerySimpleModel()};
+  auto &options{s.getSimulationSettings().options};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  options.pixel.integrator = simulate::PixelIntegratorType::RK323;
+  if (!utils::isSymbolicThreadSafe()) {
+    WARN("SymEngine is not thread-safe: tiered compilation compiles the "
+         "reaction terms before the simulation starts, so the interpreter "
+         "is not used");
+  }
+  for (bool singlePrecision : {false, true}) {
+    CAPTURE(singlePrecision);
+    options.pixel.singlePrecision = singlePrecision;
+    // interpreted reaction terms until compiled ones are ready: same results
+    auto sims{compareWithOption(
+        s,
+        [](model::Model &m, bool enable) {
+          m.getSimulationSettings().options.pixel.tieredCompilation = enable;
+        },
+        2, 0.5, 1e-6)};
+    // the interpreted terms only differ by rounding errors, so the step size
+    // control makes (almost) the same choices
+    REQUIRE(static_cast<double>(sims.sim2->getAcceptedSteps()) ==
+            Catch::Approx(static_cast<double>(sims.sim1->getAcceptedSteps()))
+                .margin(1.0));
+  }
+}
+
+SCENARIO("Pixel simulator: runtime parameters",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  // brusselator model has events at t=25 and t=50 that change parameter k2
+  auto s{getBrusselatorModel()};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  s.getSimulationSettings().options.pixel.integrator =
+      simulate::PixelIntegratorType::RK323;
+  // k2 passed to the reaction terms at runtime instead of re-compiling them
+  auto sims{compareWithOption(
+      s,
+      [](model::Model &m, bool enable) {
+        m.getSimulationSettings().options.pixel.runtimeParameters = enable;
+      },
+      3, 20, 1e-2)};
+  REQUIRE(sims.sim1->getSimulatorRestarts() == 0);
+  // both events applied without replacing the simulator
+  REQUIRE(sims.sim2->getSimulatorRestarts() == 2);
+}
+
+SCENARIO("Pixel simulator: runtime parameters with species events",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getVerySimpleModel()};
+  // without reactions there are no membranes, so compartments with uniform
+  // initial concentrations are integrated as a single pixel
+  for (const auto &id : {"A_uptake", "A_transport", "A_B_conversion",
+                         "B_transport", "B_excretion"}) {
+    s.getReactions().remove(id);
+  }
+  s.getSpecies().setInitialConcentration("B_c1", 1.0);
+  // event makes the uniform compartment spatially varying
+  auto &events{s.getEvents()};
+  events.add("eB_c1", "B_c1");
+  events.setExpression("eB_c1", "1 + 0.1*x");
+  events.setTime("eB_c1", 0.05);
+  auto &options{s.getSimulationSettings().options};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  for (auto integrator : {simulate::PixelIntegratorType::RK101,
+                          simulate::PixelIntegratorType::BDF}) {
+    CAPTURE(integrator);
+    options.pixel.integrator = integrator;
+    // event applied by restarting the existing simulator
+    auto sims{compareWithOption(
+        s,
+        [](model::Model &m, bool enable) {
+          m.getSimulationSettings().options.pixel.runtimeParameters = enable;
+        },
+        2, 0.1, 1e-2)};
+    REQUIRE(sims.sim2->getSimulatorRestarts() == 1);
+    // B_c1 is no longer uniform after the event
+    auto c{sims.sim2->getConc(2, 0, 0)};
+    REQUIRE(*std::max_element(c.cbegin(), c.cend()) >
+            *std::min_element(c.cbegin(), c.cend()));
+  }
+}
+
+SCENARIO("Pixel simulator: skip inactive tiles",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  model::Model s;
+  if (QFile f(":/models/single-compartment-diffusion.xml");
+      f.open(QIODevice::ReadOnly)) {
+    s.importSBMLString(f.readAll().toStdString());
+  }
+  auto &options{s.getSimulationSettings().options};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 0.01};
+  options.pixel.mortonOrdering = true;
+  for (auto integrator : {simulate::PixelIntegratorType::RK101,
+                          simulate::PixelIntegratorType::RK323}) {
+    CAPTURE(integrator);
+    options.pixel.integrator = integrator;
+    compareWithOption(
+        s,
+        [](model::Model &m, bool enable) {
+          m.getSimulationSettings().options.pixel.activityTolerance =
+              enable ? 1e-8 : 0.0;
+        },
+        2, 5.0, 1e-4);
+    // tiles far from the initial concentration peaks were skipped
+    simulate::PixelSim sim(s, {"circle"}, {{"slow", "fast"}});
+    REQUIRE(sim.errorMessage().empty());
+    sim.run(5.0, -1);
+    REQUIRE(sim.errorMessage().empty());
+    REQUIRE(sim.getFrozenTiles(0) > 0);
+  }
+}
+
+SCENARIO("Pixel simulator: skip inactive tiles with uniform initial "
+         "concentrations",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  // all compartments have uniform initial concentrations, and become spatial
+  // when their membranes are added
+  auto s{getVerySimpleModel()};
+  auto &options{s.getSimulationSettings().options};
+  options.pixel.integrator = simulate::PixelIntegratorType::RK101;
+  options.pixel.activityTolerance = 1e-8;
+  s.getSimulationData().clear();
+  simulate::PixelSim sim(s, {"c1", "c2", "c3"},
+                         {{"B_c1"}, {"A_c2", "B_c2"}, {"A_c3", "B_c3"}});
+  REQUIRE(sim.errorMessage().empty());
+  sim.run(0.1, -1);
+  REQUIRE(sim.errorMessage().empty());
+  // B_c1 only changes near the membrane: the rest of c1 is skipped
+  REQUIRE(sim.getFrozenTiles(0) > 0);
+}
+
+SCENARIO("Pixel simulator: spatially uniform compartment",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getModel(":/models/circadian-clock.xml")};
+  auto &options{s.getSimulationSettings().options};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-6};
+  for (auto integrator : {simulate::PixelIntegratorType::RK101,
+                          simulate::PixelIntegratorType::RK323,
+                          simulate::PixelIntegratorType::IMEX}) {
+    CAPTURE(integrator);
+    options.pixel.integrator = integrator;
+    options.pixel.maxTimestep = 0.01;
+    // uniform initial concentrations: integrated as a single pixel, vs a
+    // small perturbation of a single pixel: integrated as separate pixels
+    auto sims{compareWithOption(
+        s,
+        [](model::Model &m, bool perturb) {
+          auto *field{m.getSpecies().getField("Mt")};
+          field->setUniformConcentration(0.918544);
+          if (perturb) {
+            field->setConcentration(0, 0.918544 * (1.0 + 1e-6));
+          }
+        },
+        2, 1.0, 1e-6)};
+    // uniform result is broadcast to every pixel
+    const auto &data1{sims.data1};
+    const std::size_t nSpecies{sims.sim1->getSpeciesIds(0).size()};
+    const std::size_t stride{nSpecies + data1.concPadding.back()};
+    const auto &c1{data1.concentration.back()[0]};
+    for (std::size_t is = 0; is < nSpecies; ++is) {
+      for (std::size_t i = is; i < c1.size(); i += stride) {
+        REQUIRE(c1[i] == c1[is]);
+      }
+    }
+    // the perturbed compartment is never collapsed to its average
+    for (std::size_t it = 1; it < 3; ++it) {
+      CAPTURE(it);
+      bool isSpatial{false};
+      for (std::size_t is = 0; is < nSpecies; ++is) {
+        auto c2{sims.sim2->getConc(it, 0, is)};
+        isSpatial = isSpatial || *std::max_element(c2.cbegin(), c2.cend()) >
+                                     *std::min_element(c2.cbegin(), c2.cend());
+      }
+      REQUIRE(isSpatial);
+    }
+  }
+}
+
+SCENARIO("Pixel simulator: uniform compartment with membrane reactions",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getVerySimpleModel()};
+  // all species in c2 are non-spatial: dc/dt is spatially averaged, so c2
+  // remains uniform despite the membrane fluxes into it
+  s.getSpecies().setIsSpatial("A_c2", false);
+  s.getSpecies().setIsSpatial("B_c2", false);
+  auto &options{s.getSimulationSettings().options};
+  options.pixel.integrator = simulate::PixelIntegratorType::RK323;
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-6};
+  const std::vector<std::string> compartmentIds{"c1", "c2", "c3"};
+  const std::vector<std::vector<std::string>> speciesIds{
+      {"B_c1"}, {"A_c2", "B_c2"}, {"A_c3", "B_c3"}};
+  simulate::PixelSim sim(s, compartmentIds, speciesIds);
+  REQUIRE(sim.errorMessage().empty());
+  REQUIRE(sim.getIsUniform(1) == true);
+  // spatial species with membranes
+  REQUIRE(sim.getIsUniform(0) == false);
+  REQUIRE(sim.getIsUniform(2) == false);
+  sim.run(0.5, -1);
+  REQUIRE(sim.errorMessage().empty());
+  REQUIRE(sim.getIsUniform(1) == true);
+  // tiny perturbation of a single pixel: c2 integrated as separate pixels
+  auto *field{s.getSpecies().getField("A_c2")};
+  field->setConcentration(0, field->getConcentration()[0] + 1e-12);
+  simulate::PixelSim sim2(s, compartmentIds, speciesIds);
+  REQUIRE(sim2.errorMessage().empty());
+  REQUIRE(sim2.getIsUniform(1) == false);
+  sim2.run(0.5, -1);
+  REQUIRE(sim2.errorMessage().empty());
+  for (std::size_t ic = 0; ic < compartmentIds.size(); ++ic) {
+    CAPTURE(ic);
+    REQUIRE(rel_diff(sim.getConcentrations(ic), sim2.getConcentrations(ic)) <
+            1e-6);
+  }
+}
+
+SCENARIO("Pixel simulator: compartment becomes uniform",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getModel(":/models/ABtoC.xml")};
+  s.getReactions().setRateExpression("r1", "0");
+  for (const auto &id : {"A", "B", "C"}) {
+    s.getSpecies().setInitialConcentration(id, 1.0);
+  }
+  // small perturbation of a single pixel, smoothed out by diffusion
+  auto *field{s.getSpecies().getField("A")};
+  field->setConcentration(0, 1.0 + 1e-5);
+  auto &options{s.getSimulationSettings().options};
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 0.005};
+  WHEN("no uniform tolerance") {
+    simulate::PixelSim sim(s, {"comp"}, {{"A", "B", "C"}});
+    REQUIRE(sim.errorMessage().empty());
+    REQUIRE(sim.getIsUniform(0) == false);
+    sim.run(1.0, -1);
+    REQUIRE(sim.errorMessage().empty());
+    // only approaches a uniform state: still integrated pixel by pixel
+    REQUIRE(sim.getIsUniform(0) == false);
+  }
+  options.pixel.uniformTolerance = 1e-3;
+  simulate::PixelSim sim(s, {"comp"}, {{"A", "B", "C"}});
+  REQUIRE(sim.errorMessage().empty());
+  REQUIRE(sim.getIsUniform(0) == false);
+  sim.run(1.0, -1);
+  REQUIRE(sim.errorMessage().empty());
+  // checked at the output time: collapsed to the spatial average
+  REQUIRE(sim.getIsUniform(0) == true);
+  const auto c{sim.getConcentrations(0)};
+  const double nPixels{static_cast<double>(c.size() / 3)};
+  for (std::size_t i = 0; i < c.size(); i += 3) {
+    REQUIRE(c[i] == dbl_approx(1.0 + 1e-5 / nPixels));
+    REQUIRE(c[i + 1] == dbl_approx(1.0));
+    REQUIRE(c[i + 2] == dbl_approx(1.0));
+  }
+}
+
+SCENARIO("Pixel simulator: PI controller and RMS error norm",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getModel(":/models/circadian-clock.xml")};
+  auto &options{s.getSimulationSettings().options};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  options.pixel.integrator = simulate::PixelIntegratorType::RK323;
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-3};
+  for (auto [piController, rmsErrorNorm] :
+       {std::pair{true, false}, {false, true}, {true, true}}) {
+    CAPTURE(piController);
+    CAPTURE(rmsErrorNorm);
+    auto sims{compareWithOption(
+        s,
+        [pi = piController, rms = rmsErrorNorm](model::Model &m,
+                                                bool enable) {
+          auto &o{m.getSimulationSettings().options.pixel};
+          o.piController = enable && pi;
+          o.rmsErrorNorm = enable && rms;
+        },
+        2, 20.0, 1e-2)};
+    REQUIRE(sims.sim2->getAcceptedSteps() > 0);
+    // the RMS norm is weaker than requiring every pixel to satisfy maxErr,
+    // and the PI controller smooths the step size sequence: both avoid
+    // steps being rejected
+    REQUIRE(sims.sim2->getDiscardedSteps() <= sims.sim1->getDiscardedSteps());
+  }
+}
+
+SCENARIO("Pixel simulator: dense output",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getModel(":/models/circadian-clock.xml")};
+  auto &options{s.getSimulationSettings().options};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-3};
+  for (auto integrator : {simulate::PixelIntegratorType::RK212,
+                          simulate::PixelIntegratorType::RK323}) {
+    CAPTURE(integrator);
+    options.pixel.integrator = integrator;
+    // many short output intervals: without dense output every step is cut
+    // short at each output time, with dense output the outputs are
+    // interpolated at the same time points
+    auto sims{compareWithOption(
+        s,
+        [](model::Model &m, bool enable) {
+          m.getSimulationSettings().options.pixel.denseOutput = enable;
+        },
+        40, 0.25, 1e-2)};
+    REQUIRE(sims.sim2->getAcceptedSteps() > 0);
+    REQUIRE(sims.sim2->getAcceptedSteps() <= sims.sim1->getAcceptedSteps());
+  }
+}
+
+SCENARIO("Pixel simulator: BDF integrator",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  auto s{getModel(":/models/ABtoC.xml")};
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  auto &options{s.getSimulationSettings().options};
+  WHEN("stiff reactions") {
+    // fast reversible A + B <-> C, from A = B = 1, C = 0:
+    // equilibrium has A = B, C = 1 - A, A^2 = 0.1 (1 - A)
+    s.getSpecies().setInitialConcentration("A", 1.0);
+    s.getSpecies().setInitialConcentration("B", 1.0);
+    s.getReactions().setRateExpression("r1", "1000*(A*B - 0.1*C)");
+    const double A{0.5 * (std::sqrt(0.41) - 0.1)};
+    options.pixel.integrator = simulate::PixelIntegratorType::RK323;
+    simulate::Simulation sim1(s);
+    sim1.doTimesteps(1.0, 1);
+    REQUIRE(sim1.errorMessage().empty());
+    options.pixel.integrator = simulate::PixelIntegratorType::BDF;
+    s.getSimulationData().clear();
+    simulate::Simulation sim2(s);
+    sim2.doTimesteps(1.0, 1);
+    REQUIRE(sim2.errorMessage().empty());
+    // explicit steps are limited by stability, implicit steps are not
+    REQUIRE(sim2.getAcceptedSteps() > 0);
+    REQUIRE(sim2.getAcceptedSteps() < sim1.getAcceptedSteps() / 10);
+    for (std::size_t is = 0; is < 2; ++is) {
+      REQUIRE(sim2.getAvgMinMax(1, 0, is).avg ==
+              Catch::Approx(A).epsilon(1e-3));
+    }
+  }
+  WHEN("reactions & diffusion") {
+    options.pixel.maxErr = {std::numeric_limits<double>::max(), 1e-3};
+    auto sims{compareWithOption(
+        s,
+        [](model::Model &m, bool bdf) {
+          m.getSimulationSettings().options.pixel.integrator =
+              bdf ? simulate::PixelIntegratorType::BDF
+                  : simulate::PixelIntegratorType::RK435;
+        },
+        2, 0.5, 1e-2)};
+    REQUIRE(sims.sim2->getAcceptedSteps() > 0);
+    // A + B -> C conserves A + C up to the Newton solver tolerance
+    for (std::size_t it = 1; it < 3; ++it) {
+      CAPTURE(it);
+      REQUIRE(sims.sim2->getAvgMinMax(it, 0, 0).avg +
+                  sims.sim2->getAvgMinMax(it, 0, 2).avg ==
+              Catch::Approx(1.0).epsilon(1e-3));
+    }
+  }
+}
+
+SCENARIO("Pixel simulator: steady state",
+         "[core/simulate/simulate][core/simulate][core][simulate][pixel]") {
+  // reversible A + B <-> C, from A = B = 1, C = 0:
+  // steady state has A = B, C = 1 - A, A^2 = 1 - A
+  auto s{getModel(":/models/ABtoC.xml")};
+  s.getSpecies().setInitialConcentration("A", 1.0);
+  s.getSpecies().setInitialConcentration("B", 1.0);
+  s.getReactions().setRateExpression("r1", "k1*A*B - 0.1*C");
+  s.getSimulationSettings().simulatorType = simulate::SimulatorType::Pixel;
+  auto &options{s.getSimulationSettings().options};
+  options.steadyState.tolerance = 1e-4;
+  const double A{0.5 * (std::sqrt(5.0) - 1.0)};
+  WHEN("stop when dcdt is small") {
+    simulate::Simulation sim(s);
+    sim.doTimesteps(1.0, 200);
+    REQUIRE(sim.errorMessage().empty());
+    REQUIRE(sim.getIsSteadyState() == true);
+    REQUIRE(sim.getHasSteadyStateConcs() == false);
+    REQUIRE(sim.getDcdtNorm() < 1e-4);
+    REQUIRE(sim.getTimePoints().size() < 201);
+    REQUIRE(sim.getAvgMinMax(sim.getTimePoints().size() - 1, 0, 0).avg ==
+            Catch::Approx(A).epsilon(1e-3));
+    // without a steady state tolerance: no early stop
+    options.steadyState.tolerance = 0;
+    s.getSimulationData().clear();
+    simulate::Simulation sim2(s);
+    sim2.doTimesteps(1.0, 20);
+    REQUIRE(sim2.getIsSteadyState() == false);
+    REQUIRE(sim2.getTimePoints().size() == 21);
+  }
+  WHEN("dense output: ignored") {
+    simulate::Simulation sim(s);
+    sim.doTimesteps(1.0, 200);
+    REQUIRE(sim.getIsSteadyState() == true);
+    // dc/dt is evaluated for the state at the output time, not an
+    // interpolated one: same results as without dense output
+    options.pixel.denseOutput = true;
+    s.getSimulationData().clear();
+    simulate::Simulation sim2(s);
+    sim2.doTimesteps(1.0, 200);
+    REQUIRE(sim2.errorMessage().empty());
+    REQUIRE(sim2.getIsSteadyState() == true);
+    REQUIRE(sim2.getDcdtNorm() == dbl_approx(sim.getDcdtNorm()));
+    REQUIRE(sim2.getTimePoints().size() == sim.getTimePoints().size());
+  }
+  WHEN("Newton-Krylov steady state solve") {
+    options.steadyState.newtonKrylov = true;
+    for (auto integrator : {simulate::PixelIntegratorType::RK212,
+                            simulate::PixelIntegratorType::RK101}) {
+      CAPTURE(integrator);
+      options.pixel.integrator = integrator;
+      options.pixel.maxTimestep = 0.1;
+      // concentrations at the first output time without a steady state solve
+      options.steadyState.tolerance = 0;
+      s.getSimulationData().clear();
+      simulate::Simulation simRef(s);
+      simRef.doTimesteps(1.0, 1);
+      options.steadyState.tolerance = 1e-4;
+      s.getSimulationData().clear();
+      simulate::Simulation sim(s);
+      sim.doTimesteps(1.0, 200);
+      REQUIRE(sim.errorMessage().empty());
+      REQUIRE(sim.getIsSteadyState() == true);
+      REQUIRE(sim.getHasSteadyStateConcs() == true);
+      REQUIRE(sim.getDcdtNorm() < 1e-4);
+      // steady state is found from the state at the first output time
+      REQUIRE(sim.getTimePoints().size() == 2);
+      REQUIRE(sim.getTimePoints()[1] == dbl_approx(1.0));
+      for (std::size_t is = 0; is < 2; ++is) {
+        // the output keeps the concentrations at that time
+        REQUIRE(sim.getAvgMinMax(1, 0, is).avg ==
+                dbl_approx(simRef.getAvgMinMax(1, 0, is).avg));
+        REQUIRE(sim.getAvgMinMax(1, 0, is).avg !=
+                Catch::Approx(A).epsilon(1e-3));
+        // the steady state is stored separately
+        auto c{sim.getSteadyStateConcArray(0, is)};
+        REQUIRE(*std::max_element(c.cbegin(), c.cend()) ==
+                Catch::Approx(A).epsilon(1e-3));
+      }
+      // a new simulation from the steady state stops at the first output
+      // time without a Newton-Krylov solve
+      sim.applySteadyStateConcsToModel(s);
+      s.getSimulationData().clear();
+      simulate::Simulation sim2(s);
+      sim2.doTimesteps(1.0, 200);
+      REQUIRE(sim2.getIsSteadyState() == true);
+      REQUIRE(sim2.getHasSteadyStateConcs() == false);
+      REQUIRE(sim2.getTimePoints().size() == 2);
+      s.getSpecies().setInitialConcentration("A", 1.0);
+      s.getSpecies().setInitialConcentration("B", 1.0);
+      s.getSpecies().setInitialConcentration("C", 0.0);
+    }
+  }
+}
+
 SCENARIO("applyConcsToModel initial concentrations",
          "[core/simulate/simulate][core/simulate][core][simulate]") {
   auto s{getVerySimpleModel()};
@@ -1334,6 +2105,27 @@ SCENARIO("Reactions depend on x, y, t",
     REQUIRE(maxAbsDiff < maxAllowedAbsDiff);
     REQUIRE(maxRelDiff < maxAllowedRelDiff);
   }
+  GIVEN("reaction with t-dependence: continue existing simulation") {
+    s.getSpecies().remove("A");
+    s.getSpecies().remove("B");
+    simulate::Simulation sim1{s};
+    sim1.doTimesteps(dt, 2);
+    REQUIRE(sim1.errorMessage().empty());
+    // time is not stored as a species
+    REQUIRE(s.getSimulationData().concPadding.back() == 0);
+    auto c1{sim1.getConc(2, 0, 0)};
+    s.getSimulationData().pop_back();
+    // new simulation continues from t=dt
+    simulate::Simulation sim2{s};
+    sim2.doTimesteps(dt, 1);
+    REQUIRE(sim2.errorMessage().empty());
+    REQUIRE(sim2.getNCompletedTimesteps() == 3);
+    auto c2{sim2.getConc(2, 0, 0)};
+    REQUIRE(c1.size() == c2.size());
+    for (std::size_t i = 0; i < c1.size(); ++i) {
+      REQUIRE(c1[i] == dbl_approx(c2[i]));
+    }
+  }
   GIVEN("reaction with x,y-dependence") {
     // looser tolerance: mesh distorts results
     constexpr double maxAllowedAbsDiff{0.002};
@@ -1780,6 +2572,15 @@ SCENARIO("simulate w/options & save, load, re-simulate",
     auto &options1{m1.getSimulationSettings().options};
     options1.pixel.integrator = simulate::PixelIntegratorType::RK435;
     options1.pixel.maxErr.rel = 1e-3;
+    options1.pixel.speciesMajorLayout = true;
+    options1.pixel.mortonOrdering = true;
+    options1.pixel.multirate = true;
+    options1.pixel.singlePrecision = true;
+    options1.pixel.activityTolerance = 1e-12;
+    options1.pixel.piController = true;
+    options1.pixel.rmsErrorNorm = true;
+    options1.pixel.denseOutput = true;
+    options1.steadyState.maxNewtonIterations = 7;
     options1.dune.dt = 0.009;
     options1.dune.increase = 1.44;
     m1.getSimulationSettings().simulatorType = simulatorType;
@@ -1797,6 +2598,21 @@ SCENARIO("simulate w/options & save, load, re-simulate",
             simulate::PixelIntegratorType::RK435);
     REQUIRE(m2.getSimulationSettings().options.pixel.maxErr.rel ==
             dbl_approx(1e-3));
+    REQUIRE(m2.getSimulationSettings().options.pixel.speciesMajorLayout ==
+            true);
+    REQUIRE(m2.getSimulationSettings().options.pixel.mortonOrdering == true);
+    REQUIRE(m2.getSimulationSettings().options.pixel.multirate == true);
+    REQUIRE(m2.getSimulationSettings().options.pixel.singlePrecision == true);
+    REQUIRE(m2.getSimulationSettings().options.pixel.activityTolerance ==
+            dbl_approx(1e-12));
+    REQUIRE(m2.getSimulationSettings().options.pixel.piController == true);
+    REQUIRE(m2.getSimulationSettings().options.pixel.rmsErrorNorm == true);
+    REQUIRE(m2.getSimulationSettings().options.pixel.denseOutput == true);
+    REQUIRE(m2.getSimulationSettings().options.steadyState.tolerance ==
+            dbl_approx(0.0));
+    REQUIRE(
+        m2.getSimulationSettings().options.steadyState.maxNewtonIterations ==
+        7);
     REQUIRE(m2.getSimulationSettings().options.dune.dt == dbl_approx(0.009));
     REQUIRE(m2.getSimulationSettings().options.dune.increase ==
             dbl_approx(1.44));
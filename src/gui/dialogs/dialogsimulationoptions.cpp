@@ -28,6 +28,15 @@ static int toIndex(sme::simulate::PixelIntegratorType integrator) {
   case sme::simulate::PixelIntegratorType::RK435:
     return 3;
     break;
+  case sme::simulate::PixelIntegratorType::IMEX:
+    return 4;
+    break;
+  case sme::simulate::PixelIntegratorType::RKL2:
+    return 5;
+    break;
+  case sme::simulate::PixelIntegratorType::BDF:
+    return 6;
+    break;
   default:
     return 0;
   }
@@ -47,6 +56,15 @@ static sme::simulate::PixelIntegratorType toPixelIntegratorEnum(int index) {
   case 3:
     return sme::simulate::PixelIntegratorType::RK435;
     break;
+  case 4:
+    return sme::simulate::PixelIntegratorType::IMEX;
+    break;
+  case 5:
+    return sme::simulate::PixelIntegratorType::RKL2;
+    break;
+  case 6:
+    return sme::simulate::PixelIntegratorType::BDF;
+    break;
   default:
     return sme::simulate::PixelIntegratorType::RK101;
   }
@@ -113,6 +131,8 @@ void DialogSimulationOptions::setupConnections() {
           &DialogSimulationOptions::chkPixelCSE_stateChanged);
   connect(ui->spnPixelOptLevel, qOverload<int>(&QSpinBox::valueChanged), this,
           &DialogSimulationOptions::spnPixelOptLevel_valueChanged);
+  connect(ui->chkPixelTieredCompilation, &QCheckBox::stateChanged, this,
+          &DialogSimulationOptions::chkPixelTieredCompilation_stateChanged);
   connect(ui->btnPixelReset, &QPushButton::clicked, this,
           &DialogSimulationOptions::resetPixelToDefaults);
 }
@@ -218,6 +238,7 @@ void DialogSimulationOptions::loadPixelOpts() {
     lvl = ui->spnPixelOptLevel->maximum();
   }
   ui->spnPixelOptLevel->setValue(lvl);
+  ui->chkPixelTieredCompilation->setChecked(opt.pixel.tieredCompilation);
 }
 
 void DialogSimulationOptions::cmbPixelIntegrator_currentIndexChanged(
@@ -258,6 +279,10 @@ void DialogSimulationOptions::spnPixelOptLevel_valueChanged(int value) {
   opt.pixel.optLevel = static_cast<unsigned>(value);
 }
 
+void DialogSimulationOptions::chkPixelTieredCompilation_stateChanged() {
+  opt.pixel.tieredCompilation = ui->chkPixelTieredCompilation->isChecked();
+}
+
 void DialogSimulationOptions::resetPixelToDefaults() {
   opt.pixel = sme::simulate::PixelOptions{};
   loadPixelOpts();
@@ -38,6 +38,7 @@ private:
   void spnPixelThreads_valueChanged(int value);
   void chkPixelCSE_stateChanged();
   void spnPixelOptLevel_valueChanged(int value);
+  void chkPixelTieredCompilation_stateChanged();
   void resetPixelToDefaults();
   std::unique_ptr<Ui::DialogSimulationOptions> ui;
   sme::simulate::Options opt;
@@ -26,6 +26,7 @@ SCENARIO(
   options.pixel.maxThreads = 0;
   options.pixel.doCSE = true;
   options.pixel.optLevel = 3;
+  options.pixel.tieredCompilation = false;
   DialogSimulationOptions dia(options);
   ModalWidgetTimer mwt;
   WHEN("user does nothing: unchanged") {
@@ -50,6 +51,7 @@ SCENARIO(
     REQUIRE(opt.pixel.maxThreads == 0);
     REQUIRE(opt.pixel.doCSE == true);
     REQUIRE(opt.pixel.optLevel == 3);
+    REQUIRE(opt.pixel.tieredCompilation == false);
   }
   WHEN("user changes Dune values") {
     mwt.addUserAction({"Tab", "Tab", "Down", "Down", "9", "Tab", ".",
@@ -86,9 +88,10 @@ SCENARIO(
     REQUIRE(opt.dune.writeVTKfiles == defaultOpts.writeVTKfiles);
   }
   WHEN("user changes Pixel values") {
-    mwt.addUserAction({"Right", "Tab", "Up",  "Up",  "Tab",   "7",   "Tab",
-                       "9",     "9",   "Tab", "0",   ".",     "5",   "Tab",
-                       "Space", "Tab", "1",   "Tab", "Space", "Tab", "1"});
+    mwt.addUserAction({"Right", "Tab",   "Up",  "Up",  "Tab", "7",
+                       "Tab",   "9",     "9",   "Tab", "0",   ".",
+                       "5",     "Tab",   "Space", "Tab", "1", "Tab",
+                       "Space", "Tab",   "1",   "Tab", "Space"});
     mwt.start();
     dia.exec();
     auto opt = dia.getOptions();
@@ -100,10 +103,11 @@ SCENARIO(
     REQUIRE(opt.pixel.maxThreads == 1);
     REQUIRE(opt.pixel.doCSE == false);
     REQUIRE(opt.pixel.optLevel == 1);
+    REQUIRE(opt.pixel.tieredCompilation == true);
   }
   WHEN("user resets to pixel defaults") {
-    mwt.addUserAction(
-        {"Right", "Tab", "Tab", "Tab", "Tab", "Tab", "Tab", "Tab", "Tab", " "});
+    mwt.addUserAction({"Right", "Tab", "Tab", "Tab", "Tab", "Tab", "Tab",
+                       "Tab", "Tab", "Tab", " "});
     mwt.start();
     dia.exec();
     sme::simulate::PixelOptions defaultOpts{};
@@ -114,6 +118,7 @@ SCENARIO(
     REQUIRE(opt.pixel.maxTimestep == dbl_approx(defaultOpts.maxTimestep));
     REQUIRE(opt.pixel.enableMultiThreading == defaultOpts.enableMultiThreading);
     REQUIRE(opt.pixel.maxThreads == defaultOpts.maxThreads);
+    REQUIRE(opt.pixel.tieredCompilation == defaultOpts.tieredCompilation);
   }
 }
 #endif